@@ -0,0 +1,281 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK custom heap allocator benchmark.
+ *------------------------------------------------------------------------------
+ * Runs the same multi-threaded allocation workload on
+ * snsrAllocLock(snsrAllocStdlib()) and on the per-thread arena allocator
+ * in arena-alloc.c, with 1, 2, 4, ... threads.
+ *
+ * Each thread replaces random blocks in a shared table of live allocations:
+ * it allocates a new block, swaps it into a slot and frees the block it
+ * replaced. Most slots belong to the thread, the rest belong to other
+ * threads, so some blocks are freed by a thread that did not allocate
+ * them, as when sessions move between threads. Block sizes are mostly
+ * small, with some medium and a few large blocks.
+ *
+ * Reports the throughput in operations (one allocation and one free) per
+ * second, and the median and 99th percentile latency of an operation.
+ *------------------------------------------------------------------------------
+ */
+
+#include <snsr.h>
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "arena-alloc.h"
+
+#define DEFAULT_THREADS    8
+#define DEFAULT_OPS  1000000
+#define DEFAULT_LIVE    1024
+#define DEFAULT_REMOTE    10
+/* Latency is measured on one operation in SAMPLE_EVERY */
+#define SAMPLE_EVERY       8
+
+typedef struct {
+  const char *name;
+  const SnsrAlloc_Vmt *vmt;
+} Allocator;
+
+typedef struct Bench_ Bench;
+
+typedef struct {
+  Bench *bench;
+  unsigned index;
+  uint32_t *latency;           /* sampled operation times in ns         */
+  size_t samples;
+  double seconds;
+  pthread_t thread;
+} Worker;
+
+struct Bench_ {
+  const SnsrAlloc_Vmt *vmt;
+  _Atomic(void *) *slot;       /* live blocks, live per thread          */
+  unsigned threads;
+  size_t ops;                  /* operations per thread                 */
+  size_t live;
+  unsigned remote;             /* percent of slots owned by others      */
+  atomic_uint ready;
+  atomic_int go;
+};
+
+
+static void
+fatal(int rc, const char *format, ...)
+{
+  va_list a;
+  fprintf(stderr, "ERROR: ");
+  va_start(a, format);
+  vfprintf(stderr, format, a);
+  va_end(a);
+  fprintf(stderr, "\n");
+  exit(rc);
+}
+
+
+static void
+usage(const char *name)
+{
+  fprintf(stderr,
+          "usage: %s [options]\n"
+          " options:\n"
+          "  -l count    : live blocks per thread (default: %i)\n"
+          "  -n count    : operations per thread (default: %i)\n"
+          "  -r percent  : operations on another thread's blocks "
+          "(default: %i)\n"
+          "  -t threads  : largest number of threads (default: %i)\n",
+          name, DEFAULT_LIVE, DEFAULT_OPS, DEFAULT_REMOTE, DEFAULT_THREADS);
+  exit(199);
+}
+
+
+/* Monotonic clock time in seconds */
+static double
+wallSeconds(void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+
+static uint64_t
+nanoseconds(void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t)t.tv_sec * 1000000000u + (uint64_t)t.tv_nsec;
+}
+
+
+static uint32_t
+xorshift(uint32_t *state)
+{
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return *state = x;
+}
+
+
+/* 70% 16-256 bytes, 27% up to 4 KiB, 3% up to 64 KiB. */
+static size_t
+blockSize(uint32_t *rng)
+{
+  uint32_t r = xorshift(rng) % 100;
+
+  if (r < 70) return 16 + xorshift(rng) % 241;
+  if (r < 97) return 256 + xorshift(rng) % 3841;
+  return 4096 + xorshift(rng) % 61441;
+}
+
+
+static void *
+workerThread(void *arg)
+{
+  Worker *w = (Worker *)arg;
+  Bench *b = w->bench;
+  const SnsrAlloc_Vmt *v = b->vmt;
+  uint32_t rng = 2654435761u * (w->index + 1);
+  size_t i, at, base = w->index * b->live;
+  double start;
+  uint64_t t0 = 0;
+  void *p;
+
+  atomic_fetch_add(&b->ready, 1);
+  while (!atomic_load(&b->go))
+    ;
+  start = wallSeconds();
+  for (i = 0; i < b->ops; i++) {
+    size_t size = blockSize(&rng);
+    if (xorshift(&rng) % 100 < b->remote)
+      at = xorshift(&rng) % (b->live * b->threads);
+    else
+      at = base + xorshift(&rng) % b->live;
+    if (i % SAMPLE_EVERY == 0) t0 = nanoseconds();
+    p = v->malloc(v->ctx, size);
+    if (!p) fatal(SNSR_RC_NO_MEMORY, "out of memory");
+    *(char *)p = 1;
+    p = atomic_exchange(&b->slot[at], p);
+    if (p) v->free(v->ctx, p);
+    if (i % SAMPLE_EVERY == 0)
+      w->latency[w->samples++] = (uint32_t)(nanoseconds() - t0);
+  }
+  w->seconds = wallSeconds() - start;
+  return NULL;
+}
+
+
+static int
+compareLatency(const void *a, const void *b)
+{
+  uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+  return x < y? -1: x > y;
+}
+
+
+static void
+bench(const Allocator *a, unsigned threads, size_t ops, size_t live,
+      unsigned remote)
+{
+  Bench b;
+  Worker *w;
+  uint32_t *all;
+  size_t i, n = 0, slots = live * threads;
+  double seconds = 0;
+  unsigned t;
+
+  memset(&b, 0, sizeof(b));
+  b.vmt = a->vmt;
+  b.threads = threads;
+  b.ops = ops;
+  b.live = live;
+  b.remote = threads > 1? remote: 0;
+  b.slot = calloc(slots, sizeof(*b.slot));
+  w = calloc(threads, sizeof(*w));
+  all = malloc((ops / SAMPLE_EVERY + 1) * threads * sizeof(*all));
+  if (!b.slot || !w || !all) fatal(SNSR_RC_NO_MEMORY, "out of memory");
+  if (a->vmt->setUp) a->vmt->setUp(a->vmt->ctx);
+
+  for (t = 0; t < threads; t++) {
+    w[t].bench = &b;
+    w[t].index = t;
+    w[t].latency = all + (ops / SAMPLE_EVERY + 1) * t;
+    if (pthread_create(&w[t].thread, NULL, workerThread, w + t))
+      fatal(SNSR_RC_ERROR, "could not start thread %u", t);
+  }
+  while (atomic_load(&b.ready) < threads)
+    ;
+  atomic_store(&b.go, 1);
+  for (t = 0; t < threads; t++) {
+    pthread_join(w[t].thread, NULL);
+    if (w[t].seconds > seconds) seconds = w[t].seconds;
+    /* Pack the samples for sorting */
+    memmove(all + n, w[t].latency, w[t].samples * sizeof(*all));
+    n += w[t].samples;
+  }
+
+  for (i = 0; i < slots; i++)
+    if (b.slot[i]) a->vmt->free(a->vmt->ctx, b.slot[i]);
+  qsort(all, n, sizeof(*all), compareLatency);
+  printf("%-14s %3u threads: %8.2f M ops/s, p50 %6u ns, p99 %7u ns",
+         a->name, threads, ops * threads / seconds / 1e6,
+         all[n / 2], all[n * 99 / 100]);
+  if (a->vmt == allocArenas()) {
+    ArenaStats s;
+    allocArenasStats(&s);
+    printf(", %5.1f MB reserved", s.reserved / (1024.0 * 1024.0));
+  }
+  printf("\n");
+  if (a->vmt->tearDown) a->vmt->tearDown(a->vmt->ctx);
+  free(all);
+  free(w);
+  free((void *)b.slot);
+}
+
+
+int
+main(int argc, char *argv[])
+{
+  Allocator allocator[2];
+  long ops = DEFAULT_OPS, live = DEFAULT_LIVE;
+  int o, threads = DEFAULT_THREADS, remote = DEFAULT_REMOTE;
+  unsigned t, k;
+  extern char *optarg;
+  extern int optind;
+
+  while ((o = getopt(argc, argv, "l:n:r:t:?")) >= 0) {
+    switch (o) {
+    case 'l': live = atol(optarg); break;
+    case 'n': ops = atol(optarg); break;
+    case 'r': remote = atoi(optarg); break;
+    case 't': threads = atoi(optarg); break;
+    default:  usage(argv[0]);
+    }
+  }
+  if (optind != argc || ops <= 0 || live <= 0 || threads <= 0
+      || remote < 0 || remote > 100) usage(argv[0]);
+
+  allocator[0].name = "stdlib+lock";
+  allocator[0].vmt = snsrAllocLock(snsrAllocStdlib());
+  allocator[1].name = "arenas";
+  allocator[1].vmt = allocArenas();
+
+  /* 1, 2, 4, ... threads, ending with the given number */
+  for (t = 1;; t = 2 * t < (unsigned)threads? 2 * t: (unsigned)threads) {
+    for (k = 0; k < 2; k++)
+      bench(allocator + k, t, (size_t)ops, (size_t)live, (unsigned)remote);
+    if (t == (unsigned)threads) break;
+  }
+  snsrTearDown();
+  return 0;
+}
@@ -0,0 +1,156 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK example of a heap profiling allocator.
+ *------------------------------------------------------------------------------
+ * allocProfile() wraps another allocator and counts, for each phase of a
+ * session's life:
+ *
+ * - the number of allocations, reallocations and frees,
+ * - the number of bytes requested,
+ * - the peak number of live bytes, and
+ * - a histogram of the requested sizes in power-of-two classes.
+ *
+ * The run phase allocation rate, divided by the duration of the audio
+ * processed, measures heap churn in steady state. Comparing reports from
+ * two SDK releases on the same task and audio shows memory regressions
+ * that the real-time factor hides.
+ *
+ * It is built on the size-prefix allocator in sized-alloc.c, so frees
+ * are attributed correctly whether or not the wrapped allocator
+ * implements size().
+ *------------------------------------------------------------------------------
+ */
+
+#include <snsr.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "alloc-profile.h"
+#include "sized-alloc.h"
+
+/* Size class k holds requests of 2^(k-1) + 1 to 2^k bytes */
+#define SIZE_CLASSES 32
+
+typedef struct {
+  size_t allocs;               /* malloc() calls that succeeded         */
+  size_t reallocs;             /* realloc() calls that succeeded        */
+  size_t frees;
+  size_t failed;               /* malloc() and realloc() failures       */
+  size_t bytes;                /* total bytes requested                 */
+  size_t peak;                 /* largest live byte count in the phase  */
+  size_t sizes[SIZE_CLASSES];  /* allocations per size class            */
+} PhaseStats;
+
+typedef struct {
+  AllocPhase phase;
+  PhaseStats stats[ALLOC_PHASES];
+} Profile;
+
+static Profile Prof;
+static SizedHeap Heap;
+static const char *PhaseName[ALLOC_PHASES] = {"load", "run", "exit"};
+
+
+static unsigned
+sizeClass(size_t size)
+{
+  unsigned k = 0;
+
+  while (k < SIZE_CLASSES - 1 && ((size_t)1 << k) < size) k++;
+  return k;
+}
+
+
+static void
+counted(SizedHeap *h, SizedEvent e, size_t size)
+{
+  Profile *p = (Profile *)h->ctx;
+  PhaseStats *s = p->stats + p->phase;
+
+  switch (e) {
+  case SIZED_MALLOC:  s->allocs++; break;
+  case SIZED_REALLOC: s->reallocs++; break;
+  case SIZED_FREE:    s->frees++; return;
+  case SIZED_FAILED:  s->failed++; return;
+  }
+  s->bytes += size;
+  s->sizes[sizeClass(size)]++;
+  if (h->live > s->peak) s->peak = h->live;
+}
+
+
+const SnsrAlloc_Vmt *
+allocProfile(const SnsrAlloc_Vmt *heap)
+{
+  const SnsrAlloc_Vmt *vmt = allocSized(&Heap, heap);
+
+  memset(&Prof, 0, sizeof(Prof));
+  Heap.event = counted;
+  Heap.ctx = &Prof;
+  return vmt;
+}
+
+
+void
+allocProfilePhase(AllocPhase phase)
+{
+  Prof.phase = phase;
+  /* The new phase starts with everything still live */
+  if (Heap.live > Prof.stats[phase].peak) Prof.stats[phase].peak = Heap.live;
+}
+
+
+size_t
+allocProfileLive(void)
+{
+  return Heap.live;
+}
+
+
+size_t
+allocProfilePeak(AllocPhase phase)
+{
+  return Prof.stats[phase].peak;
+}
+
+
+void
+allocProfileReport(FILE *out, double audioSeconds)
+{
+  const PhaseStats *s, *run = Prof.stats + ALLOC_PHASE_RUN;
+  unsigned i, k, last = 0;
+
+  fprintf(out, "Heap allocations:\n"
+          "  phase      allocs  reallocs     frees  failed"
+          "       bytes   peak live\n");
+  for (i = 0; i < ALLOC_PHASES; i++) {
+    s = Prof.stats + i;
+    fprintf(out, "  %-5s %11lu %9lu %9lu %7lu %11lu %11lu\n",
+            PhaseName[i], (unsigned long)s->allocs,
+            (unsigned long)s->reallocs, (unsigned long)s->frees,
+            (unsigned long)s->failed, (unsigned long)s->bytes,
+            (unsigned long)s->peak);
+  }
+  fprintf(out, "  still live: %lu bytes in %lu blocks\n",
+          (unsigned long)Heap.live, (unsigned long)Heap.liveBlocks);
+
+  if (audioSeconds > 0)
+    fprintf(out, "Run phase, per second of audio (%.1f s): "
+            "%.1f allocations, %.0f bytes\n", audioSeconds,
+            (run->allocs + run->reallocs) / audioSeconds,
+            run->bytes / audioSeconds);
+
+  for (k = 0; k < SIZE_CLASSES; k++)
+    for (i = 0; i < ALLOC_PHASES; i++)
+      if (Prof.stats[i].sizes[k]) last = k;
+  fprintf(out, "Allocation sizes:\n"
+          "  up to bytes        load         run        exit\n");
+  for (k = 0; k <= last; k++) {
+    fprintf(out, "  %11lu", (unsigned long)((size_t)1 << k));
+    for (i = 0; i < ALLOC_PHASES; i++)
+      fprintf(out, " %11lu", (unsigned long)Prof.stats[i].sizes[k]);
+    fprintf(out, "\n");
+  }
+}
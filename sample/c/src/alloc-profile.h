@@ -0,0 +1,41 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK heap profiling header. See alloc-profile.c.
+ *------------------------------------------------------------------------------
+ */
+
+typedef enum {
+  ALLOC_PHASE_LOAD,            /* session setup and model loading       */
+  ALLOC_PHASE_RUN,             /* inside snsrRun()                      */
+  ALLOC_PHASE_EXIT,            /* session release and snsrTearDown()    */
+  ALLOC_PHASES
+} AllocPhase;
+
+/* Allocator that counts the allocations made through heap, per phase and
+ * size class. Not thread-safe. If the library is used on more than one
+ * thread, pass it to an allocator that locks, such as snsrAllocLock() or
+ * snsrAllocPerf(), but not to both.
+ */
+const SnsrAlloc_Vmt *
+allocProfile(const SnsrAlloc_Vmt *heap);
+
+/* Attribute allocations made from now on to phase. */
+void
+allocProfilePhase(AllocPhase phase);
+
+/* Requested bytes currently allocated. */
+size_t
+allocProfileLive(void);
+
+/* Largest number of bytes allocated at once in phase, counting from the
+ * allocProfilePhase() call that started it.
+ */
+size_t
+allocProfilePeak(AllocPhase phase);
+
+/* Print the allocation report to out. audioSeconds is the duration of
+ * the audio processed in ALLOC_PHASE_RUN, or 0 if unknown.
+ */
+void
+allocProfileReport(FILE *out, double audioSeconds);
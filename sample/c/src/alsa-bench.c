@@ -0,0 +1,325 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK ALSA capture benchmarks, see alsa-stream.c.
+ *------------------------------------------------------------------------------
+ * resample: CPU cost of the built-in 44.1 kHz and 48 kHz to 16 kHz sample
+ *           rate converter (resample.c), per channel. With -d, also compares
+ *           live capture from a device using the built-in converter against
+ *           the ALSA plug layer converter.
+ * xrun:     capture overruns while a simulated recognizer has periodic
+ *           processing spikes and hog threads load every CPU, with capture
+ *           on the recognition thread and on a dedicated real-time thread.
+ *           Spikes of several lengths are tried, shorter and longer than
+ *           the 500 ms ALSA buffer, or only the one given with -k. Without
+ *           -c a run stops at the first overrun, device or ring buffer, and
+ *           reports the seconds captured up to it.
+ *------------------------------------------------------------------------------
+ */
+
+#include <snsr.h>
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "alsa-stream.h"
+#include "resample.h"
+
+#define SAMPLE_RATE     16000
+#define DEFAULT_SECONDS    10
+/* Conversion and read block size, 15 ms */
+#define BLOCK_MS           15
+
+/* Simulated recognizer load: LOAD_PERCENT of every block, and a
+ * processing spike every SPIKE_INTERVAL_MS. Spikes must be shorter than
+ * MAX_SPIKE_MS for the average load to stay below real time.
+ */
+#define LOAD_PERCENT       50
+#define SPIKE_INTERVAL_MS 2000
+#define MAX_SPIKE_MS       900
+#define DEFAULT_PRIORITY   50
+
+/* Spike lengths tried by default, around the 500 ms ALSA buffer */
+static const int SpikeMs[] = { 100, 250, 400, 600, 800 };
+
+typedef struct {
+  size_t overruns;             /* device and ring buffer overruns       */
+  double seconds;              /* audio captured                        */
+  int stopped;                 /* 1 if the run ended at an overrun      */
+  StreamStats stats;
+} Overruns;
+
+static atomic_int HogStop;
+
+
+static void
+fatal(int rc, const char *format, ...)
+{
+  va_list a;
+  fprintf(stderr, "ERROR: ");
+  va_start(a, format);
+  vfprintf(stderr, format, a);
+  va_end(a);
+  fprintf(stderr, "\n");
+  exit(rc);
+}
+
+
+static void
+usage(const char *name)
+{
+  fprintf(stderr,
+          "usage: %s [options] benchmark\n"
+          " options:\n"
+          "  -a cpu      : capture thread CPU affinity (xrun)\n"
+          "  -c          : count overruns and continue (xrun)\n"
+          "  -d device   : ALSA capture device name for live benchmarks\n"
+          "  -k ms       : only this processing spike length (xrun, "
+          "below %i)\n"
+          "  -l hogs     : number of CPU hog threads (xrun, default: CPUs)\n"
+          "  -r priority : capture thread SCHED_FIFO priority (xrun, "
+          "default: %i)\n"
+          "  -s seconds  : benchmark duration (default: %i)\n"
+          " benchmarks:\n"
+          "  resample    : sample rate conversion CPU cost per channel\n"
+          "  xrun        : capture overruns under load, requires -d\n",
+          name, MAX_SPIKE_MS, DEFAULT_PRIORITY, DEFAULT_SECONDS);
+  exit(199);
+}
+
+
+/* Monotonic clock time in seconds */
+static double
+wallSeconds(void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+
+/* Process CPU time in seconds */
+static double
+cpuSeconds(void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+
+/* Convert seconds of white noise from rate to SAMPLE_RATE,
+ * report CPU use as a percentage of real time.
+ */
+static void
+benchConverter(unsigned int rate, int seconds)
+{
+  Resampler r;
+  size_t i, total = (size_t)rate * seconds, block = rate * BLOCK_MS / 1000;
+  short *in, *out;
+  double start, used;
+
+  r = resamplerNew(rate, SAMPLE_RATE, block);
+  in = malloc(total * sizeof(*in));
+  out = r? malloc(resamplerMaxOut(r, block) * sizeof(*out)): NULL;
+  if (!r || !in || !out) fatal(SNSR_RC_NO_MEMORY, "out of memory");
+  srand(1);
+  for (i = 0; i < total; i++) in[i] = (short)(rand() % 20000 - 10000);
+
+  start = cpuSeconds();
+  for (i = 0; i + block <= total; i += block)
+    resamplerProcess(r, in + i, block, out);
+  used = cpuSeconds() - start;
+  printf("built-in %5u Hz -> %u Hz: %7.3f%% CPU per channel "
+         "(%.2f us per %i ms block)\n", rate, SAMPLE_RATE,
+         100 * used / seconds, 1e6 * used / (total / block), BLOCK_MS);
+  resamplerRelease(r);
+  free(in);
+  free(out);
+}
+
+
+/* Capture seconds of live audio at SAMPLE_RATE, report the CPU used
+ * by the capture path as a percentage of real time.
+ */
+static void
+benchCapture(const char *device, int alsaResample, int seconds)
+{
+  SnsrStream a;
+  StreamConfig config;
+  short buffer[SAMPLE_RATE * BLOCK_MS / 1000];
+  size_t blocks = seconds * 1000 / BLOCK_MS;
+  double start, used;
+
+  memset(&config, 0, sizeof(config));
+  config.latency = STREAM_LATENCY_LOW;
+  config.alsaResample = alsaResample;
+  a = streamFromALSAConfig(device, SAMPLE_RATE, SNSR_ST_MODE_READ, &config);
+  if (!a) fatal(SNSR_RC_NO_MEMORY, "out of memory");
+  snsrRetain(a);
+  snsrStreamOpen(a);
+  start = cpuSeconds();
+  while (blocks-- && snsrStreamRC(a) == SNSR_RC_OK)
+    snsrStreamRead(a, buffer, sizeof(*buffer),
+                   sizeof(buffer) / sizeof(*buffer));
+  used = cpuSeconds() - start;
+  if (snsrStreamRC(a) != SNSR_RC_OK)
+    fatal(snsrStreamRC(a), "%s", snsrStreamErrorDetail(a));
+  printf("%-8s capture from \"%s\": %7.3f%% CPU\n",
+         alsaResample? "ALSA": "built-in", device, 100 * used / seconds);
+  snsrRelease(a);
+}
+
+
+static void *
+hogLoop(void *arg)
+{
+  volatile unsigned long spin = 0;
+  while (!atomic_load(&HogStop)) spin++;
+  return NULL;
+}
+
+
+static void
+busyWait(double seconds)
+{
+  double end = wallSeconds() + seconds;
+  while (wallSeconds() < end)
+    ;
+}
+
+
+/* Capture seconds of audio with a simulated recognizer load that has a
+ * spikeMs spike every SPIKE_INTERVAL_MS, and count the overruns. Uses a
+ * dedicated capture thread if priority >= 0. Unless recover is set, the
+ * run ends at the first overrun.
+ */
+static void
+benchOverruns(const char *device, int priority, int cpu, int recover,
+              int spikeMs, int seconds, Overruns *result)
+{
+  SnsrStream a;
+  StreamConfig config;
+  short buffer[SAMPLE_RATE * BLOCK_MS / 1000];
+  size_t blocks = seconds * 1000 / BLOCK_MS, i;
+
+  memset(&config, 0, sizeof(config));
+  config.latency = STREAM_LATENCY_LOW;
+  config.recover = recover;
+  config.captureThread = priority >= 0;
+  config.rtPriority = priority;
+  config.pinCpu = cpu >= 0;
+  config.cpu = cpu;
+  a = streamFromALSAConfig(device, SAMPLE_RATE, SNSR_ST_MODE_READ, &config);
+  if (!a) fatal(SNSR_RC_NO_MEMORY, "out of memory");
+  snsrRetain(a);
+  snsrStreamOpen(a);
+  for (i = 0; i < blocks && snsrStreamRC(a) == SNSR_RC_OK; i++) {
+    snsrStreamRead(a, buffer, sizeof(*buffer),
+                   sizeof(buffer) / sizeof(*buffer));
+    busyWait(BLOCK_MS * LOAD_PERCENT / 100 / 1000.0);
+    if ((i + 1) % (SPIKE_INTERVAL_MS / BLOCK_MS) == 0)
+      busyWait(spikeMs / 1000.0);
+  }
+  if (snsrStreamRC(a) != SNSR_RC_OK
+      && snsrStreamRC(a) != SNSR_RC_BUFFER_OVERRUN)
+    fatal(snsrStreamRC(a), "%s", snsrStreamErrorDetail(a));
+  streamALSAStats(a, &result->stats);
+  result->stopped = snsrStreamRC(a) == SNSR_RC_BUFFER_OVERRUN;
+  result->overruns = result->stats.overruns
+    + (result->stopped && !result->stats.overruns);
+  result->seconds = i * BLOCK_MS / 1000.0;
+  snsrStreamClose(a);
+  snsrRelease(a);
+}
+
+
+/* Print one column of the xrun table. */
+static void
+printOverruns(const Overruns *r)
+{
+  char text[32];
+
+  if (r->stopped)
+    snprintf(text, sizeof(text), "overrun at %.1f s", r->seconds);
+  else
+    snprintf(text, sizeof(text), "%lu overruns", (unsigned long)r->overruns);
+  printf(" %22s", text);
+}
+
+
+int
+main(int argc, char *argv[])
+{
+  const char *device = NULL;
+  int o, seconds = DEFAULT_SECONDS, recover = 0, spike = 0;
+  int cpu = -1, priority = DEFAULT_PRIORITY;
+  long hogs = sysconf(_SC_NPROCESSORS_ONLN);
+  extern char *optarg;
+  extern int optind;
+
+  while ((o = getopt(argc, argv, "a:cd:k:l:r:s:?")) >= 0) {
+    switch (o) {
+    case 'a': cpu = atoi(optarg); break;
+    case 'c': recover = 1; break;
+    case 'd': device = optarg; break;
+    case 'k': spike = atoi(optarg); break;
+    case 'l': hogs = atol(optarg); break;
+    case 'r': priority = atoi(optarg); break;
+    case 's': seconds = atoi(optarg); break;
+    default:  usage(argv[0]);
+    }
+  }
+  if (optind != argc - 1 || seconds <= 0 || spike < 0
+      || spike >= MAX_SPIKE_MS) usage(argv[0]);
+
+  if (!strcmp(argv[optind], "resample")) {
+    benchConverter(48000, seconds);
+    benchConverter(44100, seconds);
+    if (device) {
+      benchCapture(device, 1, seconds);
+      benchCapture(device, 0, seconds);
+    }
+  } else if (!strcmp(argv[optind], "xrun") && device) {
+    pthread_t *hog = calloc(hogs > 0? hogs: 1, sizeof(*hog));
+    const int *spikes = spike? &spike: SpikeMs;
+    size_t k, n = spike? 1: sizeof(SpikeMs) / sizeof(*SpikeMs);
+    Overruns direct, threaded;
+    long i;
+    if (!hog) fatal(SNSR_RC_NO_MEMORY, "out of memory");
+    printf("Simulated recognizer: %i%% load, a spike every %i ms, "
+           "%ld CPU hog threads.\n", LOAD_PERCENT, SPIKE_INTERVAL_MS, hogs);
+    for (i = 0; i < hogs; i++) pthread_create(hog + i, NULL, hogLoop, NULL);
+    printf("%8s %22s %22s\n", "spike ms", "recognition thread",
+           "dedicated thread");
+    for (k = 0; k < n; k++) {
+      benchOverruns(device, -1, -1, recover, spikes[k], seconds, &direct);
+      benchOverruns(device, priority > 0? priority: 0, cpu, recover,
+                    spikes[k], seconds, &threaded);
+      printf("%8i", spikes[k]);
+      printOverruns(&direct);
+      printOverruns(&threaded);
+      printf("\n");
+    }
+    printf("Dedicated capture thread: %s, %s",
+           threaded.stats.realtime? "SCHED_FIFO": "SCHED_FIFO not permitted",
+           threaded.stats.locked? "ring locked": "ring not locked");
+    if (cpu >= 0)
+      printf(", %s %i",
+             threaded.stats.pinned? "pinned to CPU": "could not pin to CPU",
+             cpu);
+    printf(".\n");
+    atomic_store(&HogStop, 1);
+    for (i = 0; i < hogs; i++) pthread_join(hog[i], NULL);
+    free(hog);
+  } else {
+    usage(argv[0]);
+  }
+  snsrTearDown();
+  return 0;
+}
@@ -4,20 +4,30 @@
  * TrulyHandsfree SDK keyword spotting minimal example using a custom stream.
  *------------------------------------------------------------------------------
  * SnsrStream ALSA (Linux audio) provider implementation.
- * Currently capture-only.
+ * Read-mode streams capture, write-mode streams play back.
  *------------------------------------------------------------------------------
  */
 
+#define _GNU_SOURCE /* for pthread_setaffinity_np() */
+
 #include <snsr.h>
 
 #include <alsa/asoundlib.h>
 #include <assert.h>
 #include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <stdatomic.h>
 #include <string.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <time.h>
 
 #include "alsa-stream.h"
+#include "resample.h"
 
 /* 15 ms at 16 kHz */
 #define PERIOD_SIZE_LOW_LATENCY   240
@@ -26,12 +36,64 @@
 
 /* Minimum number of periods the buffer should include */
 #define MIN_PERIOD_COUNT   5
-/* Buffer size in ms */
+/* Buffer size in ms, except for calibrated streams */
 #define MIN_BUFFER_MS    500
 
+/* Capture thread ring buffer size, rounded up to a power of two samples */
+#define RING_MS         2000
+
+/* Native device rates to try, in order, when the device does not support
+ * the requested rate directly. Audio is converted with resample.c.
+ */
+static const unsigned DeviceRates[] = { 48000, 44100 };
+
+/* Capture time spent on each candidate period size during calibration */
+#define CALIBRATION_MS  3000
+/* Longest device name saved in the calibration file */
+#define MAX_NAME_LENGTH  255
+
+/* Candidate period sizes tried by streamCalibrateALSA(), in ms.
+ * Sorted smallest to largest, the first one that passes is selected.
+ * Each runs with a buffer of MIN_PERIOD_COUNT periods, as it will
+ * with STREAM_LATENCY_CALIBRATED.
+ */
+static const unsigned CalibrationPeriodMs[] = {
+  5, 10, 15, 20, 30, 50, 100, 200
+};
+
 typedef struct {
-  snd_pcm_t *in;
+  snd_pcm_t *pcm;
   const char *initErrorMsg;    /* NULL if initialization was successful */
+  atomic_size_t xruns;         /* number of over- or underruns          */
+  int playback;                /* 1 for SNSR_ST_MODE_WRITE streams      */
+  int recover;                 /* 1 to count overruns, 0 to fail        */
+  Resampler resampler;         /* NULL if the device runs at our rate   */
+  short *raw;                  /* one period of device-rate audio       */
+  short *converted;            /* resampler output not yet read         */
+  snd_pcm_uframes_t period;    /* device period size, in frames         */
+  size_t convertedCount;       /* valid samples in converted            */
+  size_t convertedIndex;       /* next unread sample in converted       */
+
+  /* Capture thread, see StreamConfig.captureThread */
+  int captureThread;           /* 1 to capture on a separate thread     */
+  int rtPriority;              /* SCHED_FIFO priority, 0 for default    */
+  int pinCpu;                  /* 1 to run on cpu only                  */
+  int cpu;                     /* CPU to run on, with pinCpu            */
+  int realtime;                /* 1 if SCHED_FIFO was applied           */
+  int locked;                  /* 1 if the ring is locked in RAM        */
+  int pinned;                  /* 1 if the CPU affinity was applied     */
+  pthread_t thread;
+  int threadRunning;
+  atomic_int stop;             /* set to ask the capture thread to exit */
+  atomic_int threadError;      /* ALSA error code, 0 if none            */
+  atomic_int ringOverrun;      /* ring overflowed and !recover          */
+  short *ring;                 /* single-producer single-consumer ring  */
+  short *block;                /* capture thread period buffer          */
+  size_t ringMask;             /* ring size in samples, minus one       */
+  size_t blockSize;            /* samples in block                      */
+  atomic_size_t head;          /* total samples written by the thread   */
+  atomic_size_t tail;          /* total samples read by streamRead()    */
+  sem_t available;             /* posted after every ring write         */
 } ProviderData;
 
 
@@ -48,17 +110,170 @@ typedef struct {
   }
 
 
+/* Read exactly want frames from the device into sbuff.
+ * Returns 0 on success, or a negative ALSA error code.
+ */
+static int
+captureFrames(ProviderData *d, short *sbuff, snd_pcm_uframes_t want)
+{
+  snd_pcm_sframes_t read;
+  snd_pcm_uframes_t total = 0;
+
+  do {
+    read = snd_pcm_readi(d->pcm, sbuff + total, want - total);
+    if (read == -EPIPE) d->xruns++;
+    if (read < 0) read = snd_pcm_recover(d->pcm, (int)read, 0);
+    if (read < 0) return (int)read;
+    total += read;
+  } while (total < want);
+  return 0;
+}
+
+
+/* Read want samples at the requested rate, converting one device period
+ * at a time if needed. Keeps converted samples not requested for the next
+ * call. Returns 0 on success, or a negative ALSA error code.
+ */
+static int
+captureSamples(ProviderData *d, short *sbuff, size_t want)
+{
+  size_t n, total = 0;
+  int r;
+
+  if (!d->resampler) return captureFrames(d, sbuff, want);
+  while (total < want) {
+    if (d->convertedIndex == d->convertedCount) {
+      if ((r = captureFrames(d, d->raw, d->period))) return r;
+      d->convertedCount =
+        resamplerProcess(d->resampler, d->raw, d->period, d->converted);
+      d->convertedIndex = 0;
+    }
+    n = d->convertedCount - d->convertedIndex;
+    if (n > want - total) n = want - total;
+    memcpy(sbuff + total, d->converted + d->convertedIndex, n * sizeof(short));
+    d->convertedIndex += n;
+    total += n;
+  }
+  return 0;
+}
+
+
+/* Capture thread: reads one period at a time into the ring, and wakes up
+ * streamRead(). The ring indices are the only state shared with the reader.
+ */
+static void *
+captureLoop(void *arg)
+{
+  ProviderData *d = (ProviderData *)arg;
+  size_t head, i, n;
+  int r;
+
+  while (!atomic_load(&d->stop)) {
+    if (snd_pcm_state(d->pcm) == SND_PCM_STATE_XRUN) {
+      d->xruns++;
+      snd_pcm_recover(d->pcm, -EPIPE, 0);
+    }
+    if ((r = captureSamples(d, d->block, d->blockSize))) {
+      atomic_store(&d->threadError, r);
+      sem_post(&d->available);
+      break;
+    }
+    head = atomic_load_explicit(&d->head, memory_order_relaxed);
+    if (head + d->blockSize - atomic_load_explicit(&d->tail,
+                                                   memory_order_acquire)
+        > d->ringMask + 1) {
+      /* The reader fell more than a ring behind, drop this period. */
+      d->xruns++;
+      if (!d->recover) atomic_store(&d->ringOverrun, 1);
+      sem_post(&d->available);
+      continue;
+    }
+    for (i = 0; i < d->blockSize; i += n) {
+      size_t at = (head + i) & d->ringMask;
+      n = d->ringMask + 1 - at;
+      if (n > d->blockSize - i) n = d->blockSize - i;
+      memcpy(d->ring + at, d->block + i, n * sizeof(short));
+    }
+    atomic_store_explicit(&d->head, head + d->blockSize, memory_order_release);
+    sem_post(&d->available);
+  }
+  return NULL;
+}
+
+
+static void
+stopCaptureThread(ProviderData *d)
+{
+  if (!d->threadRunning) return;
+  atomic_store(&d->stop, 1);
+  pthread_join(d->thread, NULL);
+  d->threadRunning = 0;
+}
+
+
+static SnsrRC
+startCaptureThread(SnsrStream b, ProviderData *d)
+{
+  pthread_attr_t attr;
+  struct sched_param param;
+  int r;
+
+  atomic_store(&d->stop, 0);
+  atomic_store(&d->threadError, 0);
+  atomic_store(&d->ringOverrun, 0);
+  atomic_store(&d->head, 0);
+  atomic_store(&d->tail, 0);
+  while (sem_trywait(&d->available) == 0)
+    ;
+
+  pthread_attr_init(&attr);
+  d->realtime = 0;
+  if (d->rtPriority > 0) {
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = d->rtPriority;
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+    pthread_attr_setschedparam(&attr, &param);
+    d->realtime = 1;
+  }
+  r = pthread_create(&d->thread, &attr, captureLoop, d);
+  if (r == EPERM && d->realtime) {
+    /* Not allowed to use SCHED_FIFO, run with default scheduling. */
+    pthread_attr_setinheritsched(&attr, PTHREAD_INHERIT_SCHED);
+    d->realtime = 0;
+    r = pthread_create(&d->thread, &attr, captureLoop, d);
+  }
+  pthread_attr_destroy(&attr);
+  if (r) {
+    snsrStream_setDetail(b, "Could not start capture thread: %s", strerror(r));
+    return SNSR_RC_ERROR;
+  }
+  d->pinned = 0;
+  if (d->pinCpu && d->cpu >= 0 && d->cpu < CPU_SETSIZE) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(d->cpu, &set);
+    d->pinned = !pthread_setaffinity_np(d->thread, sizeof(set), &set);
+  }
+  d->threadRunning = 1;
+  return SNSR_RC_OK;
+}
+
+
 static SnsrRC
 streamOpen(SnsrStream b)
 {
   ProviderData *d = (ProviderData *)snsrStream_getData(b);
 
-  if (!d->in) {
+  if (!d->pcm) {
     if (d->initErrorMsg) snsrStream_setDetail(b, "%s", d->initErrorMsg);
-    else snsrStream_setDetail(b, "Could not open ALSA device for capture.");
+    else snsrStream_setDetail(b, "Could not open ALSA device for %s.",
+                              d->playback? "playback": "capture");
     return SNSR_RC_NOT_FOUND;
   }
-  AE( prepare(d->in) );
+  AE( prepare(d->pcm) );
+  if (d->captureThread && snsrStreamRC(b) == SNSR_RC_OK)
+    snsrStream_setRC(b, startCaptureThread(b, d));
   return snsrStreamRC(b);
 }
 
@@ -68,7 +283,14 @@ streamClose(SnsrStream b)
 {
   ProviderData *d = (ProviderData *)snsrStream_getData(b);
 
-  AE( drop(d->in) );
+  stopCaptureThread(d);
+  d->convertedCount = d->convertedIndex = 0;
+  /* Let queued playback audio finish, discard unread capture audio. */
+  if (d->playback) {
+    AE( drain(d->pcm) );
+  } else {
+    AE( drop(d->pcm) );
+  }
   return snsrStreamRC(b);
 }
 
@@ -78,86 +300,415 @@ streamRelease(SnsrStream b)
 {
   ProviderData *d = (ProviderData *)snsrStream_getData(b);
 
-  AE( close(d->in) );
+  stopCaptureThread(d);
+  AE( close(d->pcm) );
+  resamplerRelease(d->resampler);
+  if (d->ring) {
+    if (d->locked) munlock(d->ring, (d->ringMask + 1) * sizeof(*d->ring));
+    sem_destroy(&d->available);
+  }
+  free(d->ring);
+  free(d->block);
+  free(d->raw);
+  free(d->converted);
   free((void *)d->initErrorMsg);
   free(d);
 }
 
 
+/* Copy want samples from the capture thread ring, waiting as needed. */
+static size_t
+ringRead(SnsrStream b, ProviderData *d, short *sbuff, size_t want)
+{
+  size_t head, tail, n, total = 0;
+  int r;
+
+  while (total < want) {
+    tail = atomic_load_explicit(&d->tail, memory_order_relaxed);
+    head = atomic_load_explicit(&d->head, memory_order_acquire);
+    if (atomic_load(&d->ringOverrun)) {
+      snsrStream_setDetail(b, "Capture ring buffer overrun.");
+      snsrStream_setRC(b, SNSR_RC_BUFFER_OVERRUN);
+      return 0;
+    }
+    if (head == tail) {
+      if ((r = atomic_load(&d->threadError))) {
+        snsrStream_setDetail(b, "ALSA read error: %s", snd_strerror(r));
+        snsrStream_setRC(b, SNSR_RC_ERROR);
+        return 0;
+      }
+      while (sem_wait(&d->available) && errno == EINTR)
+        ;
+      continue;
+    }
+    n = head - tail;
+    if (n > want - total) n = want - total;
+    if (n > d->ringMask + 1 - (tail & d->ringMask))
+      n = d->ringMask + 1 - (tail & d->ringMask);
+    memcpy(sbuff + total, d->ring + (tail & d->ringMask), n * sizeof(short));
+    atomic_store_explicit(&d->tail, tail + n, memory_order_release);
+    total += n;
+  }
+  return total * sizeof(short);
+}
+
+
 static size_t
 streamRead(SnsrStream b, void *buffer, size_t size)
 {
   ProviderData *d = (ProviderData *)snsrStream_getData(b);
-  snd_pcm_uframes_t read, total = 0, want = size / sizeof(short);
-  short *sbuff = buffer;
+  size_t want = size / sizeof(short);
+  int r;
 
-  if (snd_pcm_state(d->in) == SND_PCM_STATE_XRUN) {
-    snsrStream_setRC(b, SNSR_RC_BUFFER_OVERRUN);
+  if (d->threadRunning) return ringRead(b, d, buffer, want);
+  if (snd_pcm_state(d->pcm) == SND_PCM_STATE_XRUN) {
+    if (!d->recover) {
+      snsrStream_setRC(b, SNSR_RC_BUFFER_OVERRUN);
+      return 0;
+    }
+    d->xruns++;
+    snd_pcm_recover(d->pcm, -EPIPE, 0);
+  }
+  if ((r = captureSamples(d, buffer, want))) {
+    snsrStream_setDetail(b, "ALSA read error: %s", snd_strerror(r));
+    snsrStream_setRC(b, SNSR_RC_ERROR);
     return 0;
   }
-  do {
-    read = snd_pcm_readi(d->in, sbuff + total, want - total);
-    if ((int)read < 0) read = snd_pcm_recover(d->in, read, 0);
-    if ((int)read < 0) {
-      snsrStream_setDetail(b, "ALSA read error: %s", snd_strerror((int)read));
+  return want * sizeof(short);
+}
+
+
+static size_t
+streamWrite(SnsrStream b, const void *buffer, size_t size)
+{
+  ProviderData *d = (ProviderData *)snsrStream_getData(b);
+  snd_pcm_uframes_t written, total = 0, want = size / sizeof(short);
+  const short *sbuff = buffer;
+
+  while (total < want) {
+    written = snd_pcm_writei(d->pcm, sbuff + total, want - total);
+    if ((int)written == -EPIPE) d->xruns++;
+    if ((int)written < 0) written = snd_pcm_recover(d->pcm, written, 0);
+    if ((int)written < 0) {
+      snsrStream_setDetail(b, "ALSA write error: %s",
+                           snd_strerror((int)written));
       snsrStream_setRC(b, SNSR_RC_ERROR);
-      return 0;
+      return total * sizeof(short);
     }
-    total += read;
-  } while (total < want);
+    total += written;
+  }
   return total * sizeof(short);
 }
 
 
 static SnsrStream_Vmt ProviderDef = {
   "ALSA",
-  &streamOpen, &streamClose, &streamRelease, &streamRead, NULL
+  &streamOpen, &streamClose, &streamRelease, &streamRead, &streamWrite
 };
 
 
-SnsrStream
-streamFromALSA(const char *name, unsigned int rate,
-                   SnsrStreamMode mode, StreamLatency latency)
+/* Look up the period and buffer sizes saved by streamCalibrateALSA() for
+ * this device and sample rate. Returns the period, or 0 if there is no
+ * calibration entry.
+ */
+static snd_pcm_uframes_t
+calibratedPeriod(const char *filename, const char *name, unsigned int rate,
+                 snd_pcm_uframes_t *buffer)
+{
+  FILE *f = fopen(filename, "r");
+  char device[MAX_NAME_LENGTH + 1];
+  unsigned int r;
+  unsigned long frames, bufferFrames, found = 0;
+
+  *buffer = 0;
+  if (!f) return 0;
+  while (fscanf(f, "%255s %u %lu %lu",
+                device, &r, &frames, &bufferFrames) == 4) {
+    if (r == rate && !strcmp(device, name)) {
+      found = frames;
+      *buffer = (snd_pcm_uframes_t)bufferFrames;
+    }
+  }
+  fclose(f);
+  return (snd_pcm_uframes_t)found;
+}
+
+
+/* Replace the calibration entry for this device and rate in filename,
+ * keeping entries for all other devices.
+ */
+static int
+saveCalibration(const char *filename, const char *name, unsigned int rate,
+                snd_pcm_uframes_t period, snd_pcm_uframes_t buffer)
+{
+  FILE *f;
+  char device[MAX_NAME_LENGTH + 1], *keep = NULL;
+  size_t used = 0, size = 0;
+  unsigned int r;
+  unsigned long frames, bufferFrames;
+  int len, ok;
+
+  if ((f = fopen(filename, "r"))) {
+    while (fscanf(f, "%255s %u %lu %lu",
+                  device, &r, &frames, &bufferFrames) == 4) {
+      if (r == rate && !strcmp(device, name)) continue;
+      len = snprintf(NULL, 0, "%s %u %lu %lu\n",
+                     device, r, frames, bufferFrames);
+      if (used + len + 1 > size) {
+        char *tmp = realloc(keep, size = 2 * (used + len + 1));
+        if (!tmp) break;
+        keep = tmp;
+      }
+      used += sprintf(keep + used, "%s %u %lu %lu\n",
+                      device, r, frames, bufferFrames);
+    }
+    fclose(f);
+  }
+  if (!(f = fopen(filename, "w"))) {
+    free(keep);
+    return 0;
+  }
+  if (used) fputs(keep, f);
+  fprintf(f, "%s %u %lu %lu\n",
+          name, rate, (unsigned long)period, (unsigned long)buffer);
+  ok = !fclose(f);
+  free(keep);
+  return ok;
+}
+
+
+static double
+nowMs(void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+}
+
+
+/* Capture or playback stream with a period of frames and a buffer of
+ * buffer frames, both at rate. A buffer of 0 selects MIN_PERIOD_COUNT
+ * periods, but no less than MIN_BUFFER_MS.
+ */
+static SnsrStream
+streamFromALSAPeriod(const char *name, unsigned int rate, SnsrStreamMode mode,
+                     snd_pcm_uframes_t frames, snd_pcm_uframes_t buffer,
+                     const StreamConfig *config)
 {
   SnsrStream b;
   ProviderData *d = (ProviderData *)malloc(sizeof(*d));
   snd_pcm_t *h = NULL;
   snd_pcm_hw_params_t *p = NULL;
+  unsigned int deviceRate = rate;
+  size_t i;
   int dir = 0;
-  snd_pcm_uframes_t frames;
 
   if (!d) return NULL;
   memset(d, 0, sizeof(*d));
-  b = snsrStream_alloc(&ProviderDef, d, 1, 0);
+  d->playback = mode == SNSR_ST_MODE_WRITE;
+  b = snsrStream_alloc(&ProviderDef, d, !d->playback, d->playback);
   if (!b) {
     free(d);
     return NULL;
   }
-  if (mode != SNSR_ST_MODE_READ) {
+  if (mode != SNSR_ST_MODE_READ && mode != SNSR_ST_MODE_WRITE) {
     snsrStream_setRC(b, SNSR_RC_INVALID_MODE);
     return b;
   }
-  AE( open(&h, name, SND_PCM_STREAM_CAPTURE, 0) );
+  AE( open(&h, name, d->playback?
+           SND_PCM_STREAM_PLAYBACK: SND_PCM_STREAM_CAPTURE, 0) );
   AE( hw_params_malloc(&p) );
   AE( hw_params_any(h, p) );
   AE( hw_params_set_access(h, p, SND_PCM_ACCESS_RW_INTERLEAVED) );
   AE( hw_params_set_format(h, p, SND_PCM_FORMAT_S16_LE) );
   AE( hw_params_set_channels(h, p, 1) );
-  AE( hw_params_set_rate(h, p, (unsigned)rate, 0) );
-  switch (latency) {
-  case STREAM_LATENCY_LOW:  frames = PERIOD_SIZE_LOW_LATENCY; break;
-  case STREAM_LATENCY_HIGH: frames = PERIOD_SIZE_HIGH_LATENCY; break;
+  /* Built-in rate conversion is capture-only. */
+  if (!config->alsaResample && !d->playback) {
+    /* Bypass the ALSA plug rate converter. If the device does not support
+     * the requested rate, capture at a native rate and convert here.
+     */
+    AE( hw_params_set_rate_resample(h, p, 0) );
+    if (snsrStreamRC(b) == SNSR_RC_OK
+        && snd_pcm_hw_params_test_rate(h, p, rate, 0) < 0) {
+      for (i = 0; i < sizeof(DeviceRates) / sizeof(*DeviceRates); i++) {
+        if (snd_pcm_hw_params_test_rate(h, p, DeviceRates[i], 0) == 0) break;
+      }
+      if (i < sizeof(DeviceRates) / sizeof(*DeviceRates)) {
+        deviceRate = DeviceRates[i];
+      } else {
+        AE( hw_params_set_rate_near(h, p, &deviceRate, &dir) );
+      }
+      frames = frames * deviceRate / rate;
+    }
   }
+  AE( hw_params_set_rate(h, p, deviceRate, 0) );
   AE( hw_params_set_period_size_near(h, p, &frames, &dir) );
   AE( hw_params_get_period_size(p, &frames, &dir) );
-  frames = MIN_PERIOD_COUNT * frames;
-  if (frames < MIN_BUFFER_MS * rate / 1000.0 )
-    frames *= (int)(MIN_BUFFER_MS * rate / 1000.0 / frames + 0.5);
+  d->period = frames;
+  if (buffer) {
+    frames = buffer * deviceRate / rate;
+  } else {
+    frames = MIN_PERIOD_COUNT * frames;
+    if (frames < MIN_BUFFER_MS * deviceRate / 1000.0 )
+      frames *= (int)(MIN_BUFFER_MS * deviceRate / 1000.0 / frames + 0.5);
+  }
   AE( hw_params_set_buffer_size_near(h, p, &frames) );
   AE( hw_params(h, p) );
   snd_pcm_hw_params_free(p);
-  if (snsrStreamRC(b) == SNSR_RC_OK) d->in = h;
+  if (snsrStreamRC(b) == SNSR_RC_OK && deviceRate != rate) {
+    d->resampler = resamplerNew(deviceRate, rate, d->period);
+    d->raw = malloc(d->period * sizeof(*d->raw));
+    if (d->resampler) d->converted =
+      malloc(resamplerMaxOut(d->resampler, d->period) * sizeof(*d->converted));
+    if (!d->resampler || !d->raw || !d->converted) {
+      snsrStream_setDetail(b, "Could not convert from %u Hz to %u Hz.",
+                           deviceRate, rate);
+      snsrStream_setRC(b, SNSR_RC_NO_MEMORY);
+    }
+  }
+  d->recover = config->recover;
+  if (snsrStreamRC(b) == SNSR_RC_OK && config->captureThread && !d->playback) {
+    size_t ring = 1;
+    while (ring < (size_t)RING_MS * rate / 1000) ring <<= 1;
+    d->captureThread = 1;
+    d->rtPriority = config->rtPriority;
+    d->pinCpu = config->pinCpu;
+    d->cpu = config->cpu;
+    d->ringMask = ring - 1;
+    d->blockSize = d->period * rate / deviceRate;
+    d->ring = malloc(ring * sizeof(*d->ring));
+    d->block = malloc(d->blockSize * sizeof(*d->block));
+    if (!d->ring || !d->block || sem_init(&d->available, 0, 0)) {
+      free(d->ring);
+      d->ring = NULL;
+      snsrStream_setDetail(b, "Could not allocate capture ring buffer.");
+      snsrStream_setRC(b, SNSR_RC_NO_MEMORY);
+    } else {
+      /* Keep the ring resident, so the capture thread never page faults.
+       * This needs CAP_IPC_LOCK or a sufficient RLIMIT_MEMLOCK.
+       */
+      memset(d->ring, 0, ring * sizeof(*d->ring));
+      d->locked = !mlock(d->ring, ring * sizeof(*d->ring));
+    }
+  }
+  if (snsrStreamRC(b) == SNSR_RC_OK) d->pcm = h;
   else if (h) snd_pcm_close(h);
-  if (!d->in) d->initErrorMsg = strdup(snsrStreamErrorDetail(b));
+  if (!d->pcm) d->initErrorMsg = strdup(snsrStreamErrorDetail(b));
   return b;
 }
+
+
+SnsrStream
+streamFromALSAConfig(const char *name, unsigned int rate,
+                     SnsrStreamMode mode, const StreamConfig *config)
+{
+  snd_pcm_uframes_t frames = PERIOD_SIZE_LOW_LATENCY, buffer = 0;
+
+  switch (config->latency) {
+  case STREAM_LATENCY_LOW:  frames = PERIOD_SIZE_LOW_LATENCY; break;
+  case STREAM_LATENCY_HIGH: frames = PERIOD_SIZE_HIGH_LATENCY; break;
+  case STREAM_LATENCY_CALIBRATED:
+    /* Fall back to low latency if this device has not been calibrated */
+    frames = calibratedPeriod(STREAM_CALIBRATION_FILE, name, rate, &buffer);
+    if (!frames) frames = PERIOD_SIZE_LOW_LATENCY;
+    break;
+  }
+  return streamFromALSAPeriod(name, rate, mode, frames, buffer, config);
+}
+
+
+SnsrStream
+streamFromALSA(const char *name, unsigned int rate,
+                   SnsrStreamMode mode, StreamLatency latency)
+{
+  StreamConfig config;
+
+  memset(&config, 0, sizeof(config));
+  config.latency = latency;
+  return streamFromALSAConfig(name, rate, mode, &config);
+}
+
+
+void
+streamALSAStats(SnsrStream b, StreamStats *stats)
+{
+  ProviderData *d;
+
+  memset(stats, 0, sizeof(*stats));
+  if (!b || snsrStream_getVmt(b) != &ProviderDef) return;
+  d = (ProviderData *)snsrStream_getData(b);
+  stats->overruns = atomic_load(&d->xruns);
+  stats->realtime = d->realtime;
+  stats->locked = d->locked;
+  stats->pinned = d->pinned;
+}
+
+
+long
+streamCalibrateALSA(const char *name, unsigned int rate, double loadMargin,
+                    const char *filename, int verbose)
+{
+  SnsrStream b;
+  ProviderData *d;
+  StreamConfig config;
+  short *buffer;
+  size_t i, periods, maxPeriod;
+  snd_pcm_uframes_t frames, best = 0;
+  double periodMs, jitter, maxJitter, t, last, spin;
+
+  if (loadMargin < 0 || loadMargin >= 1) return -1;
+  memset(&config, 0, sizeof(config));
+  maxPeriod = CalibrationPeriodMs[sizeof(CalibrationPeriodMs)
+                                  / sizeof(*CalibrationPeriodMs) - 1];
+  buffer = malloc(maxPeriod * rate / 1000 * sizeof(*buffer));
+  if (!buffer) return -1;
+
+  for (i = 0; !best && i < sizeof(CalibrationPeriodMs)
+         / sizeof(*CalibrationPeriodMs); i++) {
+    frames = CalibrationPeriodMs[i] * rate / 1000;
+    b = streamFromALSAPeriod(name, rate, SNSR_ST_MODE_READ, frames,
+                             MIN_PERIOD_COUNT * frames, &config);
+    if (!b) break;
+    snsrRetain(b);
+    snsrStreamOpen(b);
+    if (snsrStreamRC(b) != SNSR_RC_OK) {
+      if (verbose > 0)
+        fprintf(stderr, "Calibration failed: %s\n", snsrStreamErrorDetail(b));
+      snsrRelease(b);
+      break;
+    }
+    d = (ProviderData *)snsrStream_getData(b);
+    periodMs = CalibrationPeriodMs[i];
+    periods = CALIBRATION_MS / CalibrationPeriodMs[i];
+    maxJitter = 0;
+    /* Discard the first period, it includes the device start-up delay. */
+    snsrStreamRead(b, buffer, sizeof(*buffer), frames);
+    last = nowMs();
+    while (periods-- && snsrStreamRC(b) == SNSR_RC_OK) {
+      /* Simulate recognition load for loadMargin of each period. */
+      spin = last + loadMargin * periodMs;
+      while (nowMs() < spin)
+        ;
+      snsrStreamRead(b, buffer, sizeof(*buffer), frames);
+      t = nowMs();
+      jitter = t - last - periodMs;
+      if (jitter > maxJitter) maxJitter = jitter;
+      last = t;
+    }
+    if (verbose > 0)
+      fprintf(stderr, "period %3u ms: max wakeup jitter %6.2f ms, "
+              "%lu overruns\n", CalibrationPeriodMs[i], maxJitter,
+              (unsigned long)d->xruns);
+    if (snsrStreamRC(b) == SNSR_RC_OK && !d->xruns
+        && maxJitter < (1 - loadMargin) * periodMs) best = frames;
+    snsrStreamClose(b);
+    snsrRelease(b);
+  }
+  free(buffer);
+
+  if (!best) return -1;
+  if (filename
+      && !saveCalibration(filename, name, rate, best, MIN_PERIOD_COUNT * best))
+    return -1;
+  return (long)best;
+}
@@ -5,11 +5,60 @@
  *------------------------------------------------------------------------------
  */
 
+/* Period and buffer sizes saved by streamCalibrateALSA(), one device per
+ * line
+ */
+#define STREAM_CALIBRATION_FILE "alsa-calibration.txt"
+
 typedef enum {
   STREAM_LATENCY_LOW,  /* low latency, high CPU overhead          */
   STREAM_LATENCY_HIGH, /* higher latency, with lower CPU overhead */
+  STREAM_LATENCY_CALIBRATED, /* from STREAM_CALIBRATION_FILE, or LOW */
 } StreamLatency;
 
+/* Provider options for streamFromALSAConfig().
+ * Use SNSR_ST_MODE_READ for capture, SNSR_ST_MODE_WRITE for playback.
+ */
+typedef struct {
+  StreamLatency latency;
+  int alsaResample;    /* 0: convert to rate with resample.c if the device */
+                       /*    does not support it, 1: use the ALSA plug     */
+  int recover;         /* 1: count capture overruns and continue,         */
+                       /* 0: fail with SNSR_RC_BUFFER_OVERRUN             */
+  int captureThread;   /* 1: capture on a dedicated thread into a locked  */
+                       /*    ring buffer, decoupled from recognition      */
+  int rtPriority;      /* capture thread SCHED_FIFO priority, 0 for none  */
+  int pinCpu;          /* 1: run the capture thread on cpu only,          */
+                       /* 0: on any CPU                                   */
+  int cpu;             /* capture thread CPU number, with pinCpu          */
+} StreamConfig;
+
+/* Capture statistics, see streamALSAStats() */
+typedef struct {
+  size_t overruns;     /* device and ring buffer overruns                 */
+  int realtime;        /* 1 if the capture thread runs with SCHED_FIFO    */
+  int locked;          /* 1 if the capture ring is locked in RAM          */
+  int pinned;          /* 1 if the capture thread is pinned to its CPU    */
+} StreamStats;
+
 SnsrStream
 streamFromALSA(const char *name, unsigned int rate,
                SnsrStreamMode mode, StreamLatency latency);
+
+SnsrStream
+streamFromALSAConfig(const char *name, unsigned int rate,
+                     SnsrStreamMode mode, const StreamConfig *config);
+
+void
+streamALSAStats(SnsrStream b, StreamStats *stats);
+
+/* Find the smallest capture period that runs without overruns on this
+ * device while a simulated recognizer uses loadMargin (0 to 1) of each
+ * period. Each candidate runs with the buffer it would get in use, a small
+ * multiple of the period. Saves the period and buffer sizes to filename
+ * (if not NULL), for use with STREAM_LATENCY_CALIBRATED. Returns the
+ * period in frames, or -1 on failure.
+ */
+long
+streamCalibrateALSA(const char *name, unsigned int rate, double loadMargin,
+                    const char *filename, int verbose);
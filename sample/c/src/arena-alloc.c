@@ -0,0 +1,391 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK example of a custom heap allocator for servers that
+ * run many sessions on many threads.
+ *------------------------------------------------------------------------------
+ * snsrAllocLock() makes any allocator thread-safe with a single lock, so
+ * hundreds of sessions running on different threads all contend for it.
+ * This allocator gives each thread its own arena, in the style of
+ * tcmalloc and mimalloc, and takes no locks for small allocations:
+ *
+ * - Requests of up to MAX_SMALL bytes are rounded up to one of CLASSES
+ *   size classes, four per power of two. Each arena has a free list per
+ *   class, and carves new blocks from SPAN_SIZE spans that hold blocks of
+ *   a single class.
+ * - Spans are aligned to SPAN_SIZE, so the span header, and with it the
+ *   block size and the owning arena, is found by masking the block
+ *   address.
+ * - A block freed by a thread other than the owner, such as when a
+ *   session is created on one thread and released on another, is pushed
+ *   onto a lock-free list in the owning arena. The owner reclaims these
+ *   when its own free list for a class runs out.
+ * - Larger requests get a dedicated aligned span of their own.
+ * - The arena of a thread that exits is adopted by the next new thread.
+ *
+ * Spans are not returned to the system until snsrTearDown(). See
+ * shard-alloc.c for an allocator that uses a fixed pool instead.
+ *------------------------------------------------------------------------------
+ */
+
+#include <snsr.h>
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena-alloc.h"
+
+#define SPAN_SIZE   (64 * 1024)
+/* Span header size, keeps blocks 16-byte aligned */
+#define SPAN_HEADER 64
+/* Largest size class, larger requests get a dedicated span */
+#define MAX_SMALL   16384
+/* 16-byte steps to 128 bytes, then four classes per power of two */
+#define CLASSES     36
+
+typedef struct Block_ {
+  struct Block_ *next;
+} Block;
+
+typedef struct Span_ {
+  struct Span_ *next;          /* arena spans, or large allocations     */
+  struct Span_ *prev;          /* large allocations only                */
+  struct Arena_ *owner;        /* NULL for large allocations            */
+  size_t size;                 /* block size, or the allocation size    */
+  unsigned sizeClass;
+} Span;
+
+typedef struct Arena_ {
+  struct Arena_ *next;         /* see Arenas                            */
+  Block *free[CLASSES];        /* blocks freed by the owning thread     */
+  char *bump[CLASSES];         /* unused space in the newest span       */
+  char *end[CLASSES];
+  Span *spans;
+  int abandoned;               /* 1 once the thread exited, under Lock  */
+  atomic_size_t reclaimed;     /* blocks taken back from remote         */
+  /* Written by other threads, kept off the owner's cache lines */
+  char pad[64];
+  _Atomic(Block *) remote;     /* blocks freed by other threads         */
+} Arena;
+
+static pthread_mutex_t Lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t Key;      /* abandons the arena at thread exit     */
+static int KeyCreated;
+static Arena *Arenas;          /* all arenas, under Lock                */
+static Span *Large;            /* large allocations, under Lock         */
+static size_t ArenaCount;
+static atomic_size_t Reserved;
+/* Incremented by tearDown, invalidates the thread-local arenas */
+static atomic_uint Generation;
+
+static _Thread_local Arena *Local;
+static _Thread_local unsigned LocalGeneration;
+
+
+static unsigned
+sizeClass(size_t size)
+{
+  unsigned k;
+
+  if (size <= 128) return size? (unsigned)((size + 15) >> 4) - 1: 0;
+  /* 2^k < size <= 2^(k+1) */
+  k = 63 - __builtin_clzll((unsigned long long)(size - 1));
+  return 8 + (k - 7) * 4
+    + (unsigned)((size - 1 - ((size_t)1 << k)) >> (k - 2));
+}
+
+
+static size_t
+classSize(unsigned c)
+{
+  unsigned k;
+
+  if (c < 8) return (c + 1) * 16;
+  k = 7 + (c - 8) / 4;
+  return ((size_t)1 << k) + ((size_t)((c - 8) % 4 + 1) << (k - 2));
+}
+
+
+static Span *
+spanOf(void *ptr)
+{
+  return (Span *)((uintptr_t)ptr & ~(uintptr_t)(SPAN_SIZE - 1));
+}
+
+
+static void
+abandonArena(void *arg)
+{
+  Arena *a = (Arena *)arg;
+
+  pthread_mutex_lock(&Lock);
+  a->abandoned = 1;
+  pthread_mutex_unlock(&Lock);
+}
+
+
+/* Attach this thread to an abandoned arena, or to a new one. */
+static Arena *
+attachArena(void)
+{
+  Arena *a;
+
+  pthread_mutex_lock(&Lock);
+  if (!KeyCreated) KeyCreated = !pthread_key_create(&Key, abandonArena);
+  for (a = Arenas; a && !a->abandoned; a = a->next)
+    ;
+  if (a) {
+    a->abandoned = 0;
+  } else if ((a = calloc(1, sizeof(*a)))) {
+    a->next = Arenas;
+    Arenas = a;
+    ArenaCount++;
+  }
+  if (a && KeyCreated) pthread_setspecific(Key, a);
+  pthread_mutex_unlock(&Lock);
+  Local = a;
+  LocalGeneration = atomic_load_explicit(&Generation, memory_order_relaxed);
+  return a;
+}
+
+
+static Arena *
+localArena(void)
+{
+  if (Local && LocalGeneration
+      == atomic_load_explicit(&Generation, memory_order_relaxed))
+    return Local;
+  return attachArena();
+}
+
+
+/* Move blocks freed by other threads onto the arena free lists. */
+static void
+reclaimRemote(Arena *a)
+{
+  Block *b = atomic_exchange_explicit(&a->remote, NULL, memory_order_acquire);
+  Block *next;
+  size_t n = 0;
+
+  for (; b; b = next, n++) {
+    unsigned c = spanOf(b)->sizeClass;
+    next = b->next;
+    b->next = a->free[c];
+    a->free[c] = b;
+  }
+  if (n) atomic_store_explicit(&a->reclaimed, n + atomic_load_explicit(
+                                 &a->reclaimed, memory_order_relaxed),
+                               memory_order_relaxed);
+}
+
+
+static void *
+refill(Arena *a, unsigned c)
+{
+  size_t size = classSize(c);
+  Block *b;
+  Span *s;
+  void *p;
+
+  reclaimRemote(a);
+  if ((b = a->free[c])) {
+    a->free[c] = b->next;
+    return b;
+  }
+  if (!a->bump[c] || a->bump[c] + size > a->end[c]) {
+    if (posix_memalign(&p, SPAN_SIZE, SPAN_SIZE)) return NULL;
+    atomic_fetch_add_explicit(&Reserved, SPAN_SIZE, memory_order_relaxed);
+    s = (Span *)p;
+    s->next = a->spans;
+    s->prev = NULL;
+    s->owner = a;
+    s->size = size;
+    s->sizeClass = c;
+    a->spans = s;
+    a->bump[c] = (char *)p + SPAN_HEADER;
+    a->end[c] = (char *)p + SPAN_SIZE;
+  }
+  p = a->bump[c];
+  a->bump[c] += size;
+  return p;
+}
+
+
+static void *
+largeAlloc(size_t size)
+{
+  Span *s;
+  void *p;
+
+  if (size > (size_t)-1 - SPAN_HEADER
+      || posix_memalign(&p, SPAN_SIZE, SPAN_HEADER + size)) return NULL;
+  s = (Span *)p;
+  s->owner = NULL;
+  s->size = size;
+  s->sizeClass = CLASSES;
+  pthread_mutex_lock(&Lock);
+  s->prev = NULL;
+  s->next = Large;
+  if (Large) Large->prev = s;
+  Large = s;
+  pthread_mutex_unlock(&Lock);
+  atomic_fetch_add_explicit(&Reserved, SPAN_HEADER + size,
+                            memory_order_relaxed);
+  return (char *)p + SPAN_HEADER;
+}
+
+
+static void
+largeFree(Span *s)
+{
+  pthread_mutex_lock(&Lock);
+  if (s->prev) s->prev->next = s->next;
+  else Large = s->next;
+  if (s->next) s->next->prev = s->prev;
+  pthread_mutex_unlock(&Lock);
+  atomic_fetch_sub_explicit(&Reserved, SPAN_HEADER + s->size,
+                            memory_order_relaxed);
+  free(s);
+}
+
+
+static void *
+arenaMalloc(void *ctx, size_t size)
+{
+  Arena *a;
+  Block *b;
+  unsigned c;
+
+  if (size > MAX_SMALL) return largeAlloc(size);
+  if (!(a = localArena())) return NULL;
+  c = sizeClass(size);
+  if ((b = a->free[c])) {
+    a->free[c] = b->next;
+    return b;
+  }
+  return refill(a, c);
+}
+
+
+static void
+arenaFree(void *ctx, void *ptr)
+{
+  Span *s = spanOf(ptr);
+  Arena *a = s->owner;
+  Block *b = (Block *)ptr;
+
+  if (!a) {
+    largeFree(s);
+  } else if (a == Local && LocalGeneration
+             == atomic_load_explicit(&Generation, memory_order_relaxed)) {
+    b->next = a->free[s->sizeClass];
+    a->free[s->sizeClass] = b;
+  } else {
+    b->next = atomic_load_explicit(&a->remote, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(
+             &a->remote, &b->next, b,
+             memory_order_release, memory_order_relaxed))
+      ;
+  }
+}
+
+
+static size_t
+arenaSize(void *ctx, void *ptr)
+{
+  return spanOf(ptr)->size;
+}
+
+
+static void *
+arenaRealloc(void *ctx, void *ptr, size_t size)
+{
+  Span *s = spanOf(ptr);
+  void *p;
+
+  if (s->owner? size <= MAX_SMALL && sizeClass(size) == s->sizeClass:
+      size <= s->size && size > MAX_SMALL)
+    return ptr;
+  p = arenaMalloc(ctx, size);
+  if (!p) return NULL;
+  memcpy(p, ptr, size < s->size? size: s->size);
+  arenaFree(ctx, ptr);
+  return p;
+}
+
+
+static size_t
+arenaRoundUp(void *ctx, size_t size)
+{
+  return size > MAX_SMALL? size: classSize(sizeClass(size));
+}
+
+
+static SnsrAllocRC
+arenaSetUp(void *ctx)
+{
+  return SNSR_ALLOC_RC_OK;
+}
+
+
+/* Release all memory. Must not race with any other allocator call. */
+static SnsrAllocRC
+arenaTearDown(void *ctx)
+{
+  Arena *a;
+  Span *s;
+
+  pthread_mutex_lock(&Lock);
+  while ((a = Arenas)) {
+    Arenas = a->next;
+    while ((s = a->spans)) {
+      a->spans = s->next;
+      free(s);
+    }
+    free(a);
+  }
+  while ((s = Large)) {
+    Large = s->next;
+    free(s);
+  }
+  /* Exiting threads no longer own an arena */
+  if (KeyCreated) pthread_key_delete(Key);
+  KeyCreated = 0;
+  ArenaCount = 0;
+  atomic_store(&Reserved, 0);
+  atomic_fetch_add(&Generation, 1);
+  pthread_mutex_unlock(&Lock);
+  return SNSR_ALLOC_RC_OK;
+}
+
+
+static const SnsrAlloc_Vmt ArenaVmt = {
+  arenaMalloc, arenaFree, arenaRealloc, arenaSize, arenaRoundUp,
+  NULL, NULL, arenaSetUp, arenaTearDown, NULL
+};
+
+
+const SnsrAlloc_Vmt *
+allocArenas(void)
+{
+  return &ArenaVmt;
+}
+
+
+void
+allocArenasStats(ArenaStats *stats)
+{
+  Arena *a;
+
+  pthread_mutex_lock(&Lock);
+  stats->arenas = ArenaCount;
+  stats->reserved = atomic_load(&Reserved);
+  stats->remoteFrees = 0;
+  for (a = Arenas; a; a = a->next)
+    stats->remoteFrees += atomic_load_explicit(&a->reclaimed,
+                                               memory_order_relaxed);
+  pthread_mutex_unlock(&Lock);
+}
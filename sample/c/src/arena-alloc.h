@@ -0,0 +1,25 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK custom heap allocator header. See arena-alloc.c.
+ *------------------------------------------------------------------------------
+ */
+
+/* Thread-safe heap allocator with a private arena per thread, for
+ * servers that run many sessions on many threads. Use with
+ * snsrConfig(SNSR_CONFIG_ALLOC, allocArenas()). Do not wrap it with
+ * snsrAllocLock().
+ */
+const SnsrAlloc_Vmt *
+allocArenas(void);
+
+typedef struct {
+  size_t arenas;               /* arenas created, at most one per thread */
+  size_t reserved;             /* bytes obtained from the system         */
+  size_t remoteFrees;          /* blocks freed by another thread and
+                                * reclaimed by the owner                 */
+} ArenaStats;
+
+/* Allocator statistics since the last snsrTearDown(). */
+void
+allocArenasStats(ArenaStats *stats);
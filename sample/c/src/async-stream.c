@@ -0,0 +1,594 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK example of a custom file stream that reads ahead
+ * asynchronously, hiding storage latency behind recognition.
+ *------------------------------------------------------------------------------
+ * The file is read in fixed-size blocks into a ring of depth buffers,
+ * which are allocated when the stream is opened and freed when it is
+ * closed.
+ * Every buffer that is not being read by the session has a block read in
+ * flight, so up to depth reads are outstanding at any time. streamRead()
+ * copies straight out of the oldest completed buffer, then resubmits that
+ * buffer for the next block.
+ *
+ * On Linux the reads are submitted with io_uring, using its system calls
+ * directly rather than liburing. The buffers are registered with the ring
+ * so the kernel does not map them for every read. Where io_uring is not
+ * available, or has been disabled, a small pool of threads calls pread()
+ * instead. Windows uses snsrStreamFromFileName().
+ *------------------------------------------------------------------------------
+ */
+
+#include <snsr.h>
+
+#include "async-stream.h"
+
+#ifdef _WIN32
+
+SnsrStream
+streamFromAsyncFile(const char *filename, unsigned depth,
+                    AsyncFileBackend backend)
+{
+  return snsrStreamFromFileName(filename, "r");
+}
+
+
+const char *
+asyncFileBackendName(SnsrStream b)
+{
+  return NULL;
+}
+
+#else
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__) && defined(__has_include)
+#  if __has_include(<linux/io_uring.h>)
+#    include <linux/io_uring.h>
+#    include <sys/mman.h>
+#    include <sys/syscall.h>
+#    include <sys/uio.h>
+#    ifdef __NR_io_uring_setup
+#      define USE_IO_URING 1
+#    endif
+#  endif
+#endif
+
+#define READ_SIZE   (256 * 1024)
+#define MIN_DEPTH   2
+#define MAX_DEPTH   64
+/* Most pread() threads used without io_uring */
+#define MAX_THREADS 4
+
+typedef enum {
+  SLOT_IDLE,                   /* being read by the session            */
+  SLOT_QUEUED,                 /* waiting for a pread() thread         */
+  SLOT_BUSY,                   /* read in progress                     */
+  SLOT_DONE,                   /* read complete                        */
+} SlotState;
+
+typedef struct {
+  char *data;
+  off_t offset;                /* file offset of data[0]               */
+  size_t length;               /* bytes requested                      */
+  ssize_t result;              /* bytes read, or -errno                */
+  SlotState state;
+} Slot;
+
+#ifdef USE_IO_URING
+typedef struct {
+  int fd;
+  int fixed;                   /* 1 if the buffers are registered      */
+  unsigned *sqTail, *sqMask, *sqArray;
+  unsigned *cqHead, *cqTail, *cqMask;
+  struct io_uring_sqe *sqes;
+  struct io_uring_cqe *cqes;
+  void *sq, *cq;
+  size_t sqSize, cqSize, sqesSize;
+} Ring;
+#endif
+
+typedef struct {
+  char *filename;
+  char *buffers;               /* depth * READ_SIZE bytes              */
+  Slot *slot;
+  unsigned depth;
+  unsigned head;               /* slot being consumed                  */
+  unsigned inFlight;           /* io_uring reads not yet reaped        */
+  size_t used;                 /* bytes consumed from slot[head]       */
+  off_t position;              /* file offset of the next byte to read */
+  off_t fileSize;
+  off_t nextOffset;            /* file offset of the next submission   */
+  int fd;
+  AsyncFileBackend backend;
+  int uring;                   /* 1 if reads go through io_uring       */
+#ifdef USE_IO_URING
+  Ring ring;
+#endif
+  pthread_t thread[MAX_THREADS];
+  unsigned threads;            /* running pread() threads              */
+  int stop;                    /* 1 to end the pread() threads         */
+  pthread_mutex_t lock;
+  pthread_cond_t changed;      /* slot queued or done                  */
+} ProviderData;
+
+
+/* Read length bytes at offset, retrying short reads.
+ * Returns the number of bytes read, or -errno.
+ */
+static ssize_t
+readFull(int fd, char *data, size_t length, off_t offset)
+{
+  size_t total = 0;
+  ssize_t n;
+
+  while (total < length) {
+    n = pread(fd, data + total, length - total, offset + total);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0) return -errno;
+    if (n == 0) break;
+    total += n;
+  }
+  return (ssize_t)total;
+}
+
+
+#ifdef USE_IO_URING
+
+static int
+uringSetup(unsigned entries, struct io_uring_params *p)
+{
+  return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+
+static int
+uringEnter(int fd, unsigned submit, unsigned wait, unsigned flags)
+{
+  return (int)syscall(__NR_io_uring_enter, fd, submit, wait, flags, NULL, 0);
+}
+
+
+static int
+uringRegister(int fd, unsigned opcode, const void *arg, unsigned count)
+{
+  return (int)syscall(__NR_io_uring_register, fd, opcode, arg, count);
+}
+
+
+static void
+ringFree(Ring *r)
+{
+  if (r->sqes) munmap(r->sqes, r->sqesSize);
+  if (r->cq && r->cq != r->sq) munmap(r->cq, r->cqSize);
+  if (r->sq) munmap(r->sq, r->sqSize);
+  if (r->fd >= 0) close(r->fd);
+  memset(r, 0, sizeof(*r));
+  r->fd = -1;
+}
+
+
+/* Create an io_uring with room for d->depth reads and register the
+ * buffers. Returns 0 on success, or -1 if io_uring is not available.
+ */
+static int
+ringInit(ProviderData *d)
+{
+  Ring *r = &d->ring;
+  struct io_uring_params p;
+  struct iovec *iov;
+  char *sq, *cq;
+  unsigned i;
+
+  memset(r, 0, sizeof(*r));
+  memset(&p, 0, sizeof(p));
+  r->fd = uringSetup(d->depth, &p);
+  if (r->fd < 0) return -1;
+
+  r->sqSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  r->cqSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    if (r->cqSize > r->sqSize) r->sqSize = r->cqSize;
+    r->cqSize = r->sqSize;
+  }
+  r->sq = mmap(NULL, r->sqSize, PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+  if (r->sq == MAP_FAILED) {
+    r->sq = NULL;
+    ringFree(r);
+    return -1;
+  }
+  if (p.features & IORING_FEAT_SINGLE_MMAP) {
+    r->cq = r->sq;
+  } else {
+    r->cq = mmap(NULL, r->cqSize, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+    if (r->cq == MAP_FAILED) {
+      r->cq = NULL;
+      ringFree(r);
+      return -1;
+    }
+  }
+  r->sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+  r->sqes = mmap(NULL, r->sqesSize, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+  if (r->sqes == MAP_FAILED) {
+    r->sqes = NULL;
+    ringFree(r);
+    return -1;
+  }
+  sq = (char *)r->sq;
+  cq = (char *)r->cq;
+  r->sqTail = (unsigned *)(sq + p.sq_off.tail);
+  r->sqMask = (unsigned *)(sq + p.sq_off.ring_mask);
+  r->sqArray = (unsigned *)(sq + p.sq_off.array);
+  r->cqHead = (unsigned *)(cq + p.cq_off.head);
+  r->cqTail = (unsigned *)(cq + p.cq_off.tail);
+  r->cqMask = (unsigned *)(cq + p.cq_off.ring_mask);
+  r->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+  /* Registration can fail under a low RLIMIT_MEMLOCK,
+   * plain reads still work then.
+   */
+  iov = malloc(d->depth * sizeof(*iov));
+  if (iov) {
+    for (i = 0; i < d->depth; i++) {
+      iov[i].iov_base = d->slot[i].data;
+      iov[i].iov_len = READ_SIZE;
+    }
+    r->fixed =
+      uringRegister(r->fd, IORING_REGISTER_BUFFERS, iov, d->depth) == 0;
+    free(iov);
+  }
+  return 0;
+}
+
+
+static void
+ringSubmit(ProviderData *d, unsigned index)
+{
+  Ring *r = &d->ring;
+  Slot *k = d->slot + index;
+  unsigned tail = *r->sqTail;
+  unsigned at = tail & *r->sqMask;
+  struct io_uring_sqe *sqe = r->sqes + at;
+
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = r->fixed? IORING_OP_READ_FIXED: IORING_OP_READ;
+  sqe->fd = d->fd;
+  sqe->addr = (uint64_t)(uintptr_t)k->data;
+  sqe->len = (unsigned)k->length;
+  sqe->off = (uint64_t)k->offset;
+  sqe->buf_index = r->fixed? (uint16_t)index: 0;
+  sqe->user_data = index;
+  r->sqArray[at] = at;
+  __atomic_store_n(r->sqTail, tail + 1, __ATOMIC_RELEASE);
+  while (uringEnter(r->fd, 1, 0, 0) < 0 && errno == EINTR);
+}
+
+
+/* Move completed reads to their slots, waiting for at least one if wait
+ * is set.
+ */
+static void
+ringReap(ProviderData *d, int wait)
+{
+  Ring *r = &d->ring;
+  unsigned head, tail;
+
+  if (wait) uringEnter(r->fd, 0, 1, IORING_ENTER_GETEVENTS);
+  head = *r->cqHead;
+  tail = __atomic_load_n(r->cqTail, __ATOMIC_ACQUIRE);
+  for (; head != tail; head++) {
+    struct io_uring_cqe *cqe = r->cqes + (head & *r->cqMask);
+    Slot *k = d->slot + cqe->user_data;
+    k->result = cqe->res;
+    k->state = SLOT_DONE;
+    d->inFlight--;
+  }
+  __atomic_store_n(r->cqHead, head, __ATOMIC_RELEASE);
+}
+
+#endif
+
+
+static void *
+readThread(void *arg)
+{
+  ProviderData *d = (ProviderData *)arg;
+  Slot *k;
+  unsigned i;
+
+  pthread_mutex_lock(&d->lock);
+  while (!d->stop) {
+    /* Serve the queued slot closest to the reader first */
+    for (k = NULL, i = 0; i < d->depth; i++) {
+      Slot *s = d->slot + i;
+      if (s->state == SLOT_QUEUED && (!k || s->offset < k->offset)) k = s;
+    }
+    if (!k) {
+      pthread_cond_wait(&d->changed, &d->lock);
+      continue;
+    }
+    k->state = SLOT_BUSY;
+    pthread_mutex_unlock(&d->lock);
+    k->result = readFull(d->fd, k->data, k->length, k->offset);
+    pthread_mutex_lock(&d->lock);
+    k->state = SLOT_DONE;
+    pthread_cond_broadcast(&d->changed);
+  }
+  pthread_mutex_unlock(&d->lock);
+  return NULL;
+}
+
+
+/* Start reading the next block of the file into slot index, if any. */
+static void
+submitSlot(ProviderData *d, unsigned index)
+{
+  Slot *k = d->slot + index;
+  int more = d->nextOffset < d->fileSize;
+
+  if (more) {
+    k->offset = d->nextOffset;
+    k->length = READ_SIZE;
+    if ((off_t)k->length > d->fileSize - k->offset)
+      k->length = (size_t)(d->fileSize - k->offset);
+    d->nextOffset += k->length;
+  }
+#ifdef USE_IO_URING
+  if (d->uring) {
+    k->state = more? SLOT_BUSY: SLOT_IDLE;
+    if (more) {
+      d->inFlight++;
+      ringSubmit(d, index);
+    }
+    return;
+  }
+#endif
+  pthread_mutex_lock(&d->lock);
+  k->state = more? SLOT_QUEUED: SLOT_IDLE;
+  if (more) pthread_cond_signal(&d->changed);
+  pthread_mutex_unlock(&d->lock);
+}
+
+
+/* Wait for the read into slot index to complete. */
+static void
+waitSlot(ProviderData *d, unsigned index)
+{
+  Slot *k = d->slot + index;
+
+#ifdef USE_IO_URING
+  if (d->uring) {
+    ringReap(d, 0);
+    while (k->state != SLOT_DONE) ringReap(d, 1);
+    return;
+  }
+#endif
+  pthread_mutex_lock(&d->lock);
+  while (k->state != SLOT_DONE) pthread_cond_wait(&d->changed, &d->lock);
+  pthread_mutex_unlock(&d->lock);
+}
+
+
+static void
+stopReads(ProviderData *d)
+{
+  unsigned i;
+
+#ifdef USE_IO_URING
+  if (d->uring) {
+    /* The kernel may still be writing to the buffers */
+    while (d->inFlight) ringReap(d, 1);
+    ringFree(&d->ring);
+    d->uring = 0;
+  }
+#endif
+  if (d->threads) {
+    pthread_mutex_lock(&d->lock);
+    d->stop = 1;
+    pthread_cond_broadcast(&d->changed);
+    pthread_mutex_unlock(&d->lock);
+    for (i = 0; i < d->threads; i++) pthread_join(d->thread[i], NULL);
+    d->threads = 0;
+  }
+  /* No reads are left in flight, so the buffers can go */
+  free(d->buffers);
+  d->buffers = NULL;
+}
+
+
+static SnsrRC
+streamOpen(SnsrStream b)
+{
+  ProviderData *d = (ProviderData *)snsrStream_getData(b);
+  struct stat st;
+  unsigned i, threads;
+  int r = 0;
+
+  d->fd = open(d->filename, O_RDONLY);
+  if (d->fd < 0 || fstat(d->fd, &st)) {
+    snsrStream_setDetail(b, "Could not open \"%s\": %s",
+                         d->filename, strerror(errno));
+    if (d->fd >= 0) close(d->fd);
+    d->fd = -1;
+    return SNSR_RC_NOT_FOUND;
+  }
+  if (!d->buffers
+      && posix_memalign((void **)&d->buffers, 4096,
+                        (size_t)d->depth * READ_SIZE)) {
+    d->buffers = NULL;
+    close(d->fd);
+    d->fd = -1;
+    return SNSR_RC_NO_MEMORY;
+  }
+  for (i = 0; i < d->depth; i++)
+    d->slot[i].data = d->buffers + (size_t)i * READ_SIZE;
+  d->fileSize = st.st_size;
+  d->nextOffset = d->position = 0;
+  d->head = 0;
+  d->used = 0;
+  d->inFlight = 0;
+  d->stop = 0;
+  for (i = 0; i < d->depth; i++) d->slot[i].state = SLOT_IDLE;
+
+  d->uring = 0;
+#ifdef USE_IO_URING
+  d->uring = d->backend == ASYNC_FILE_AUTO && ringInit(d) == 0;
+#endif
+  if (!d->uring) {
+    threads = d->depth < MAX_THREADS? d->depth: MAX_THREADS;
+    for (d->threads = 0; d->threads < threads; d->threads++) {
+      r = pthread_create(d->thread + d->threads, NULL, readThread, d);
+      if (r) break;
+    }
+    if (!d->threads) {
+      free(d->buffers);
+      d->buffers = NULL;
+      close(d->fd);
+      d->fd = -1;
+      snsrStream_setDetail(b, "Could not start read threads: %s",
+                           strerror(r));
+      return SNSR_RC_ERROR;
+    }
+  }
+  for (i = 0; i < d->depth; i++) submitSlot(d, i);
+  return SNSR_RC_OK;
+}
+
+
+static SnsrRC
+streamClose(SnsrStream b)
+{
+  ProviderData *d = (ProviderData *)snsrStream_getData(b);
+
+  stopReads(d);
+  if (d->fd >= 0) close(d->fd);
+  d->fd = -1;
+  return SNSR_RC_OK;
+}
+
+
+static void
+streamRelease(SnsrStream b)
+{
+  ProviderData *d = (ProviderData *)snsrStream_getData(b);
+
+  pthread_cond_destroy(&d->changed);
+  pthread_mutex_destroy(&d->lock);
+  free(d->buffers);
+  free(d->slot);
+  free(d->filename);
+  free(d);
+}
+
+
+static size_t
+streamRead(SnsrStream b, void *buffer, size_t size)
+{
+  ProviderData *d = (ProviderData *)snsrStream_getData(b);
+  size_t n, total = 0;
+
+  while (total < size) {
+    Slot *k = d->slot + d->head;
+    if (d->position >= d->fileSize) {
+      snsrStream_setRC(b, SNSR_RC_EOF);
+      break;
+    }
+    if (!d->used) {
+      waitSlot(d, d->head);
+      /* Finish short reads synchronously */
+      if (k->result >= 0 && (size_t)k->result < k->length) {
+        ssize_t more = readFull(d->fd, k->data + k->result,
+                                k->length - k->result,
+                                k->offset + k->result);
+        k->result = more < 0? more: k->result + more;
+      }
+      if (k->result < 0) {
+        snsrStream_setDetail(b, "Read from \"%s\" failed: %s",
+                             d->filename, strerror((int)-k->result));
+        snsrStream_setRC(b, SNSR_RC_ERROR);
+        break;
+      }
+      if (k->result == 0) {
+        /* The file was truncated after it was opened */
+        snsrStream_setRC(b, SNSR_RC_EOF);
+        break;
+      }
+    }
+    n = (size_t)k->result - d->used;
+    if (n > size - total) n = size - total;
+    memcpy((char *)buffer + total, k->data + d->used, n);
+    d->used += n;
+    d->position += n;
+    total += n;
+    if (d->used == (size_t)k->result) {
+      d->used = 0;
+      submitSlot(d, d->head);
+      d->head = (d->head + 1) % d->depth;
+    }
+  }
+  return total;
+}
+
+
+static SnsrStream_Vmt ProviderDef = {
+  "async-file",
+  &streamOpen, &streamClose, &streamRelease, &streamRead, NULL
+};
+
+
+SnsrStream
+streamFromAsyncFile(const char *filename, unsigned depth,
+                    AsyncFileBackend backend)
+{
+  SnsrStream b;
+  ProviderData *d;
+
+  if (!filename) return NULL;
+  if (depth < MIN_DEPTH) depth = MIN_DEPTH;
+  if (depth > MAX_DEPTH) depth = MAX_DEPTH;
+  d = calloc(1, sizeof(*d));
+  if (!d) return NULL;
+  d->fd = -1;
+  d->depth = depth;
+  d->backend = backend;
+  d->filename = strdup(filename);
+  d->slot = calloc(depth, sizeof(*d->slot));
+  pthread_mutex_init(&d->lock, NULL);
+  pthread_cond_init(&d->changed, NULL);
+  b = d->filename && d->slot?
+    snsrStream_alloc(&ProviderDef, d, 1, 0): NULL;
+  if (!b) {
+    pthread_cond_destroy(&d->changed);
+    pthread_mutex_destroy(&d->lock);
+    free(d->slot);
+    free(d->filename);
+    free(d);
+  }
+  return b;
+}
+
+
+const char *
+asyncFileBackendName(SnsrStream b)
+{
+  ProviderData *d;
+
+  if (!b || snsrStream_getVmt(b) != &ProviderDef) return NULL;
+  d = (ProviderData *)snsrStream_getData(b);
+  if (d->fd < 0) return NULL;
+  return d->uring? "io_uring": "pread threads";
+}
+
+#endif
@@ -0,0 +1,25 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK custom stream header. See async-stream.c.
+ *------------------------------------------------------------------------------
+ */
+
+typedef enum {
+  ASYNC_FILE_AUTO,             /* io_uring if available, else threads */
+  ASYNC_FILE_THREADS,          /* pread() worker threads              */
+} AsyncFileBackend;
+
+/* Create a readable stream for filename that keeps depth block reads in
+ * flight ahead of the reader. Use it in place of snsrStreamFromFileName()
+ * for files on slow or network-attached storage.
+ */
+SnsrStream
+streamFromAsyncFile(const char *filename, unsigned depth,
+                    AsyncFileBackend backend);
+
+/* Name of the backend used by the open stream b: "io_uring",
+ * "pread threads", or NULL if b is not an open asynchronous file stream.
+ */
+const char *
+asyncFileBackendName(SnsrStream b);
@@ -0,0 +1,408 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK example of a custom stream that decodes compressed
+ * telephony audio, so archives can be evaluated without first converting
+ * them to 16-bit PCM.
+ *------------------------------------------------------------------------------
+ * G.711 mu-law and A-law bytes are expanded through a 256-entry table
+ * built when the stream is opened. IMA-ADPCM is decoded a nibble at a
+ * time, either as WAV-style blocks that each start with a predictor and
+ * step index, or as a headerless stream that starts from zero.
+ * Audio at rates other than 16 kHz is converted with resample.c.
+ *------------------------------------------------------------------------------
+ */
+
+#include <snsr.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "codec-stream.h"
+#include "resample.h"
+#include "wav-header.h"
+
+#define SAMPLE_RATE 16000
+/* Decoded samples per source read */
+#define DECODE_SAMPLES 4096
+
+/* IMA-ADPCM block header size for mono audio */
+#define IMA_HEADER_SIZE        4
+
+typedef struct {
+  SnsrStream source;
+  StreamCodec requested;       /* codec passed to the constructor       */
+  StreamCodec codec;           /* codec being decoded                   */
+  int pcm;                     /* 1 for 16-bit PCM WAV input            */
+  unsigned rate;               /* source sample rate in Hz              */
+  size_t blockAlign;           /* IMA-ADPCM block size, 0 if headerless */
+  size_t dataLeft;             /* source bytes left in the WAV data     */
+  Resampler resampler;         /* rate converter, or NULL at 16 kHz     */
+  unsigned char *in;           /* encoded source bytes                  */
+  size_t inSize;               /* source bytes per read                 */
+  short *decoded;              /* decoded samples at the source rate    */
+  size_t decodedMax;
+  short *converted;            /* decoded samples at 16 kHz             */
+  const char *ready;           /* next output bytes                     */
+  size_t readyCount;           /* output bytes available at ready       */
+  int predictor;               /* headerless IMA-ADPCM decoder state    */
+  int stepIndex;
+  int end;                     /* 1 once the source has been consumed   */
+  short table[256];            /* G.711 expansion table                 */
+} ProviderData;
+
+static const short ImaStep[89] = {
+  7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41,
+  45, 50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209,
+  230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876,
+  963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749,
+  3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630,
+  9493, 10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623,
+  27086, 29794, 32767
+};
+
+static const signed char ImaIndex[16] = {
+  -1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+
+static short
+expandMulaw(unsigned char u)
+{
+  int t;
+
+  u = ~u;
+  t = ((u & 0x0f) << 3) + 0x84;
+  t <<= (u & 0x70) >> 4;
+  return (short)((u & 0x80)? 0x84 - t: t - 0x84);
+}
+
+
+static short
+expandAlaw(unsigned char a)
+{
+  int t, segment;
+
+  a ^= 0x55;
+  t = (a & 0x0f) << 4;
+  segment = (a & 0x70) >> 4;
+  if (segment == 0) t += 8;
+  else t = (t + 0x108) << (segment - 1);
+  return (short)((a & 0x80)? t: -t);
+}
+
+
+static void
+decodeTable(const short *table, const unsigned char *in, size_t n, short *out)
+{
+  size_t i;
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    out[i]     = table[in[i]];
+    out[i + 1] = table[in[i + 1]];
+    out[i + 2] = table[in[i + 2]];
+    out[i + 3] = table[in[i + 3]];
+  }
+  for (; i < n; i++) out[i] = table[in[i]];
+}
+
+
+/* Decode n bytes of IMA-ADPCM nibbles, low nibble first.
+ * Returns the number of samples written to out, 2 * n.
+ */
+static size_t
+decodeIma(const unsigned char *in, size_t n, short *out,
+          int *predictor, int *stepIndex)
+{
+  int p = *predictor, index = *stepIndex;
+  size_t i, k = 0;
+  unsigned shift;
+
+  for (i = 0; i < n; i++) {
+    for (shift = 0; shift < 8; shift += 4) {
+      int nibble = (in[i] >> shift) & 0x0f;
+      int step = ImaStep[index];
+      int diff = step >> 3;
+      if (nibble & 4) diff += step;
+      if (nibble & 2) diff += step >> 1;
+      if (nibble & 1) diff += step >> 2;
+      p += (nibble & 8)? -diff: diff;
+      if (p > 32767) p = 32767;
+      else if (p < -32768) p = -32768;
+      index += ImaIndex[nibble];
+      if (index < 0) index = 0;
+      else if (index > 88) index = 88;
+      out[k++] = (short)p;
+    }
+  }
+  *predictor = p;
+  *stepIndex = index;
+  return k;
+}
+
+
+/* Decode one WAV IMA-ADPCM block of n bytes.
+ * Returns the number of samples written to out.
+ */
+static size_t
+decodeImaBlock(const unsigned char *in, size_t n, short *out)
+{
+  int predictor, stepIndex;
+
+  if (n < IMA_HEADER_SIZE) return 0;
+  predictor = (short)(in[0] | in[1] << 8);
+  stepIndex = in[2] > 88? 88: in[2];
+  out[0] = (short)predictor;
+  return 1 + decodeIma(in + IMA_HEADER_SIZE, n - IMA_HEADER_SIZE, out + 1,
+                       &predictor, &stepIndex);
+}
+
+
+/* Read the WAV header up to the start of the audio data. */
+static SnsrRC
+readWavHeader(SnsrStream b, ProviderData *d)
+{
+  WavHeader h;
+  const char *msg;
+
+  if ((msg = wavReadHeader(d->source, &h))) {
+    snsrStream_setDetail(b, "%s", msg);
+    return SNSR_RC_FORMAT_NOT_SUPPORTED;
+  }
+  d->rate = h.rate;
+  d->blockAlign = h.blockAlign;
+  d->dataLeft = h.dataSize;
+
+  if (h.channels != 1) {
+    snsrStream_setDetail(b, "WAV file has %u channels, expected 1.",
+                         h.channels);
+    return SNSR_RC_FORMAT_NOT_SUPPORTED;
+  }
+  switch (h.tag) {
+  case WAV_PCM:
+    if (h.bits == 16) {
+      d->pcm = 1;
+      return SNSR_RC_OK;
+    }
+    break;
+  case WAV_MULAW: d->codec = STREAM_CODEC_MULAW; return SNSR_RC_OK;
+  case WAV_ALAW:  d->codec = STREAM_CODEC_ALAW; return SNSR_RC_OK;
+  case WAV_IMA_ADPCM:
+    d->codec = STREAM_CODEC_IMA_ADPCM;
+    if (d->blockAlign > IMA_HEADER_SIZE) return SNSR_RC_OK;
+    break;
+  }
+  snsrStream_setDetail(b, "WAV format 0x%04x with %u-bit samples "
+                       "is not supported.", h.tag, h.bits);
+  return SNSR_RC_FORMAT_NOT_SUPPORTED;
+}
+
+
+static void
+freeBuffers(ProviderData *d)
+{
+  resamplerRelease(d->resampler);
+  free(d->in);
+  free(d->decoded);
+  free(d->converted);
+  d->resampler = NULL;
+  d->in = NULL;
+  d->decoded = d->converted = NULL;
+}
+
+
+static SnsrRC
+streamOpen(SnsrStream b)
+{
+  ProviderData *d = (ProviderData *)snsrStream_getData(b);
+  size_t perBlock;
+  SnsrRC r;
+  int i;
+
+  r = snsrStreamOpen(d->source);
+  if (r != SNSR_RC_OK) {
+    snsrStream_setDetail(b, "%s", snsrStreamErrorDetail(d->source));
+    return r;
+  }
+  d->codec = d->requested;
+  d->pcm = 0;
+  d->dataLeft = SIZE_MAX;
+  if (d->requested == STREAM_CODEC_WAV) {
+    r = readWavHeader(b, d);
+    if (r != SNSR_RC_OK) return r;
+  }
+  if (!d->rate) {
+    snsrStream_setDetail(b, "Invalid sample rate.");
+    return SNSR_RC_INVALID_ARG;
+  }
+  for (i = 0; i < 256; i++) {
+    d->table[i] = d->codec == STREAM_CODEC_ALAW?
+      expandAlaw((unsigned char)i): expandMulaw((unsigned char)i);
+  }
+
+  if (d->pcm) {
+    d->inSize = DECODE_SAMPLES * sizeof(short);
+    d->decodedMax = DECODE_SAMPLES;
+  } else if (d->codec == STREAM_CODEC_IMA_ADPCM && d->blockAlign) {
+    perBlock = 1 + 2 * (d->blockAlign - IMA_HEADER_SIZE);
+    d->inSize = d->blockAlign
+      * (perBlock < DECODE_SAMPLES? DECODE_SAMPLES / perBlock: 1);
+    d->decodedMax = d->inSize / d->blockAlign * perBlock;
+  } else if (d->codec == STREAM_CODEC_IMA_ADPCM) {
+    d->inSize = DECODE_SAMPLES / 2;
+    d->decodedMax = DECODE_SAMPLES;
+  } else {
+    d->inSize = DECODE_SAMPLES;
+    d->decodedMax = DECODE_SAMPLES;
+  }
+
+  freeBuffers(d);
+  d->in = malloc(d->inSize);
+  d->decoded = malloc(d->decodedMax * sizeof(*d->decoded));
+  if (d->rate != SAMPLE_RATE) {
+    d->resampler = resamplerNew(d->rate, SAMPLE_RATE, d->decodedMax);
+    if (d->resampler)
+      d->converted = malloc(resamplerMaxOut(d->resampler, d->decodedMax)
+                            * sizeof(*d->converted));
+  }
+  if (!d->in || !d->decoded
+      || (d->rate != SAMPLE_RATE && (!d->resampler || !d->converted))) {
+    freeBuffers(d);
+    return SNSR_RC_NO_MEMORY;
+  }
+  d->readyCount = 0;
+  d->predictor = d->stepIndex = 0;
+  d->end = 0;
+  return SNSR_RC_OK;
+}
+
+
+static SnsrRC
+streamClose(SnsrStream b)
+{
+  ProviderData *d = (ProviderData *)snsrStream_getData(b);
+
+  freeBuffers(d);
+  return snsrStreamClose(d->source);
+}
+
+
+static void
+streamRelease(SnsrStream b)
+{
+  ProviderData *d = (ProviderData *)snsrStream_getData(b);
+
+  freeBuffers(d);
+  snsrRelease(d->source);
+  free(d);
+}
+
+
+/* Read and decode the next block of source audio.
+ * Returns SNSR_RC_OK, SNSR_RC_EOF at the end of the source,
+ * or a source error code.
+ */
+static SnsrRC
+decodeNext(SnsrStream b, ProviderData *d)
+{
+  size_t want, n, i, count = 0;
+  SnsrRC r;
+  const short *out;
+
+  if (d->end) return SNSR_RC_EOF;
+  want = d->inSize < d->dataLeft? d->inSize: d->dataLeft;
+  n = want? snsrStreamRead(d->source, d->in, 1, want): 0;
+  r = snsrStreamRC(d->source);
+  if (r != SNSR_RC_OK && r != SNSR_RC_EOF) {
+    snsrStream_setDetail(b, "%s", snsrStreamErrorDetail(d->source));
+    return r;
+  }
+  if (n < want || r == SNSR_RC_EOF || n == d->dataLeft) d->end = 1;
+  d->dataLeft -= n;
+
+  if (d->pcm) {
+    count = n / sizeof(short);
+    memcpy(d->decoded, d->in, count * sizeof(short));
+  } else if (d->codec == STREAM_CODEC_IMA_ADPCM && d->blockAlign) {
+    for (i = 0; i < n; i += d->blockAlign)
+      count += decodeImaBlock(d->in + i, n - i < d->blockAlign?
+                              n - i: d->blockAlign, d->decoded + count);
+  } else if (d->codec == STREAM_CODEC_IMA_ADPCM) {
+    count = decodeIma(d->in, n, d->decoded, &d->predictor, &d->stepIndex);
+  } else {
+    decodeTable(d->table, d->in, n, d->decoded);
+    count = n;
+  }
+
+  out = d->decoded;
+  if (d->resampler) {
+    count = resamplerProcess(d->resampler, d->decoded, count, d->converted);
+    out = d->converted;
+  }
+  d->ready = (const char *)out;
+  d->readyCount = count * sizeof(*out);
+  return SNSR_RC_OK;
+}
+
+
+static size_t
+streamRead(SnsrStream b, void *buffer, size_t size)
+{
+  ProviderData *d = (ProviderData *)snsrStream_getData(b);
+  size_t n, total = 0;
+  SnsrRC r;
+
+  while (total < size) {
+    if (!d->readyCount) {
+      r = decodeNext(b, d);
+      if (r != SNSR_RC_OK) {
+        snsrStream_setRC(b, r);
+        break;
+      }
+      continue;
+    }
+    n = d->readyCount < size - total? d->readyCount: size - total;
+    memcpy((char *)buffer + total, d->ready, n);
+    d->ready += n;
+    d->readyCount -= n;
+    total += n;
+  }
+  return total;
+}
+
+
+static SnsrStream_Vmt ProviderDef = {
+  "codec",
+  &streamOpen, &streamClose, &streamRelease, &streamRead, NULL
+};
+
+
+SnsrStream
+streamFromEncoded(SnsrStream source, StreamCodec codec,
+                  unsigned int rate, size_t blockAlign)
+{
+  ProviderData *d;
+  SnsrStream b;
+
+  if (!source) return NULL;
+  snsrRetain(source);
+  d = calloc(1, sizeof(*d));
+  if (!d) {
+    snsrRelease(source);
+    return NULL;
+  }
+  d->source = source;
+  d->requested = codec;
+  d->rate = rate;
+  d->blockAlign = blockAlign;
+  b = snsrStream_alloc(&ProviderDef, d, 1, 0);
+  if (!b) {
+    snsrRelease(source);
+    free(d);
+    return NULL;
+  }
+  if (blockAlign && blockAlign <= IMA_HEADER_SIZE)
+    snsrStream_setRC(b, SNSR_RC_INVALID_ARG);
+  return b;
+}
@@ -0,0 +1,26 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK custom stream header. See codec-stream.c.
+ *------------------------------------------------------------------------------
+ */
+
+typedef enum {
+  STREAM_CODEC_MULAW,          /* 8-bit G.711 mu-law                    */
+  STREAM_CODEC_ALAW,           /* 8-bit G.711 A-law                     */
+  STREAM_CODEC_IMA_ADPCM,      /* 4-bit IMA-ADPCM, low nibble first     */
+  STREAM_CODEC_WAV             /* any of the above, or 16-bit PCM, with
+                                * the codec, rate and block size taken
+                                * from a WAV file header                */
+} StreamCodec;
+
+/* Decode mono audio from source, and convert it to the 16 kHz 16-bit
+ * PCM the recognizer expects.
+ * rate is the sample rate of headerless source audio.
+ * blockAlign is the IMA-ADPCM block size in bytes, as used in WAV files,
+ * or 0 for a headerless stream of nibbles.
+ * Takes ownership of source.
+ */
+SnsrStream
+streamFromEncoded(SnsrStream source, StreamCodec codec,
+                  unsigned int rate, size_t blockAlign);
@@ -7,18 +7,33 @@
  *
  * NOTE: Normally it's best to use snsrStreamFromMemory(..) for a
  * stream of data, although this example would also work.
+ *
+ * streamFromSamples(..) reads 16-bit audio stored in a fixed byte order.
+ * When that matches the host, reads are a plain copy. Otherwise each
+ * sample is byte-swapped while it is copied, so the source data can stay
+ * in read-only memory and there is no separate conversion pass.
  *-----------------------------------------------------------------------------
  */
 
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#  include <arm_neon.h>
+#endif
+
 #include <snsr.h>
 
+#include "data-stream.h"
+
 typedef struct {
   char *data;
   size_t dataSize;
   size_t index;
+  int swap;             /* 1 to byte-swap 16-bit samples on read */
 } ProviderData;
 
 
@@ -49,6 +64,37 @@ streamRelease(SnsrStream stream)
 }
 
 
+/* Copy size bytes from the current read position to out, swapping the
+ * two bytes of each 16-bit sample. Reads may start or end mid-sample.
+ */
+static void
+swapCopy(unsigned char *out, const ProviderData *d, size_t size)
+{
+  const unsigned char *in = (const unsigned char *)d->data;
+  size_t i = d->index, end = d->index + size;
+
+  if ((i & 1) && i < end) {
+    *out++ = in[i - 1];
+    i++;
+  }
+#if defined(__SSE2__)
+  for (; i + 16 <= end; i += 16, out += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(in + i));
+    v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+    _mm_storeu_si128((__m128i *)out, v);
+  }
+#elif defined(__ARM_NEON)
+  for (; i + 16 <= end; i += 16, out += 16)
+    vst1q_u8(out, vrev16q_u8(vld1q_u8(in + i)));
+#endif
+  for (; i + 2 <= end; i += 2) {
+    *out++ = in[i + 1];
+    *out++ = in[i];
+  }
+  if (i < end) *out = i + 1 < d->dataSize? in[i + 1]: 0;
+}
+
+
 static size_t
 streamRead(SnsrStream stream, void *buffer, size_t readSize)
 {
@@ -65,7 +111,10 @@ streamRead(SnsrStream stream, void *buffer, size_t readSize)
     /* Session will end with SNSR_RC_STREAM_END */
     snsrStream_setRC(stream, SNSR_RC_EOF);
   }
-  if (read) memcpy(buffer, d->data + d->index, read);
+  if (read) {
+    if (d->swap) swapCopy(buffer, d, read);
+    else memcpy(buffer, d->data + d->index, read);
+  }
   d->index += read;
   return read;
 }
@@ -121,3 +170,22 @@ streamFromData(void *data, size_t dataSize, SnsrStreamMode mode)
   if (data == NULL) snsrStream_setRC(dataStream, SNSR_RC_INVALID_ARG);
   return dataStream;
 }
+
+
+static int
+hostIsBigEndian(void)
+{
+  const uint16_t one = 1;
+  return *(const unsigned char *)&one == 0;
+}
+
+
+SnsrStream
+streamFromSamples(const void *data, size_t dataSize, DataByteOrder order)
+{
+  SnsrStream b = streamFromData((void *)data, dataSize, SNSR_ST_MODE_READ);
+  ProviderData *d = b? snsrStream_getData(b): NULL;
+
+  if (d) d->swap = (order == DATA_BIG_ENDIAN) != hostIsBigEndian();
+  return b;
+}
@@ -7,3 +7,14 @@
 
 SnsrStream
 streamFromData(void *data, size_t dataSize, SnsrStreamMode mode);
+
+typedef enum {
+  DATA_LITTLE_ENDIAN,
+  DATA_BIG_ENDIAN
+} DataByteOrder;
+
+/* Readable stream of 16-bit samples stored in the given byte order.
+ * Samples are converted to host byte order as they are read.
+ */
+SnsrStream
+streamFromSamples(const void *data, size_t dataSize, DataByteOrder order);
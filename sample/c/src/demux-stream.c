@@ -0,0 +1,482 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK example of a custom stream that splits a multichannel
+ * WAV file, such as a stereo call recording, into one stream per channel.
+ *------------------------------------------------------------------------------
+ * The source is read once, by whichever channel stream runs out of audio
+ * first, and de-interleaved into a ring buffer per selected channel.
+ * Channels are read at their own pace, but a channel can not fall more than
+ * a ring size behind: the others then wait for it, see fanout-stream.c for
+ * a live-audio hub that drops slow readers instead.
+ *
+ * Sources at other than 16 kHz are converted with resample.c.
+ *------------------------------------------------------------------------------
+ */
+
+#include <snsr.h>
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+#elif defined(__ARM_NEON) && !defined(__ARM_BIG_ENDIAN)
+#  include <arm_neon.h>
+#  define USE_NEON 1
+#endif
+
+#include "demux-stream.h"
+#include "resample.h"
+#include "wav-header.h"
+
+#define SAMPLE_RATE 16000
+/* Most frames read from the source at a time */
+#define FILL_FRAMES 2048
+/* Most channel samples converted per channel stream read */
+#define CHUNK_SAMPLES 1024
+
+typedef struct ProviderData_ ProviderData;
+
+struct Demux_ {
+  SnsrStream source;
+  short **ring;                /* per channel, NULL until selected      */
+  ProviderData **reader;       /* per channel, NULL if not selected     */
+  int *selected;               /* channels being filled, per channel    */
+  unsigned char *fill;         /* source read buffer                    */
+  size_t pending;              /* partial frame bytes left in fill      */
+  size_t ringSamples;
+  size_t written;              /* total frames read from the source     */
+  size_t dataLeft;             /* source bytes left in the WAV data     */
+  unsigned channels;
+  unsigned rate;
+  unsigned blockAlign;
+  unsigned refCount;           /* hub handle plus one per channel       */
+  SnsrRC sourceRC;             /* source status, SNSR_RC_OK if readable */
+  char *sourceDetail;          /* source error message                  */
+  int filling;                 /* 1 if a reader is reading the source   */
+  int opened;                  /* 1 if the source was opened            */
+  pthread_mutex_t lock;
+  pthread_cond_t changed;      /* filled, consumed, or reader closed    */
+};
+
+struct ProviderData_ {
+  Demux hub;
+  Resampler resampler;
+  short *in;                   /* ring samples to convert, may be NULL  */
+  short *out;                  /* converted samples                     */
+  size_t outBegin, outEnd;     /* unread bytes in out                   */
+  size_t position;             /* frame index of the next ring read     */
+  unsigned channel;
+  int live;                    /* 1 while the stream holds up the hub   */
+  int opened;                  /* 1 once the stream has been opened     */
+};
+
+
+static unsigned
+le16(const unsigned char *p)
+{
+  return p[0] | p[1] << 8;
+}
+
+
+/* Read the WAV header up to the start of the audio data.
+ * Sets d->sourceRC and d->sourceDetail on error.
+ */
+static void
+readWavHeader(Demux d)
+{
+  WavHeader h;
+  const char *msg;
+
+  msg = wavReadHeader(d->source, &h);
+  if (!msg) {
+    d->channels = h.channels;
+    d->rate = h.rate;
+    d->blockAlign = h.blockAlign;
+    d->dataLeft = h.dataSize;
+    if (h.tag == WAV_PCM && h.bits == 16 && h.channels
+        && h.blockAlign == 2 * h.channels)
+      return;
+    msg = "Only 16-bit PCM WAV files are supported.";
+  }
+  d->channels = 0;
+  d->sourceRC = SNSR_RC_FORMAT_NOT_SUPPORTED;
+  d->sourceDetail = strdup(msg);
+}
+
+
+/* Copy frames of interleaved stereo audio to left and right.
+ */
+static void
+deinterleave2(const unsigned char *in, short *left, short *right,
+              size_t frames)
+{
+  size_t i = 0;
+
+#if defined(__SSE2__)
+  for (; i + 8 <= frames; i += 8) {
+    __m128i a = _mm_loadu_si128((const __m128i *)(in + 4 * i));
+    __m128i b = _mm_loadu_si128((const __m128i *)(in + 4 * i + 16));
+    __m128i l = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(a, 16), 16),
+                                _mm_srai_epi32(_mm_slli_epi32(b, 16), 16));
+    __m128i r = _mm_packs_epi32(_mm_srai_epi32(a, 16), _mm_srai_epi32(b, 16));
+    _mm_storeu_si128((__m128i *)(left + i), l);
+    _mm_storeu_si128((__m128i *)(right + i), r);
+  }
+#elif defined(USE_NEON)
+  for (; i + 8 <= frames; i += 8) {
+    int16x8x2_t v = vld2q_s16((const int16_t *)(in + 4 * i));
+    vst1q_s16(left + i, v.val[0]);
+    vst1q_s16(right + i, v.val[1]);
+  }
+#endif
+  for (; i < frames; i++) {
+    left[i] = (short)le16(in + 4 * i);
+    right[i] = (short)le16(in + 4 * i + 2);
+  }
+}
+
+
+/* Copy frames samples of one channel from interleaved audio to out.
+ */
+static void
+extractChannel(const unsigned char *in, unsigned channels, unsigned channel,
+               short *out, size_t frames)
+{
+  size_t i, stride = 2 * channels;
+
+  in += 2 * channel;
+  for (i = 0; i < frames; i++, in += stride) out[i] = (short)le16(in);
+}
+
+
+/* De-interleave frames into the selected channel rings, starting at ring
+ * offset at. The frames do not wrap around the end of the rings.
+ */
+static void
+scatterFrames(Demux d, const unsigned char *in, size_t at, size_t frames,
+              const int *selected)
+{
+  unsigned c;
+
+  if (d->channels == 2 && selected[0] && selected[1]) {
+    deinterleave2(in, d->ring[0] + at, d->ring[1] + at, frames);
+    return;
+  }
+  for (c = 0; c < d->channels; c++)
+    if (selected[c])
+      extractChannel(in, d->channels, c, d->ring[c] + at, frames);
+}
+
+
+/* Read more audio from the source into the channel rings.
+ * Called with the lock held, which is released during the source read.
+ * Waits instead if a live channel has no room left in its ring.
+ */
+static void
+fillRings(Demux d)
+{
+  size_t lag = 0, frames, want, n, at, part;
+  unsigned c;
+  SnsrRC rc;
+
+  for (c = 0; c < d->channels; c++) {
+    ProviderData *p = d->reader[c];
+    if (p && p->live && d->written - p->position > lag)
+      lag = d->written - p->position;
+  }
+  if (lag >= d->ringSamples) {
+    pthread_cond_wait(&d->changed, &d->lock);
+    return;
+  }
+  for (c = 0; c < d->channels; c++) d->selected[c] = d->reader[c] != NULL;
+
+  d->filling = 1;
+  pthread_mutex_unlock(&d->lock);
+  frames = d->ringSamples - lag;
+  if (frames > FILL_FRAMES) frames = FILL_FRAMES;
+  want = frames * d->blockAlign - d->pending;
+  if (want > d->dataLeft) want = d->dataLeft;
+  n = snsrStreamRead(d->source, d->fill + d->pending, 1, want);
+  rc = snsrStreamRC(d->source);
+  d->dataLeft -= n;
+  if (rc == SNSR_RC_OK && !d->dataLeft) rc = SNSR_RC_EOF;
+  n += d->pending;
+  frames = n / d->blockAlign;
+  /* Ring space past written is not visible to readers, no lock needed */
+  for (at = 0; at < frames; at += part) {
+    size_t offset = (d->written + at) % d->ringSamples;
+    part = d->ringSamples - offset;
+    if (part > frames - at) part = frames - at;
+    scatterFrames(d, d->fill + at * d->blockAlign, offset, part, d->selected);
+  }
+  d->pending = n - frames * d->blockAlign;
+  memmove(d->fill, d->fill + frames * d->blockAlign, d->pending);
+  pthread_mutex_lock(&d->lock);
+
+  d->written += frames;
+  if (rc != SNSR_RC_OK) {
+    d->sourceRC = rc;
+    if (rc != SNSR_RC_EOF)
+      d->sourceDetail = strdup(snsrStreamErrorDetail(d->source));
+  }
+  d->filling = 0;
+  pthread_cond_broadcast(&d->changed);
+}
+
+
+static void
+hubUnref(Demux d)
+{
+  unsigned refs, c;
+
+  pthread_mutex_lock(&d->lock);
+  refs = --d->refCount;
+  pthread_mutex_unlock(&d->lock);
+  if (refs) return;
+  if (d->opened) snsrStreamClose(d->source);
+  snsrRelease(d->source);
+  pthread_cond_destroy(&d->changed);
+  pthread_mutex_destroy(&d->lock);
+  if (d->ring) for (c = 0; c < d->channels; c++) free(d->ring[c]);
+  free(d->ring);
+  free(d->reader);
+  free(d->selected);
+  free(d->sourceDetail);
+  free(d->fill);
+  free(d);
+}
+
+
+static SnsrRC
+streamOpen(SnsrStream b)
+{
+  ProviderData *p = (ProviderData *)snsrStream_getData(b);
+  Demux d = p->hub;
+
+  if (d->sourceRC == SNSR_RC_FORMAT_NOT_SUPPORTED) {
+    snsrStream_setDetail(b, "%s", d->sourceDetail);
+    return d->sourceRC;
+  }
+  if (d->rate != SAMPLE_RATE && !p->resampler) {
+    p->resampler = resamplerNew(d->rate, SAMPLE_RATE, CHUNK_SAMPLES);
+    if (!p->resampler) {
+      snsrStream_setDetail(b, "Can not convert %u Hz audio to %u Hz.",
+                           d->rate, SAMPLE_RATE);
+      return SNSR_RC_FORMAT_NOT_SUPPORTED;
+    }
+    p->in = malloc(CHUNK_SAMPLES * sizeof(*p->in));
+    p->out = malloc(resamplerMaxOut(p->resampler, CHUNK_SAMPLES)
+                    * sizeof(*p->out));
+  } else if (!p->out) {
+    p->out = malloc(CHUNK_SAMPLES * sizeof(*p->out));
+  }
+  if (!p->out || (p->resampler && !p->in)) return SNSR_RC_NO_MEMORY;
+  p->outBegin = p->outEnd = 0;
+
+  /* Streams start at the beginning of the file, but a stream that was
+   * closed and reopened continues with the most recent audio.
+   */
+  pthread_mutex_lock(&d->lock);
+  if (p->opened && !p->live) {
+    p->position = d->written;
+    p->live = 1;
+  }
+  p->opened = 1;
+  pthread_mutex_unlock(&d->lock);
+  return SNSR_RC_OK;
+}
+
+
+static SnsrRC
+streamClose(SnsrStream b)
+{
+  ProviderData *p = (ProviderData *)snsrStream_getData(b);
+  Demux d = p->hub;
+
+  pthread_mutex_lock(&d->lock);
+  p->live = 0;
+  pthread_cond_broadcast(&d->changed);
+  pthread_mutex_unlock(&d->lock);
+  return SNSR_RC_OK;
+}
+
+
+static void
+streamRelease(SnsrStream b)
+{
+  ProviderData *p = (ProviderData *)snsrStream_getData(b);
+  Demux d = p->hub;
+
+  pthread_mutex_lock(&d->lock);
+  if (d->reader) d->reader[p->channel] = NULL;
+  pthread_cond_broadcast(&d->changed);
+  pthread_mutex_unlock(&d->lock);
+  hubUnref(d);
+  resamplerRelease(p->resampler);
+  free(p->in);
+  free(p->out);
+  free(p);
+}
+
+
+/* Move up to CHUNK_SAMPLES new channel samples from the ring to p->out,
+ * converting the sample rate if needed. Called with the lock held.
+ */
+static void
+convertNext(ProviderData *p)
+{
+  Demux d = p->hub;
+  short *dst = p->resampler? p->in: p->out;
+  size_t n = d->written - p->position;
+  size_t offset = p->position % d->ringSamples;
+
+  if (n > CHUNK_SAMPLES) n = CHUNK_SAMPLES;
+  if (n > d->ringSamples - offset) n = d->ringSamples - offset;
+  memcpy(dst, d->ring[p->channel] + offset, n * sizeof(*dst));
+  p->position += n;
+  pthread_cond_broadcast(&d->changed);
+  if (p->resampler) n = resamplerProcess(p->resampler, p->in, n, p->out);
+  p->outBegin = 0;
+  p->outEnd = n * sizeof(*p->out);
+}
+
+
+static size_t
+streamRead(SnsrStream b, void *buffer, size_t size)
+{
+  ProviderData *p = (ProviderData *)snsrStream_getData(b);
+  Demux d = p->hub;
+  size_t n, total = 0;
+
+  pthread_mutex_lock(&d->lock);
+  while (total < size) {
+    if (p->outBegin < p->outEnd) {
+      n = p->outEnd - p->outBegin;
+      if (n > size - total) n = size - total;
+      memcpy((char *)buffer + total, (char *)p->out + p->outBegin, n);
+      p->outBegin += n;
+      total += n;
+    } else if (p->position < d->written) {
+      convertNext(p);
+    } else if (d->sourceRC != SNSR_RC_OK) {
+      if (d->sourceRC != SNSR_RC_EOF)
+        snsrStream_setDetail(b, "%s", d->sourceDetail? d->sourceDetail: "");
+      snsrStream_setRC(b, d->sourceRC);
+      break;
+    } else if (d->filling) {
+      pthread_cond_wait(&d->changed, &d->lock);
+    } else {
+      fillRings(d);
+    }
+  }
+  pthread_mutex_unlock(&d->lock);
+  return total;
+}
+
+
+static SnsrStream_Vmt ProviderDef = {
+  "demux",
+  &streamOpen, &streamClose, &streamRelease, &streamRead, NULL
+};
+
+
+Demux
+demuxNew(SnsrStream source, size_t ringSize)
+{
+  Demux d;
+
+  if (!source || !ringSize) return NULL;
+  d = calloc(1, sizeof(*d));
+  if (!d) return NULL;
+  d->source = source;
+  snsrRetain(source);
+  d->refCount = 1;
+  pthread_mutex_init(&d->lock, NULL);
+  pthread_cond_init(&d->changed, NULL);
+
+  d->sourceRC = snsrStreamOpen(source);
+  if (d->sourceRC == SNSR_RC_OK) {
+    d->opened = 1;
+    readWavHeader(d);
+  } else {
+    d->sourceRC = SNSR_RC_FORMAT_NOT_SUPPORTED;
+    d->sourceDetail = strdup(snsrStreamErrorDetail(source));
+  }
+  if (d->channels) {
+    d->ringSamples = ringSize / sizeof(short);
+    if (d->ringSamples < FILL_FRAMES) d->ringSamples = FILL_FRAMES;
+    d->ring = calloc(d->channels, sizeof(*d->ring));
+    d->reader = calloc(d->channels, sizeof(*d->reader));
+    d->selected = calloc(d->channels, sizeof(*d->selected));
+    d->fill = malloc((size_t)FILL_FRAMES * d->blockAlign);
+    if (!d->ring || !d->reader || !d->selected || !d->fill) {
+      hubUnref(d);
+      return NULL;
+    }
+  }
+  return d;
+}
+
+
+unsigned
+demuxChannels(Demux d)
+{
+  return d? d->channels: 0;
+}
+
+
+SnsrStream
+streamFromDemux(Demux d, unsigned channel)
+{
+  SnsrStream b;
+  ProviderData *p;
+  int ok = 1;
+
+  if (!d) return NULL;
+  /* Unsupported sources get a stream that reports the header error */
+  if (d->channels && channel >= d->channels) return NULL;
+  p = calloc(1, sizeof(*p));
+  if (!p) return NULL;
+  p->hub = d;
+  p->channel = channel;
+  p->live = 1;
+
+  pthread_mutex_lock(&d->lock);
+  /* Wait for a fill in progress, which does not include this channel */
+  while (d->filling) pthread_cond_wait(&d->changed, &d->lock);
+  if (d->channels) {
+    if (d->reader[channel]) ok = 0;
+    else if (!d->ring[channel])
+      d->ring[channel] = malloc(d->ringSamples * sizeof(**d->ring));
+    if (ok && d->ring[channel]) d->reader[channel] = p;
+    else ok = 0;
+  }
+  /* Channels selected after the first read start with the current audio */
+  p->position = d->written;
+  if (ok) d->refCount++;
+  pthread_mutex_unlock(&d->lock);
+  if (!ok) {
+    free(p);
+    return NULL;
+  }
+  b = snsrStream_alloc(&ProviderDef, p, 1, 0);
+  if (!b) {
+    pthread_mutex_lock(&d->lock);
+    if (d->channels) d->reader[channel] = NULL;
+    pthread_mutex_unlock(&d->lock);
+    hubUnref(d);
+    free(p);
+  }
+  return b;
+}
+
+
+void
+demuxRelease(Demux d)
+{
+  if (d) hubUnref(d);
+}
@@ -0,0 +1,39 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK custom stream header. See demux-stream.c.
+ *------------------------------------------------------------------------------
+ */
+
+typedef struct Demux_ *Demux;
+
+/* Create a demultiplexer for a 16-bit PCM WAV source with any number of
+ * channels. The source is read once, and de-interleaved into a ring buffer
+ * of ringSize bytes per selected channel. Takes ownership of source.
+ */
+Demux
+demuxNew(SnsrStream source, size_t ringSize);
+
+/* Number of channels in the source, or 0 if it is not a supported
+ * WAV file. The error is reported by the channel streams.
+ */
+unsigned
+demuxChannels(Demux d);
+
+/* Create a readable stream for one channel, numbered from 0, and select it.
+ * The stream produces 16 kHz 16-bit mono audio from the start of the file.
+ * Channels without a stream are skipped. Returns NULL if channel is out of
+ * range or already has a stream.
+ *
+ * All selected channels must be read concurrently, typically by a session
+ * on its own thread, as a channel that falls ringSize bytes behind holds
+ * up the others until it catches up or its stream is closed.
+ */
+SnsrStream
+streamFromDemux(Demux d, unsigned channel);
+
+/* Release the demultiplexer handle. Memory is reclaimed when all channel
+ * streams have also been released.
+ */
+void
+demuxRelease(Demux d);
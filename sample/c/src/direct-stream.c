@@ -0,0 +1,342 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK example of a custom file stream for bulk evaluation
+ * that does not fill the page cache.
+ *------------------------------------------------------------------------------
+ * Reading a large corpus through the page cache evicts model files and
+ * other services' data, for audio that is read exactly once. This stream
+ * opens files with O_DIRECT on Linux, or F_NOCACHE on macOS, and reads
+ * aligned blocks into two buffers on a background thread: one is read by
+ * the session while the next is being filled. The buffers are only
+ * allocated while the stream is open, so a corpus of many streams built
+ * up front holds buffers for the file being read only.
+ *
+ * The block size starts small and doubles whenever the session catches up
+ * with the read-ahead, so it settles at a size that hides storage latency
+ * at the session's consumption rate.
+ *
+ * File systems that do not support O_DIRECT, such as tmpfs, fall back to
+ * buffered reads, with each block dropped from the page cache once read.
+ * Windows uses snsrStreamFromFileName().
+ *------------------------------------------------------------------------------
+ */
+
+#ifndef _GNU_SOURCE
+#  define _GNU_SOURCE          /* O_DIRECT */
+#endif
+
+#include <snsr.h>
+
+#include "direct-stream.h"
+
+#ifdef _WIN32
+
+SnsrStream
+streamFromDirectFile(const char *filename)
+{
+  return snsrStreamFromFileName(filename, "r");
+}
+
+
+int
+directFileIsUncached(SnsrStream b)
+{
+  return 0;
+}
+
+#else
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* O_DIRECT buffer, offset and size alignment */
+#define ALIGNMENT 4096
+#define MIN_BLOCK (64 * 1024)
+#define MAX_BLOCK (4 * 1024 * 1024)
+#define BUFFERS   2
+
+typedef struct {
+  char *data;
+  size_t size;                 /* bytes read into data                 */
+  int full;                    /* 1 if ready to be consumed            */
+} Block;
+
+typedef struct {
+  char *filename;
+  Block block[BUFFERS];
+  size_t blockSize;            /* size of the next source read         */
+  size_t used;                 /* bytes consumed from block[head]      */
+  size_t consumed;             /* total bytes consumed                 */
+  off_t offset;                /* file offset of the next source read  */
+  unsigned head;               /* block being consumed                 */
+  int fd;
+  int uncached;                /* 1 with O_DIRECT or F_NOCACHE         */
+  int eof;                     /* 1 once the last block has been read  */
+  int error;                   /* errno of a failed read               */
+  int stop;                    /* 1 to end the read-ahead thread       */
+  int threadRunning;
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t changed;      /* block filled or consumed             */
+} ProviderData;
+
+
+/* Read size bytes at offset, retrying short reads until the end of file.
+ * Returns the number of bytes read, or -1 on error.
+ */
+static ssize_t
+readBlock(ProviderData *d, char *data, size_t size, off_t offset)
+{
+  size_t total = 0;
+  ssize_t n;
+
+  while (total < size) {
+    n = pread(d->fd, data + total, size - total, offset + total);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0) return -1;
+    if (n == 0) break;
+    total += n;
+    /* O_DIRECT reads only end mid-block at the end of the file */
+    if (d->uncached && total % ALIGNMENT) break;
+  }
+  return (ssize_t)total;
+}
+
+
+static void *
+readAhead(void *arg)
+{
+  ProviderData *d = (ProviderData *)arg;
+  unsigned tail = 0;
+  size_t size;
+  off_t offset;
+  ssize_t n;
+
+  pthread_mutex_lock(&d->lock);
+  while (!d->stop && !d->eof && !d->error) {
+    Block *k = d->block + tail;
+    if (k->full) {
+      pthread_cond_wait(&d->changed, &d->lock);
+      continue;
+    }
+    size = d->blockSize;
+    offset = d->offset;
+    pthread_mutex_unlock(&d->lock);
+    n = readBlock(d, k->data, size, offset);
+#ifdef POSIX_FADV_DONTNEED
+    if (n > 0 && !d->uncached)
+      posix_fadvise(d->fd, offset, n, POSIX_FADV_DONTNEED);
+#endif
+    pthread_mutex_lock(&d->lock);
+    if (n < 0) {
+      d->error = errno;
+    } else {
+      k->size = (size_t)n;
+      k->full = 1;
+      d->offset += n;
+      if ((size_t)n < size) d->eof = 1;
+      tail = (tail + 1) % BUFFERS;
+    }
+    pthread_cond_broadcast(&d->changed);
+  }
+  pthread_mutex_unlock(&d->lock);
+  return NULL;
+}
+
+
+/* Free the block buffers, which are only held while the stream is open. */
+static void
+freeBlocks(ProviderData *d)
+{
+  int i;
+
+  for (i = 0; i < BUFFERS; i++) {
+    free(d->block[i].data);
+    d->block[i].data = NULL;
+  }
+}
+
+
+static SnsrRC
+streamOpen(SnsrStream b)
+{
+  ProviderData *d = (ProviderData *)snsrStream_getData(b);
+  int i, r;
+
+  d->fd = open(d->filename, O_RDONLY
+#ifdef O_DIRECT
+               | O_DIRECT
+#endif
+    );
+  d->uncached = d->fd >= 0;
+#ifdef O_DIRECT
+  if (d->fd < 0 && errno == EINVAL) d->fd = open(d->filename, O_RDONLY);
+#endif
+  if (d->fd < 0) {
+    snsrStream_setDetail(b, "Could not open \"%s\": %s",
+                         d->filename, strerror(errno));
+    return SNSR_RC_NOT_FOUND;
+  }
+#if defined(F_NOCACHE)
+  d->uncached = fcntl(d->fd, F_NOCACHE, 1) == 0;
+#elif !defined(O_DIRECT)
+  d->uncached = 0;
+#endif
+
+  for (i = 0; i < BUFFERS; i++) {
+    if (!d->block[i].data
+        && posix_memalign((void **)&d->block[i].data, ALIGNMENT, MAX_BLOCK)) {
+      d->block[i].data = NULL;
+      freeBlocks(d);
+      close(d->fd);
+      d->fd = -1;
+      return SNSR_RC_NO_MEMORY;
+    }
+    d->block[i].size = 0;
+    d->block[i].full = 0;
+  }
+  d->blockSize = MIN_BLOCK;
+  d->used = d->consumed = 0;
+  d->offset = 0;
+  d->head = 0;
+  d->eof = d->error = d->stop = 0;
+  r = pthread_create(&d->thread, NULL, readAhead, d);
+  if (r) {
+    freeBlocks(d);
+    close(d->fd);
+    d->fd = -1;
+    snsrStream_setDetail(b, "Could not start read-ahead thread: %s",
+                         strerror(r));
+    return SNSR_RC_ERROR;
+  }
+  d->threadRunning = 1;
+  return SNSR_RC_OK;
+}
+
+
+static SnsrRC
+streamClose(SnsrStream b)
+{
+  ProviderData *d = (ProviderData *)snsrStream_getData(b);
+
+  if (d->threadRunning) {
+    pthread_mutex_lock(&d->lock);
+    d->stop = 1;
+    pthread_cond_broadcast(&d->changed);
+    pthread_mutex_unlock(&d->lock);
+    pthread_join(d->thread, NULL);
+    d->threadRunning = 0;
+  }
+  if (d->fd >= 0) {
+#ifdef POSIX_FADV_DONTNEED
+    /* Also drop pages the kernel read ahead past the last block */
+    if (!d->uncached) posix_fadvise(d->fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+    close(d->fd);
+  }
+  d->fd = -1;
+  freeBlocks(d);
+  return SNSR_RC_OK;
+}
+
+
+static void
+streamRelease(SnsrStream b)
+{
+  ProviderData *d = (ProviderData *)snsrStream_getData(b);
+
+  pthread_cond_destroy(&d->changed);
+  pthread_mutex_destroy(&d->lock);
+  freeBlocks(d);
+  free(d->filename);
+  free(d);
+}
+
+
+static size_t
+streamRead(SnsrStream b, void *buffer, size_t size)
+{
+  ProviderData *d = (ProviderData *)snsrStream_getData(b);
+  size_t n, total = 0;
+
+  pthread_mutex_lock(&d->lock);
+  while (total < size) {
+    Block *k = d->block + d->head;
+    if (k->full) {
+      n = k->size - d->used;
+      if (n > size - total) n = size - total;
+      memcpy((char *)buffer + total, k->data + d->used, n);
+      d->used += n;
+      total += n;
+      if (d->used == k->size) {
+        k->full = 0;
+        d->consumed += d->used;
+        d->used = 0;
+        d->head = (d->head + 1) % BUFFERS;
+        pthread_cond_broadcast(&d->changed);
+      }
+    } else if (d->error) {
+      snsrStream_setDetail(b, "Read from \"%s\" failed: %s",
+                           d->filename, strerror(d->error));
+      snsrStream_setRC(b, SNSR_RC_ERROR);
+      break;
+    } else if (d->eof) {
+      snsrStream_setRC(b, SNSR_RC_EOF);
+      break;
+    } else {
+      /* The read-ahead did not keep up, use larger blocks. */
+      if (d->consumed && d->blockSize < MAX_BLOCK) d->blockSize *= 2;
+      pthread_cond_wait(&d->changed, &d->lock);
+    }
+  }
+  pthread_mutex_unlock(&d->lock);
+  return total;
+}
+
+
+static SnsrStream_Vmt ProviderDef = {
+  "direct-file",
+  &streamOpen, &streamClose, &streamRelease, &streamRead, NULL
+};
+
+
+SnsrStream
+streamFromDirectFile(const char *filename)
+{
+  SnsrStream b;
+  ProviderData *d;
+
+  if (!filename) return NULL;
+  d = calloc(1, sizeof(*d));
+  if (!d) return NULL;
+  d->fd = -1;
+  d->filename = strdup(filename);
+  pthread_mutex_init(&d->lock, NULL);
+  pthread_cond_init(&d->changed, NULL);
+  b = d->filename? snsrStream_alloc(&ProviderDef, d, 1, 0): NULL;
+  if (!b) {
+    pthread_cond_destroy(&d->changed);
+    pthread_mutex_destroy(&d->lock);
+    free(d->filename);
+    free(d);
+  }
+  return b;
+}
+
+
+int
+directFileIsUncached(SnsrStream b)
+{
+  ProviderData *d;
+
+  if (!b || snsrStream_getVmt(b) != &ProviderDef) return 0;
+  d = (ProviderData *)snsrStream_getData(b);
+  return d->fd >= 0 && d->uncached;
+}
+
+#endif
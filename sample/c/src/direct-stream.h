@@ -0,0 +1,21 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK custom stream header. See direct-stream.c.
+ *------------------------------------------------------------------------------
+ */
+
+/* Create a readable stream for filename that bypasses the page cache
+ * where the platform allows it, and reads ahead on a background thread.
+ * Use it in place of snsrStreamFromFileName() for large corpora that are
+ * read only once.
+ */
+SnsrStream
+streamFromDirectFile(const char *filename);
+
+/* Returns 1 if b is a direct file stream that is open and reading
+ * with O_DIRECT or F_NOCACHE, or 0 if it falls back to buffered reads
+ * that are dropped from the page cache after use.
+ */
+int
+directFileIsUncached(SnsrStream b);
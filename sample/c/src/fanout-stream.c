@@ -0,0 +1,257 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK example of a custom stream that shares a single
+ * audio source, such as a microphone, between several sessions.
+ *------------------------------------------------------------------------------
+ * The hub reads the source into one ring buffer. Every reader stream has
+ * its own read position in that ring. A reader that runs out of data
+ * either waits for another reader to fetch more, or reads the source
+ * itself, so the source is only read by one thread at a time and never
+ * more than once. Readers that fall behind by more than the ring size
+ * have missed audio: they are counted, and fail with
+ * SNSR_RC_BUFFER_OVERRUN, rather than stall the others.
+ *------------------------------------------------------------------------------
+ */
+
+#include <snsr.h>
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fanout-stream.h"
+
+/* Largest single read from the source */
+#define FILL_SIZE 4800
+
+struct FanOut_ {
+  SnsrStream source;
+  char *ring;
+  char *fill;                  /* source read buffer, FILL_SIZE bytes   */
+  size_t ringSize;
+  size_t written;              /* total bytes read from the source      */
+  size_t readers;              /* reader count, for identification      */
+  size_t slowReaders;          /* readers that fell behind              */
+  unsigned refCount;           /* hub handle plus one per reader        */
+  SnsrRC sourceRC;             /* source status, SNSR_RC_OK if readable */
+  char *sourceDetail;          /* source error message                  */
+  int filling;                 /* 1 if a reader is reading the source   */
+  int opened;                  /* 1 once the source has been opened     */
+  pthread_mutex_t lock;
+  pthread_cond_t filled;
+};
+
+typedef struct {
+  FanOut hub;
+  size_t position;             /* absolute byte offset of the next read */
+  size_t id;                   /* reader number, starting at 1          */
+} ProviderData;
+
+
+static void
+hubUnref(FanOut f)
+{
+  unsigned refs;
+
+  pthread_mutex_lock(&f->lock);
+  refs = --f->refCount;
+  pthread_mutex_unlock(&f->lock);
+  if (refs) return;
+  if (f->opened) snsrStreamClose(f->source);
+  snsrRelease(f->source);
+  pthread_cond_destroy(&f->filled);
+  pthread_mutex_destroy(&f->lock);
+  free(f->sourceDetail);
+  free(f->fill);
+  free(f->ring);
+  free(f);
+}
+
+
+static SnsrRC
+streamOpen(SnsrStream b)
+{
+  ProviderData *d = (ProviderData *)snsrStream_getData(b);
+
+  pthread_mutex_lock(&d->hub->lock);
+  d->position = d->hub->written;
+  pthread_mutex_unlock(&d->hub->lock);
+  return SNSR_RC_OK;
+}
+
+
+static SnsrRC
+streamClose(SnsrStream b)
+{
+  return SNSR_RC_OK;
+}
+
+
+static void
+streamRelease(SnsrStream b)
+{
+  ProviderData *d = (ProviderData *)snsrStream_getData(b);
+
+  hubUnref(d->hub);
+  free(d);
+}
+
+
+/* Read more audio from the source into the ring, returns the bytes read.
+ * Called with the lock held, which is released during the source read.
+ */
+static size_t
+fillRing(FanOut f, size_t want)
+{
+  size_t n, at, part;
+  SnsrRC rc;
+
+  f->filling = 1;
+  pthread_mutex_unlock(&f->lock);
+  if (!f->opened) {
+    snsrStreamOpen(f->source);
+    f->opened = 1;
+  }
+  if (want > FILL_SIZE) want = FILL_SIZE;
+  n = snsrStreamRead(f->source, f->fill, 1, want);
+  rc = snsrStreamRC(f->source);
+  pthread_mutex_lock(&f->lock);
+
+  for (at = 0; at < n; at += part) {
+    size_t offset = (f->written + at) % f->ringSize;
+    part = f->ringSize - offset;
+    if (part > n - at) part = n - at;
+    memcpy(f->ring + offset, f->fill + at, part);
+  }
+  f->written += n;
+  if (rc != SNSR_RC_OK) {
+    f->sourceRC = rc;
+    f->sourceDetail = strdup(snsrStreamErrorDetail(f->source));
+  }
+  f->filling = 0;
+  pthread_cond_broadcast(&f->filled);
+  return n;
+}
+
+
+static size_t
+streamRead(SnsrStream b, void *buffer, size_t size)
+{
+  ProviderData *d = (ProviderData *)snsrStream_getData(b);
+  FanOut f = d->hub;
+  size_t n, offset, total = 0;
+
+  pthread_mutex_lock(&f->lock);
+  while (total < size) {
+    if (f->written - d->position > f->ringSize) {
+      f->slowReaders++;
+      snsrStream_setDetail(b, "Fan-out reader %lu fell %lu bytes behind, "
+                           "the ring buffer holds %lu bytes.",
+                           (unsigned long)d->id,
+                           (unsigned long)(f->written - d->position),
+                           (unsigned long)f->ringSize);
+      snsrStream_setRC(b, SNSR_RC_BUFFER_OVERRUN);
+      break;
+    }
+    if (d->position < f->written) {
+      offset = d->position % f->ringSize;
+      n = f->written - d->position;
+      if (n > size - total) n = size - total;
+      if (n > f->ringSize - offset) n = f->ringSize - offset;
+      memcpy((char *)buffer + total, f->ring + offset, n);
+      d->position += n;
+      total += n;
+    } else if (f->sourceRC != SNSR_RC_OK) {
+      if (f->sourceRC != SNSR_RC_EOF)
+        snsrStream_setDetail(b, "%s", f->sourceDetail? f->sourceDetail: "");
+      snsrStream_setRC(b, f->sourceRC);
+      break;
+    } else if (f->filling) {
+      pthread_cond_wait(&f->filled, &f->lock);
+    } else if (!fillRing(f, size - total) && f->sourceRC == SNSR_RC_OK) {
+      /* The source had nothing yet. Return what we have rather than
+       * spin on it, the caller will read again.
+       */
+      break;
+    }
+  }
+  pthread_mutex_unlock(&f->lock);
+  return total;
+}
+
+
+static SnsrStream_Vmt ProviderDef = {
+  "fan-out",
+  &streamOpen, &streamClose, &streamRelease, &streamRead, NULL
+};
+
+
+FanOut
+fanOutNew(SnsrStream source, size_t ringSize)
+{
+  FanOut f;
+
+  if (!source || !ringSize) return NULL;
+  f = calloc(1, sizeof(*f));
+  if (!f) return NULL;
+  f->ring = malloc(ringSize);
+  f->fill = malloc(FILL_SIZE);
+  if (!f->ring || !f->fill) {
+    free(f->ring);
+    free(f->fill);
+    free(f);
+    return NULL;
+  }
+  f->ringSize = ringSize;
+  f->refCount = 1;
+  f->sourceRC = SNSR_RC_OK;
+  pthread_mutex_init(&f->lock, NULL);
+  pthread_cond_init(&f->filled, NULL);
+  f->source = source;
+  snsrRetain(source);
+  return f;
+}
+
+
+SnsrStream
+streamFromFanOut(FanOut f)
+{
+  SnsrStream b;
+  ProviderData *d;
+
+  if (!f) return NULL;
+  d = calloc(1, sizeof(*d));
+  if (!d) return NULL;
+  d->hub = f;
+  b = snsrStream_alloc(&ProviderDef, d, 1, 0);
+  if (!b) {
+    free(d);
+    return NULL;
+  }
+  pthread_mutex_lock(&f->lock);
+  f->refCount++;
+  d->id = ++f->readers;
+  d->position = f->written;
+  pthread_mutex_unlock(&f->lock);
+  return b;
+}
+
+
+size_t
+fanOutSlowReaders(FanOut f)
+{
+  size_t n;
+
+  pthread_mutex_lock(&f->lock);
+  n = f->slowReaders;
+  pthread_mutex_unlock(&f->lock);
+  return n;
+}
+
+
+void
+fanOutRelease(FanOut f)
+{
+  if (f) hubUnref(f);
+}
@@ -0,0 +1,31 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK custom stream header. See fanout-stream.c.
+ *------------------------------------------------------------------------------
+ */
+
+typedef struct FanOut_ *FanOut;
+
+/* Create a fan-out hub that reads source once into a ring buffer of
+ * ringSize bytes, shared by all readers. Takes ownership of source.
+ */
+FanOut
+fanOutNew(SnsrStream source, size_t ringSize);
+
+/* Create a new reader. Each reader is an independent readable SnsrStream
+ * that starts at the most recent audio captured. Readers that fall more
+ * than ringSize bytes behind fail with SNSR_RC_BUFFER_OVERRUN.
+ */
+SnsrStream
+streamFromFanOut(FanOut f);
+
+/* Number of readers that have fallen behind so far. */
+size_t
+fanOutSlowReaders(FanOut f);
+
+/* Release the hub handle. Memory is reclaimed when all readers
+ * have also been released.
+ */
+void
+fanOutRelease(FanOut f);
@@ -0,0 +1,83 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK example of a fault injection allocator.
+ *------------------------------------------------------------------------------
+ * allocFault() wraps another allocator and fails selected malloc() and
+ * realloc() calls: the Nth call, every call larger than a size, or calls
+ * chosen at random with a fixed seed. Failures are reproducible, so a
+ * crash or leak found at call N can be debugged by running with N again.
+ *
+ * It is built on the size-prefix allocator in sized-alloc.c, so the live
+ * byte count is exact. Live bytes left after snsrTearDown() are leaks.
+ *
+ * See fault-sweep.c for a driver that fails every call in turn.
+ *------------------------------------------------------------------------------
+ */
+
+#include <snsr.h>
+
+#include <string.h>
+
+#include "fault-alloc.h"
+#include "sized-alloc.h"
+
+typedef struct {
+  FaultPlan plan;
+  unsigned rng;                /* xorshift state for plan.failPercent   */
+  unsigned long calls;
+  unsigned long failed;
+} Fault;
+
+static Fault Plan;
+static SizedHeap Heap;
+
+
+/* Returns 1 if this call is to fail. Counts the call. */
+static int
+injectFault(SizedHeap *h, size_t size)
+{
+  Fault *f = (Fault *)h->ctx;
+  unsigned x;
+  int fail = 0;
+
+  f->calls++;
+  if (f->plan.failAt && f->calls == f->plan.failAt) fail = 1;
+  else if (f->plan.failAbove && size > f->plan.failAbove) fail = 1;
+  else if (f->plan.failPercent) {
+    x = f->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    f->rng = x;
+    fail = x % 100 < f->plan.failPercent;
+  }
+  f->failed += fail;
+  return fail;
+}
+
+
+const SnsrAlloc_Vmt *
+allocFault(const SnsrAlloc_Vmt *heap, const FaultPlan *plan)
+{
+  const SnsrAlloc_Vmt *vmt = allocSized(&Heap, heap);
+
+  memset(&Plan, 0, sizeof(Plan));
+  Plan.plan = *plan;
+  /* xorshift has a fixed point at 0 */
+  Plan.rng = plan->seed * 2654435761u + 1;
+  if (!Plan.rng) Plan.rng = 1;
+  Heap.fail = injectFault;
+  Heap.ctx = &Plan;
+  return vmt;
+}
+
+
+void
+allocFaultStats(FaultStats *stats)
+{
+  stats->calls = Plan.calls;
+  stats->failed = Plan.failed;
+  stats->live = Heap.live;
+  stats->liveBlocks = Heap.liveBlocks;
+}
@@ -0,0 +1,32 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK fault injection allocator header. See fault-alloc.c.
+ *------------------------------------------------------------------------------
+ */
+
+typedef struct {
+  unsigned long failAt;        /* call number that fails, 0 for none    */
+  size_t failAbove;            /* requests larger than this fail,
+                                * 0 for none                            */
+  unsigned failPercent;        /* chance a call fails, 0 for none       */
+  unsigned seed;               /* random sequence for failPercent       */
+} FaultPlan;
+
+typedef struct {
+  unsigned long calls;         /* malloc and realloc calls              */
+  unsigned long failed;        /* calls failed on purpose               */
+  size_t live;                 /* requested bytes currently allocated   */
+  size_t liveBlocks;           /* blocks currently allocated            */
+} FaultStats;
+
+/* Allocator that makes the malloc and realloc calls chosen by plan fail,
+ * and passes all others to heap. The same plan fails the same calls on
+ * every run. Not thread-safe.
+ */
+const SnsrAlloc_Vmt *
+allocFault(const SnsrAlloc_Vmt *heap, const FaultPlan *plan);
+
+/* Statistics since the allocFault() call. */
+void
+allocFaultStats(FaultStats *stats);
@@ -0,0 +1,347 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK tool that tests recovery from allocation failures.
+ *------------------------------------------------------------------------------
+ * Loads a model and pushes the data.c audio through it, as spot-data.c
+ * does, with the fault injection allocator in fault-alloc.c. A first run
+ * without faults counts the allocation calls. The tool then runs once for
+ * each call N, failing only call N, and classifies each run:
+ *
+ * - error:  the library returned an error code, the expected outcome
+ * - panic:  the library called the panic function
+ * - crash:  the process died on a signal
+ * - leak:   bytes were still allocated after snsrTearDown(), in a run
+ *           that did not panic
+ *
+ * A panic abandons the session on purpose, so bytes still allocated after
+ * one are reported as abandoned, not as a leak.
+ *
+ * Each run is a separate child process, so a crash does not end the sweep.
+ * Use -p to fail calls at random instead, and -x to fail large requests.
+ *
+ * Runs that crash or leak are listed with their N. Reproduce one in a
+ * debugger with -f N -l N.
+ *------------------------------------------------------------------------------
+ */
+
+#include <setjmp.h>
+
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <snsr.h>
+
+#include "fault-alloc.h"
+
+/* See spot-hbg-enUS-1.4.0-m.c */
+extern SnsrCodeModel spot_hbg_enUS_1_3_0_m;
+
+/* See data.c */
+extern unsigned char audioData[];
+extern unsigned int  audioDataLen;
+
+#define BLOCK_MS       15
+#define SAMPLE_RATE 16000
+#define BLOCK_BYTES (BLOCK_MS * SAMPLE_RATE / 1000 * sizeof(short))
+
+/* Utility, returns the lesser of a and b */
+#define MIN(a, b) ((a) < (b)? (a): (b))
+
+typedef enum {
+  TRIAL_OK,
+  TRIAL_ERROR,
+  TRIAL_PANIC,
+  TRIAL_CRASH,
+  TRIAL_OUTCOMES
+} Outcome;
+
+typedef struct {
+  Outcome outcome;
+  SnsrRC rc;                   /* run return code                       */
+  int signal;                  /* TRIAL_CRASH signal number             */
+  unsigned long calls;         /* allocation calls made                 */
+  size_t releaseLive;          /* bytes live after snsrRelease()        */
+  size_t live;                 /* bytes live after snsrTearDown()       */
+  size_t liveBlocks;
+} Trial;
+
+typedef struct {
+  unsigned char *model;        /* task file contents, NULL for built-in */
+  size_t modelSize;
+} Corpus;
+
+static jmp_buf PanicJmp;
+/* Written between setjmp() and longjmp(), so not a local variable */
+static Trial Result;
+
+static const char *OutcomeName[TRIAL_OUTCOMES] = {
+  "ok", "error", "panic", "crash"
+};
+
+
+static void
+fatal(int rc, const char *format, ...)
+{
+  va_list a;
+  fprintf(stderr, "ERROR: ");
+  va_start(a, format);
+  vfprintf(stderr, format, a);
+  va_end(a);
+  fprintf(stderr, "\n");
+  exit(rc);
+}
+
+
+static void
+usage(const char *name)
+{
+  fprintf(stderr,
+          "usage: %s [options]\n"
+          " options:\n"
+          "  -c count    : random runs with -p (default: 100)\n"
+          "  -f first    : first call to fail (default: 1)\n"
+          "  -l last     : last call to fail (default: all)\n"
+          "  -p percent  : fail this share of calls at random instead\n"
+          "  -s step     : fail every step-th call in first..last "
+          "(default: 1)\n"
+          "  -t task     : task filename (default: built-in spotter)\n"
+          "  -v          : show every run\n"
+          "  -x bytes    : fail only requests larger than bytes, once\n",
+          name);
+  exit(199);
+}
+
+
+/* Longjmp back to runTrial() when the library panics. */
+static void
+panicFunc(const char *format, va_list a)
+{
+  longjmp(PanicJmp, SNSR_RC_NO_MEMORY);
+}
+
+
+static void *
+readFile(const char *filename, size_t *size)
+{
+  FILE *f = fopen(filename, "rb");
+  unsigned char *data;
+  long n;
+
+  if (!f) fatal(SNSR_RC_NOT_FOUND, "Could not open \"%s\".", filename);
+  fseek(f, 0, SEEK_END);
+  n = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  data = malloc(n > 0? n: 1);
+  if (!data) fatal(SNSR_RC_NO_MEMORY, "Out of memory.");
+  if (n < 0 || fread(data, 1, n, f) != (size_t)n)
+    fatal(SNSR_RC_ERROR, "Could not read \"%s\".", filename);
+  fclose(f);
+  *size = (size_t)n;
+  return data;
+}
+
+
+/* Load the model and push the audio through it, as spot-data.c does.
+ * Returns SNSR_RC_OK, or the first error.
+ */
+static SnsrRC
+runModel(const Corpus *c)
+{
+  FaultStats stats;
+  SnsrSession s;
+  SnsrRC r;
+  size_t i;
+
+  r = snsrNew(&s);
+  if (r != SNSR_RC_OK) {
+    snsrRelease(s);
+    return r;
+  }
+  snsrLoad(s, c->model?
+           snsrStreamFromMemory(c->model, c->modelSize, SNSR_ST_MODE_READ):
+           snsrStreamFromCode(spot_hbg_enUS_1_3_0_m));
+  r = snsrRC(s);
+  for (i = 0; i < audioDataLen && r == SNSR_RC_OK; i += BLOCK_BYTES) {
+    r = snsrPush(s, SNSR_SOURCE_AUDIO_PCM, audioData + i,
+                 MIN(BLOCK_BYTES, audioDataLen - i));
+    if (r == SNSR_RC_STOP) {
+      snsrClearRC(s);
+      r = SNSR_RC_OK;
+    }
+  }
+  if (r == SNSR_RC_OK) r = snsrStop(s);
+  if (r == SNSR_RC_STOP || r == SNSR_RC_STREAM_END) r = SNSR_RC_OK;
+  snsrRelease(s);
+  allocFaultStats(&stats);
+  Result.releaseLive = stats.live;
+  return r;
+}
+
+
+/* Run the model with the faults in plan, in this process. */
+static void
+runTrial(const Corpus *c, const FaultPlan *plan)
+{
+  FaultStats stats;
+  SnsrRC r;
+
+  memset(&Result, 0, sizeof(Result));
+  snsrConfig(SNSR_CONFIG_PANIC_FUNC, panicFunc);
+  if (setjmp(PanicJmp)) {
+    Result.outcome = TRIAL_PANIC;
+    Result.rc = SNSR_RC_NO_MEMORY;
+  } else {
+    r = snsrConfig(SNSR_CONFIG_ALLOC, allocFault(snsrAllocStdlib(), plan));
+    if (r != SNSR_RC_OK)
+      fatal(r, "Custom allocation failure: %s", snsrRCMessage(r));
+    Result.rc = runModel(c);
+    Result.outcome = Result.rc == SNSR_RC_OK? TRIAL_OK: TRIAL_ERROR;
+  }
+  snsrTearDown();
+  allocFaultStats(&stats);
+  Result.calls = stats.calls;
+  Result.live = stats.live;
+  Result.liveBlocks = stats.liveBlocks;
+}
+
+
+/* Run the model with the faults in plan in a child process. */
+static void
+trial(const Corpus *c, const FaultPlan *plan, Trial *t)
+{
+  int fd[2], status;
+  pid_t pid;
+
+  if (pipe(fd)) fatal(SNSR_RC_ERROR, "could not create a pipe");
+  fflush(stdout);
+  fflush(stderr);
+  if ((pid = fork()) < 0) fatal(SNSR_RC_ERROR, "fork failed");
+  if (!pid) {
+    close(fd[0]);
+    runTrial(c, plan);
+    if (write(fd[1], &Result, sizeof(Result)) != sizeof(Result)) _exit(1);
+    _exit(0);
+  }
+  close(fd[1]);
+  memset(t, 0, sizeof(*t));
+  if (read(fd[0], t, sizeof(*t)) != sizeof(*t)) t->outcome = TRIAL_CRASH;
+  close(fd[0]);
+  waitpid(pid, &status, 0);
+  if (WIFSIGNALED(status)) {
+    t->outcome = TRIAL_CRASH;
+    t->signal = WTERMSIG(status);
+  }
+}
+
+
+/* Print t if it is a problem, or if verbose.
+ * Returns 1 if t crashed or leaked.
+ */
+static int
+report(const char *label, const Trial *t, int verbose)
+{
+  int leaked = t->live && t->outcome != TRIAL_PANIC;
+  int problem = t->outcome == TRIAL_CRASH || leaked;
+
+  if (!problem && !verbose) return 0;
+  printf("%s: %s", label, OutcomeName[t->outcome]);
+  if (t->outcome == TRIAL_CRASH) {
+    if (t->signal) printf(", signal %d (%s)", t->signal, strsignal(t->signal));
+  } else {
+    if (t->outcome == TRIAL_ERROR) printf(", %s", snsrRCMessage(t->rc));
+    if (t->live)
+      printf(", %s %lu bytes in %lu blocks", leaked? "leaked": "abandoned",
+             (unsigned long)t->live, (unsigned long)t->liveBlocks);
+  }
+  printf("\n");
+  return problem;
+}
+
+
+int
+main(int argc, char *argv[])
+{
+  Corpus c;
+  FaultPlan plan;
+  Trial base, t;
+  unsigned long first = 1, last = 0, step = 1, n;
+  unsigned long count[TRIAL_OUTCOMES];
+  long failAbove = 0;
+  const char *task = NULL;
+  int o, percent = 0, runs = 100, problems = 0, trials = 0, verbose = 0;
+  char label[64];
+  extern char *optarg;
+  extern int optind;
+
+  memset(&c, 0, sizeof(c));
+  memset(count, 0, sizeof(count));
+  while ((o = getopt(argc, argv, "c:f:l:p:s:t:vx:?")) >= 0) {
+    switch (o) {
+    case 'c': runs = atoi(optarg); break;
+    case 'f': first = strtoul(optarg, NULL, 10); break;
+    case 'l': last = strtoul(optarg, NULL, 10); break;
+    case 'p': percent = atoi(optarg); break;
+    case 's': step = strtoul(optarg, NULL, 10); break;
+    case 't': task = optarg; break;
+    case 'v': verbose++; break;
+    case 'x': failAbove = atol(optarg); break;
+    default:  usage(argv[0]);
+    }
+  }
+  if (optind != argc || !first || !step || runs <= 0
+      || percent < 0 || percent > 100 || failAbove < 0) usage(argv[0]);
+  if (task) c.model = readFile(task, &c.modelSize);
+
+  /* Baseline, without faults */
+  memset(&plan, 0, sizeof(plan));
+  trial(&c, &plan, &base);
+  if (base.outcome != TRIAL_OK) {
+    report("no faults", &base, 1);
+    fatal(SNSR_RC_ERROR, "The model does not run without faults.");
+  }
+  printf("No faults: %lu allocation calls, %lu bytes live after "
+         "snsrRelease(), %lu after snsrTearDown().\n", base.calls,
+         (unsigned long)base.releaseLive, (unsigned long)base.live);
+  problems += base.live != 0;
+
+  if (failAbove) {
+    plan.failAbove = (size_t)failAbove;
+    trial(&c, &plan, &t);
+    snprintf(label, sizeof(label), "larger than %ld bytes", failAbove);
+    count[t.outcome]++;
+    trials++;
+    problems += report(label, &t, 1);
+  } else if (percent) {
+    plan.failPercent = (unsigned)percent;
+    for (plan.seed = 1; plan.seed <= (unsigned)runs; plan.seed++) {
+      trial(&c, &plan, &t);
+      snprintf(label, sizeof(label), "seed %u", plan.seed);
+      count[t.outcome]++;
+      trials++;
+      problems += report(label, &t, verbose);
+    }
+  } else {
+    if (!last || last > base.calls) last = base.calls;
+    for (n = first; n <= last; n += step) {
+      plan.failAt = n;
+      trial(&c, &plan, &t);
+      snprintf(label, sizeof(label), "call %lu", n);
+      count[t.outcome]++;
+      trials++;
+      problems += report(label, &t, verbose);
+    }
+  }
+
+  printf("%d runs: %lu ok, %lu error, %lu panic, %lu crash. %d with "
+         "problems.\n", trials, count[TRIAL_OK], count[TRIAL_ERROR],
+         count[TRIAL_PANIC], count[TRIAL_CRASH], problems);
+  free(c.model);
+  return problems? 1: 0;
+}
@@ -0,0 +1,586 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK example of a custom stream that decodes FLAC audio,
+ * so compressed corpora can be evaluated without expanding them to WAV.
+ *------------------------------------------------------------------------------
+ * The decoder reads one frame at a time through a small input buffer and
+ * serves reads from the decoded frame. Memory use is set by the maximum
+ * block size in the STREAMINFO header, not by the length of the file.
+ * Multichannel audio is mixed down to mono, samples are scaled to 16 bits,
+ * and rates other than 16 kHz are converted with resample.c.
+ *
+ * Frame and header CRCs are read but not checked: the source is a local
+ * file, not a lossy transport.
+ *------------------------------------------------------------------------------
+ */
+
+#include <snsr.h>
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "flac-stream.h"
+#include "resample.h"
+
+#define SAMPLE_RATE 16000
+/* Source read size in bytes */
+#define INPUT_SIZE   4096
+#define MAX_CHANNELS    8
+#define MAX_LPC_ORDER  32
+
+/* FLAC metadata block types */
+#define FLAC_STREAMINFO 0
+/* Inter-channel decorrelation modes */
+#define LEFT_SIDE      8
+#define SIDE_RIGHT     9
+#define MID_SIDE      10
+
+typedef struct {
+  SnsrStream source;
+  unsigned char *in;           /* source bytes, INPUT_SIZE              */
+  size_t inCount;              /* valid bytes in in                     */
+  size_t inIndex;              /* next byte in in                       */
+  uint64_t cache;              /* bit reader, valid low bits            */
+  unsigned bits;               /* number of valid bits in cache         */
+  int sourceEnd;               /* 1 once the source has no more data    */
+  int truncated;               /* 1 if a read ran past the source end   */
+  unsigned maxBlock;           /* STREAMINFO maximum block size         */
+  unsigned rate;               /* STREAMINFO sample rate in Hz          */
+  unsigned channels;           /* STREAMINFO channel count              */
+  unsigned bps;                /* STREAMINFO bits per sample            */
+  int32_t *channel[MAX_CHANNELS];
+  short *pcm;                  /* mono 16-bit frame, maxBlock samples   */
+  Resampler resampler;         /* rate converter, or NULL at 16 kHz     */
+  short *converted;            /* frame converted to 16 kHz             */
+  const char *ready;           /* next output bytes                     */
+  size_t readyCount;           /* output bytes available at ready       */
+} ProviderData;
+
+
+/* Bit reader ---------------------------------------------------------------*/
+
+static int
+fillByte(ProviderData *d)
+{
+  if (d->inIndex == d->inCount) {
+    if (d->sourceEnd) return 0;
+    d->inCount = snsrStreamRead(d->source, d->in, 1, INPUT_SIZE);
+    d->inIndex = 0;
+    if (snsrStreamRC(d->source) != SNSR_RC_OK) d->sourceEnd = 1;
+    if (!d->inCount) return 0;
+  }
+  d->cache = d->cache << 8 | d->in[d->inIndex++];
+  d->bits += 8;
+  return 1;
+}
+
+
+/* Returns the next n <= 32 bits as an unsigned integer. */
+static uint32_t
+readBits(ProviderData *d, unsigned n)
+{
+  while (d->bits < n) {
+    if (!fillByte(d)) {
+      d->truncated = 1;
+      return 0;
+    }
+  }
+  d->bits -= n;
+  return (uint32_t)((d->cache >> d->bits) & ((UINT64_C(1) << n) - 1));
+}
+
+
+/* Returns the next n <= 32 bits as a two's complement signed integer. */
+static int32_t
+readSigned(ProviderData *d, unsigned n)
+{
+  uint32_t v = readBits(d, n);
+  if (n && n < 32 && (v >> (n - 1))) v -= UINT32_C(1) << n;
+  return (int32_t)v;
+}
+
+
+/* Returns the number of 0 bits before the next 1 bit. */
+static uint32_t
+readUnary(ProviderData *d)
+{
+  uint32_t q = 0;
+  uint64_t v;
+  unsigned top;
+
+  for (;;) {
+    if (!d->bits && !fillByte(d)) {
+      d->truncated = 1;
+      return q;
+    }
+    v = d->cache & ((UINT64_C(1) << d->bits) - 1);
+    if (!v) {
+      q += d->bits;
+      d->bits = 0;
+      continue;
+    }
+#if defined(__GNUC__)
+    top = 63 - __builtin_clzll(v);
+#else
+    for (top = d->bits - 1; !(v >> top); top--)
+      ;
+#endif
+    q += d->bits - 1 - top;
+    d->bits = top;
+    return q;
+  }
+}
+
+
+static void
+alignToByte(ProviderData *d)
+{
+  d->bits -= d->bits & 7;
+}
+
+
+/* Skip n bytes, starting on a byte boundary. */
+static void
+skipBytes(ProviderData *d, size_t n)
+{
+  size_t k;
+
+  alignToByte(d);
+  for (; n && d->bits; n--) d->bits -= 8;
+  k = d->inCount - d->inIndex;
+  if (k > n) k = n;
+  d->inIndex += k;
+  n -= k;
+  if (n && !d->sourceEnd && snsrStreamSkip(d->source, 1, n) != n) {
+    d->sourceEnd = 1;
+    d->truncated = 1;
+  }
+}
+
+
+/* Decoder ------------------------------------------------------------------*/
+
+static SnsrRC
+corrupt(SnsrStream b, ProviderData *d, const char *what)
+{
+  snsrStream_setDetail(b, d->truncated? "FLAC stream is truncated.":
+                       "FLAC stream is corrupt: %s.", what);
+  return SNSR_RC_STREAM;
+}
+
+
+static SnsrRC
+readStreamInfo(SnsrStream b, ProviderData *d)
+{
+  unsigned char magic[4];
+  unsigned last, type, length;
+  int i;
+
+  for (i = 0; i < 4; i++) magic[i] = (unsigned char)readBits(d, 8);
+  if (!memcmp(magic, "ID3", 3)) {
+    /* Skip an ID3v2 tag, its size is 4 x 7 bits */
+    uint32_t size;
+    readBits(d, 8);
+    readBits(d, 8);
+    size = 0;
+    for (i = 0; i < 4; i++) size = size << 7 | (readBits(d, 8) & 0x7f);
+    skipBytes(d, size);
+    for (i = 0; i < 4; i++) magic[i] = (unsigned char)readBits(d, 8);
+  }
+  if (memcmp(magic, "fLaC", 4)) {
+    snsrStream_setDetail(b, "Source is not a FLAC file.");
+    return SNSR_RC_FORMAT_NOT_SUPPORTED;
+  }
+  d->maxBlock = 0;
+  do {
+    last = readBits(d, 1);
+    type = readBits(d, 7);
+    length = readBits(d, 24);
+    if (type == FLAC_STREAMINFO && length >= 34) {
+      readBits(d, 16);                        /* minimum block size */
+      d->maxBlock = readBits(d, 16);
+      readBits(d, 24);                        /* minimum frame size */
+      readBits(d, 24);                        /* maximum frame size */
+      d->rate = readBits(d, 20);
+      d->channels = readBits(d, 3) + 1;
+      d->bps = readBits(d, 5) + 1;
+      readBits(d, 4);                         /* total samples      */
+      readBits(d, 32);
+      length -= 18;
+    }
+    skipBytes(d, length);
+    if (d->truncated) return corrupt(b, d, "metadata");
+  } while (!last);
+
+  if (d->maxBlock < 16 || !d->rate || d->bps < 4) {
+    snsrStream_setDetail(b, "FLAC file has no valid STREAMINFO block.");
+    return SNSR_RC_FORMAT_NOT_SUPPORTED;
+  }
+  return SNSR_RC_OK;
+}
+
+
+/* Read a partitioned Rice coded residual into out[order .. blockSize - 1].
+ */
+static int
+readResidual(ProviderData *d, int32_t *out, unsigned blockSize, unsigned order)
+{
+  unsigned method, partitionOrder, partition, paramBits, escape;
+  unsigned param, n, k, i = order;
+  uint32_t v;
+
+  method = readBits(d, 2);
+  if (method > 1) return 0;
+  paramBits = method? 5: 4;
+  escape = (1u << paramBits) - 1;
+  partitionOrder = readBits(d, 4);
+  if ((blockSize >> partitionOrder) << partitionOrder != blockSize
+      || (blockSize >> partitionOrder) < order) return 0;
+
+  for (partition = 0; partition < 1u << partitionOrder; partition++) {
+    n = (blockSize >> partitionOrder) - (partition? 0: order);
+    param = readBits(d, paramBits);
+    if (param == escape) {
+      unsigned raw = readBits(d, 5);
+      for (k = 0; k < n; k++) out[i++] = raw? readSigned(d, raw): 0;
+    } else {
+      for (k = 0; k < n; k++) {
+        v = readUnary(d) << param;
+        v |= readBits(d, param);
+        out[i++] = (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+      }
+    }
+    if (d->truncated) return 0;
+  }
+  return 1;
+}
+
+
+static int
+readSubframe(ProviderData *d, int32_t *s, unsigned blockSize, unsigned bps)
+{
+  unsigned type, wasted = 0, order, i, j;
+  int32_t coef[MAX_LPC_ORDER];
+
+  if (readBits(d, 1)) return 0;
+  type = readBits(d, 6);
+  if (readBits(d, 1)) wasted = readUnary(d) + 1;
+  if (wasted >= bps) return 0;
+  bps -= wasted;
+
+  if (type == 0) {
+    int32_t v = readSigned(d, bps);
+    for (i = 0; i < blockSize; i++) s[i] = v;
+
+  } else if (type == 1) {
+    for (i = 0; i < blockSize; i++) s[i] = readSigned(d, bps);
+
+  } else if (type >= 8 && type <= 12) {
+    order = type - 8;
+    if (order > blockSize) return 0;
+    for (i = 0; i < order; i++) s[i] = readSigned(d, bps);
+    if (!readResidual(d, s, blockSize, order)) return 0;
+    switch (order) {
+    case 1:
+      for (i = 1; i < blockSize; i++) s[i] += s[i - 1];
+      break;
+    case 2:
+      for (i = 2; i < blockSize; i++) s[i] += 2 * s[i - 1] - s[i - 2];
+      break;
+    case 3:
+      for (i = 3; i < blockSize; i++)
+        s[i] += 3 * (s[i - 1] - s[i - 2]) + s[i - 3];
+      break;
+    case 4:
+      for (i = 4; i < blockSize; i++)
+        s[i] += 4 * (s[i - 1] + s[i - 3]) - 6 * s[i - 2] - s[i - 4];
+      break;
+    }
+
+  } else if (type >= 32) {
+    unsigned precision;
+    int shift;
+    order = (type & 31) + 1;
+    if (order > blockSize) return 0;
+    for (i = 0; i < order; i++) s[i] = readSigned(d, bps);
+    precision = readBits(d, 4) + 1;
+    shift = readSigned(d, 5);
+    if (precision == 16 || shift < 0) return 0;
+    for (j = 0; j < order; j++) coef[j] = readSigned(d, precision);
+    if (!readResidual(d, s, blockSize, order)) return 0;
+    for (i = order; i < blockSize; i++) {
+      int64_t sum = 0;
+      for (j = 0; j < order; j++) sum += (int64_t)coef[j] * s[i - 1 - j];
+      s[i] += (int32_t)(sum >> shift);
+    }
+
+  } else {
+    return 0;
+  }
+
+  if (wasted)
+    for (i = 0; i < blockSize; i++) s[i] = (int32_t)((uint32_t)s[i] << wasted);
+  return !d->truncated;
+}
+
+
+/* Decode the next frame into d->pcm.
+ * Returns the number of samples decoded, 0 at the end of the stream,
+ * or -1 on error.
+ */
+static int
+readFrame(SnsrStream b, ProviderData *d)
+{
+  static const unsigned SampleSize[8] = {0, 8, 12, 0, 16, 20, 24, 32};
+  unsigned blockCode, rateCode, assignment, sizeCode;
+  unsigned blockSize, channels, bps, c, i;
+  uint32_t x;
+  int32_t *s0 = d->channel[0], *s1 = d->channel[1];
+
+  /* Frames start on a byte boundary with 0xfff8 or 0xfff9 */
+  alignToByte(d);
+  x = readBits(d, 8);
+  for (;;) {
+    if (d->truncated) return 0;
+    if (x == 0xff) {
+      x = readBits(d, 8);
+      if ((x & 0xfe) == 0xf8) break;
+    } else {
+      x = readBits(d, 8);
+    }
+  }
+
+  blockCode = readBits(d, 4);
+  rateCode = readBits(d, 4);
+  assignment = readBits(d, 4);
+  sizeCode = readBits(d, 3);
+  readBits(d, 1);
+  /* Frame or sample number, UTF-8 coded. A lead byte with bit 7 clear
+   * is the whole number, otherwise each further 1 bit adds a byte.
+   */
+  x = readBits(d, 8);
+  if (x & 0x80)
+    for (x <<= 1; x & 0x80; x <<= 1) readBits(d, 8);
+
+  if (blockCode == 0) {
+    corrupt(b, d, "reserved block size");
+    return -1;
+  } else if (blockCode == 1) {
+    blockSize = 192;
+  } else if (blockCode <= 5) {
+    blockSize = 576 << (blockCode - 2);
+  } else if (blockCode == 6) {
+    blockSize = readBits(d, 8) + 1;
+  } else if (blockCode == 7) {
+    blockSize = readBits(d, 16) + 1;
+  } else {
+    blockSize = 256 << (blockCode - 8);
+  }
+  if (rateCode == 12) readBits(d, 8);
+  else if (rateCode == 13 || rateCode == 14) readBits(d, 16);
+  readBits(d, 8);                             /* header CRC-8 */
+
+  channels = assignment < LEFT_SIDE? assignment + 1: 2;
+  bps = sizeCode? SampleSize[sizeCode]: d->bps;
+  if (assignment > MID_SIDE || channels != d->channels || !bps
+      || blockSize > d->maxBlock) {
+    corrupt(b, d, "invalid frame header");
+    return -1;
+  }
+
+  for (c = 0; c < channels; c++) {
+    unsigned side = (assignment == LEFT_SIDE && c == 1)
+      || (assignment == SIDE_RIGHT && c == 0)
+      || (assignment == MID_SIDE && c == 1);
+    if (!readSubframe(d, d->channel[c], blockSize, bps + side)) {
+      corrupt(b, d, "invalid subframe");
+      return -1;
+    }
+  }
+  alignToByte(d);
+  readBits(d, 16);                            /* frame CRC-16 */
+
+  switch (assignment) {
+  case LEFT_SIDE:
+    for (i = 0; i < blockSize; i++) s1[i] = s0[i] - s1[i];
+    break;
+  case SIDE_RIGHT:
+    for (i = 0; i < blockSize; i++) s0[i] += s1[i];
+    break;
+  case MID_SIDE:
+    for (i = 0; i < blockSize; i++) {
+      int32_t mid = (int32_t)((uint32_t)s0[i] << 1) | (s1[i] & 1);
+      s0[i] = (mid + s1[i]) >> 1;
+      s1[i] = (mid - s1[i]) >> 1;
+    }
+    break;
+  }
+
+  /* Mix down to mono and scale to 16 bits */
+  for (i = 0; i < blockSize; i++) {
+    int64_t sum = 0;
+    int32_t v;
+    for (c = 0; c < channels; c++) sum += d->channel[c][i];
+    v = (int32_t)(sum / (int)channels);
+    if (bps > 16) v >>= bps - 16;
+    else v = (int32_t)((uint32_t)v << (16 - bps));
+    d->pcm[i] = (short)(v > 32767? 32767: v < -32768? -32768: v);
+  }
+  return (int)blockSize;
+}
+
+
+/* Stream provider ----------------------------------------------------------*/
+
+static void
+freeBuffers(ProviderData *d)
+{
+  resamplerRelease(d->resampler);
+  free(d->in);
+  free(d->channel[0]);
+  free(d->pcm);
+  free(d->converted);
+  d->resampler = NULL;
+  d->in = NULL;
+  memset(d->channel, 0, sizeof(d->channel));
+  d->pcm = d->converted = NULL;
+}
+
+
+static SnsrRC
+streamOpen(SnsrStream b)
+{
+  ProviderData *d = (ProviderData *)snsrStream_getData(b);
+  unsigned c;
+  SnsrRC r;
+
+  r = snsrStreamOpen(d->source);
+  if (r != SNSR_RC_OK) {
+    snsrStream_setDetail(b, "%s", snsrStreamErrorDetail(d->source));
+    return r;
+  }
+  freeBuffers(d);
+  d->inCount = d->inIndex = 0;
+  d->bits = 0;
+  d->sourceEnd = d->truncated = 0;
+  d->readyCount = 0;
+  d->in = malloc(INPUT_SIZE);
+  if (!d->in) return SNSR_RC_NO_MEMORY;
+  r = readStreamInfo(b, d);
+  if (r != SNSR_RC_OK) return r;
+
+  d->channel[0] = malloc((size_t)d->channels * d->maxBlock * sizeof(int32_t));
+  d->pcm = malloc(d->maxBlock * sizeof(*d->pcm));
+  if (d->rate != SAMPLE_RATE) {
+    d->resampler = resamplerNew(d->rate, SAMPLE_RATE, d->maxBlock);
+    if (d->resampler)
+      d->converted = malloc(resamplerMaxOut(d->resampler, d->maxBlock)
+                            * sizeof(*d->converted));
+  }
+  if (!d->channel[0] || !d->pcm
+      || (d->rate != SAMPLE_RATE && (!d->resampler || !d->converted))) {
+    freeBuffers(d);
+    return SNSR_RC_NO_MEMORY;
+  }
+  for (c = 1; c < d->channels; c++)
+    d->channel[c] = d->channel[0] + (size_t)c * d->maxBlock;
+  return SNSR_RC_OK;
+}
+
+
+static SnsrRC
+streamClose(SnsrStream b)
+{
+  ProviderData *d = (ProviderData *)snsrStream_getData(b);
+
+  freeBuffers(d);
+  return snsrStreamClose(d->source);
+}
+
+
+static void
+streamRelease(SnsrStream b)
+{
+  ProviderData *d = (ProviderData *)snsrStream_getData(b);
+
+  freeBuffers(d);
+  snsrRelease(d->source);
+  free(d);
+}
+
+
+static size_t
+streamRead(SnsrStream b, void *buffer, size_t size)
+{
+  ProviderData *d = (ProviderData *)snsrStream_getData(b);
+  size_t n, total = 0;
+  int count;
+
+  while (total < size) {
+    if (!d->readyCount) {
+      count = readFrame(b, d);
+      if (count <= 0) {
+        snsrStream_setRC(b, count? SNSR_RC_STREAM: SNSR_RC_EOF);
+        break;
+      }
+      if (d->resampler) {
+        n = resamplerProcess(d->resampler, d->pcm, count, d->converted);
+        d->ready = (const char *)d->converted;
+      } else {
+        n = count;
+        d->ready = (const char *)d->pcm;
+      }
+      d->readyCount = n * sizeof(short);
+      continue;
+    }
+    n = d->readyCount < size - total? d->readyCount: size - total;
+    memcpy((char *)buffer + total, d->ready, n);
+    d->ready += n;
+    d->readyCount -= n;
+    total += n;
+  }
+  return total;
+}
+
+
+static SnsrStream_Vmt ProviderDef = {
+  "flac",
+  &streamOpen, &streamClose, &streamRelease, &streamRead, NULL
+};
+
+
+SnsrStream
+streamFromFLAC(SnsrStream source)
+{
+  ProviderData *d;
+  SnsrStream b;
+
+  if (!source) return NULL;
+  snsrRetain(source);
+  d = calloc(1, sizeof(*d));
+  b = d? snsrStream_alloc(&ProviderDef, d, 1, 0): NULL;
+  if (!b) {
+    snsrRelease(source);
+    free(d);
+    return NULL;
+  }
+  d->source = source;
+  return b;
+}
+
+
+int
+isFLACFilename(const char *filename)
+{
+  size_t n = strlen(filename);
+  const char *ext = ".flac";
+  size_t i;
+
+  if (n < 5) return 0;
+  for (i = 0; i < 5; i++)
+    if (tolower((unsigned char)filename[n - 5 + i]) != ext[i]) return 0;
+  return 1;
+}
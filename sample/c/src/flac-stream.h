@@ -0,0 +1,16 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK custom stream header. See flac-stream.c.
+ *------------------------------------------------------------------------------
+ */
+
+/* Decode the FLAC file in source to the 16 kHz 16-bit mono PCM the
+ * recognizer expects. Takes ownership of source.
+ */
+SnsrStream
+streamFromFLAC(SnsrStream source);
+
+/* Returns 1 if filename has a .flac extension, 0 otherwise. */
+int
+isFLACFilename(const char *filename);
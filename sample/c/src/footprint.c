@@ -0,0 +1,163 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK tool that reports the memory footprint of models.
+ *------------------------------------------------------------------------------
+ * For each task file listed, reports:
+ *
+ * - the file size,
+ * - the heap in use once the model is loaded into RAM with snsrLoad(), and
+ * - the peak heap use while the data.c audio is pushed through it,
+ *
+ * as counted by the heap profiler in alloc-profile.c.
+ *
+ * With -c, the built-in spot-hbg-enUS-1.4.0-m.c model is added, loaded from
+ * code space with snsrStreamFromCode(). Compare it to the
+ * spot-hbg-enUS-1.4.0-m.snsr row to see the RAM that running from code
+ * space saves.
+ *
+ * Tasks that do not accept audio, such as enrollment tasks and templates
+ * with empty slots, show "-" for the peak. The output is a fixed-width table
+ * meant to be compared between SDK releases; see make footprint, which also
+ * adds snsr-edit -p pruned copies of each model.
+ *------------------------------------------------------------------------------
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <snsr.h>
+
+#include "alloc-profile.h"
+
+/* See spot-hbg-enUS-1.4.0-m.c */
+extern SnsrCodeModel spot_hbg_enUS_1_3_0_m;
+
+/* See data.c */
+extern unsigned char audioData[];
+extern unsigned int  audioDataLen;
+
+#define BLOCK_MS       15
+#define SAMPLE_RATE 16000
+#define BLOCK_BYTES (BLOCK_MS * SAMPLE_RATE / 1000 * sizeof(short))
+
+/* Utility, returns the lesser of a and b */
+#define MIN(a, b) ((a) < (b)? (a): (b))
+
+
+static void
+fatal(int rc, const char *format, ...)
+{
+  va_list a;
+  fprintf(stderr, "ERROR: ");
+  va_start(a, format);
+  vfprintf(stderr, format, a);
+  va_end(a);
+  fprintf(stderr, "\n");
+  exit(rc);
+}
+
+
+static void
+usage(const char *name)
+{
+  fprintf(stderr,
+          "usage: %s [-c] [task ...]\n"
+          " options:\n"
+          "  -c          : add the built-in code-space spotter model\n",
+          name);
+  exit(199);
+}
+
+
+/* Size of filename in bytes. */
+static long
+fileSize(const char *filename)
+{
+  FILE *f = fopen(filename, "rb");
+  long n;
+
+  if (!f) fatal(SNSR_RC_NOT_FOUND, "Could not open \"%s\".", filename);
+  fseek(f, 0, SEEK_END);
+  n = ftell(f);
+  fclose(f);
+  return n;
+}
+
+
+/* Load the model from filename, or from code space if filename is NULL,
+ * run the data.c audio through it, and print one row of the table.
+ */
+static void
+footprint(const char *filename)
+{
+  const char *name;
+  SnsrSession s;
+  SnsrRC r;
+  size_t i, loaded;
+  int runs = 1;
+
+  r = snsrConfig(SNSR_CONFIG_ALLOC, allocProfile(snsrAllocStdlib()));
+  if (r != SNSR_RC_OK)
+    fatal(r, "Custom allocation failure: %s", snsrRCMessage(r));
+  r = snsrNew(&s);
+  if (r != SNSR_RC_OK)
+    fatal(r, "%s", s? snsrErrorDetail(s): snsrRCMessage(r));
+  snsrLoad(s, filename? snsrStreamFromFileName(filename, "r"):
+           snsrStreamFromCode(spot_hbg_enUS_1_3_0_m));
+  if (snsrRC(s) != SNSR_RC_OK)
+    fatal(snsrRC(s), "%s: %s", filename? filename: "<built-in>",
+          snsrErrorDetail(s));
+  loaded = allocProfileLive();
+
+  /* Only the audio run counts towards the peak */
+  allocProfilePhase(ALLOC_PHASE_RUN);
+  for (i = 0; i < audioDataLen && runs; i += BLOCK_BYTES) {
+    r = snsrPush(s, SNSR_SOURCE_AUDIO_PCM, audioData + i,
+                 MIN(BLOCK_BYTES, audioDataLen - i));
+    if (r == SNSR_RC_STOP) snsrClearRC(s);
+    else if (r != SNSR_RC_OK) runs = 0;
+  }
+  if (runs) {
+    r = snsrStop(s);
+    runs = r == SNSR_RC_OK || r == SNSR_RC_STOP || r == SNSR_RC_STREAM_END;
+  }
+
+  if (filename) {
+    name = strrchr(filename, '/');
+    printf("%-44s %10ld", name? name + 1: filename, fileSize(filename));
+  } else {
+    printf("%-44s %10s", "spot-hbg-enUS-1.4.0-m.c (code space)", "-");
+  }
+  printf(" %10lu", (unsigned long)loaded);
+  if (runs)
+    printf(" %10lu\n", (unsigned long)allocProfilePeak(ALLOC_PHASE_RUN));
+  else printf(" %10s\n", "-");
+
+  snsrRelease(s);
+  snsrTearDown();
+}
+
+
+int
+main(int argc, char *argv[])
+{
+  int i, o, code = 0;
+  extern int optind;
+
+  while ((o = getopt(argc, argv, "c?")) >= 0) {
+    switch (o) {
+    case 'c': code = 1; break;
+    default:  usage(argv[0]);
+    }
+  }
+  if (optind == argc && !code) usage(argv[0]);
+
+  printf("%-44s %10s %10s %10s\n",
+         "model", "file", "load heap", "peak heap");
+  for (i = optind; i < argc; i++) footprint(argv[i]);
+  if (code) footprint(NULL);
+  return 0;
+}
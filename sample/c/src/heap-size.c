@@ -0,0 +1,500 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK tool that finds the smallest snsrAllocTLSF() heap
+ * pool a model needs, such as HEAP_SIZE in spot-data.c.
+ *------------------------------------------------------------------------------
+ * The model and an audio corpus are first run once with a large pool under
+ * snsrAllocPerf(), which gives the peak heap use and the library's own pool
+ * size estimate. The tool then bisects between the peak and that estimate,
+ * running the corpus through a fresh pool of each candidate size. A size is
+ * too small if any allocation fails, whether the library panics or reports
+ * SNSR_RC_NO_MEMORY.
+ *
+ * Audio is pushed in 15 ms blocks with snsrPush(), as on a device. The model
+ * is the built-in spot-hbg-enUS-1.4.0-m.c model unless -t is given, and the
+ * corpus is the data.c audio unless wave files are listed.
+ *------------------------------------------------------------------------------
+ */
+
+#include <setjmp.h>
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <snsr.h>
+
+/* See spot-hbg-enUS-1.4.0-m.c */
+extern SnsrCodeModel spot_hbg_enUS_1_3_0_m;
+
+/* See data.c */
+extern unsigned char audioData[];
+extern unsigned int  audioDataLen;
+
+#define BLOCK_MS       15
+#define SAMPLE_RATE 16000
+#define BLOCK_BYTES (BLOCK_MS * SAMPLE_RATE / 1000 * sizeof(short))
+
+/* Largest pool tried, in bytes */
+#define DEFAULT_MAX_POOL   (64 * 1024 * 1024)
+/* Bisection stops when the pass and fail sizes are this close */
+#define DEFAULT_RESOLUTION 64
+/* Safety margin added to the recommended HEAP_SIZE, in percent */
+#define DEFAULT_MARGIN     10
+/* The recommended HEAP_SIZE is rounded up to a multiple of this */
+#define HEAP_SIZE_ALIGN    1024
+
+/* Utility, returns the lesser of a and b */
+#define MIN(a, b) ((a) < (b)? (a): (b))
+
+typedef struct {
+  unsigned char *data;
+  size_t size;
+} Clip;
+
+typedef struct {
+  unsigned char *model;        /* task file contents, NULL for built-in */
+  size_t modelSize;
+  Clip *clip;
+  int clips;
+  int repeat;                  /* times the corpus is pushed per run    */
+  int verbose;
+} Corpus;
+
+/* Allocator wrapper that tracks the bytes and blocks in use, their peaks,
+ * and allocation failures.
+ */
+typedef struct {
+  const SnsrAlloc_Vmt *heap;   /* wrapped allocator                     */
+  size_t inUse;                /* bytes in allocated blocks             */
+  size_t peak;                 /* high-water mark of inUse              */
+  size_t count;                /* number of allocated blocks            */
+  size_t peakCount;            /* high-water mark of count              */
+  size_t failed;               /* malloc and realloc calls that failed  */
+} Meter;
+
+static Meter Heap;
+static SnsrAlloc_Vmt MeterVmt;
+static jmp_buf PanicJmp;
+
+
+static void
+fatal(int rc, const char *format, ...)
+{
+  va_list a;
+  fprintf(stderr, "ERROR: ");
+  va_start(a, format);
+  vfprintf(stderr, format, a);
+  va_end(a);
+  fprintf(stderr, "\n");
+  exit(rc);
+}
+
+
+static void
+usage(const char *name)
+{
+  fprintf(stderr,
+          "usage: %s [options] [wavefile ...]\n"
+          " options:\n"
+          "  -g bytes    : bisection resolution (default: %i)\n"
+          "  -m percent  : safety margin (default: %i)\n"
+          "  -q          : print only the recommended HEAP_SIZE\n"
+          "  -r count    : push the corpus count times per run (default: 1)\n"
+          "  -t task     : task filename (default: built-in spotter)\n"
+          "  -v          : show snsrAllocPerf() statistics and each trial\n"
+          "  -x bytes    : largest pool to try (default: %i)\n"
+          "\nWithout wave files, the built-in data.c audio is used.\n",
+          name, DEFAULT_RESOLUTION, DEFAULT_MARGIN, DEFAULT_MAX_POOL);
+  exit(199);
+}
+
+
+/* Longjmp back to trial() when the library runs out of heap. */
+static void
+panicFunc(const char *format, va_list a)
+{
+  longjmp(PanicJmp, SNSR_RC_NO_MEMORY);
+}
+
+
+static size_t
+blockSize(Meter *m, void *ptr)
+{
+  return m->heap->size? m->heap->size(m->heap->ctx, ptr): 0;
+}
+
+
+static void
+allocated(Meter *m, void *ptr)
+{
+  m->inUse += blockSize(m, ptr);
+  if (m->inUse > m->peak) m->peak = m->inUse;
+  if (++m->count > m->peakCount) m->peakCount = m->count;
+}
+
+
+static void *
+meterMalloc(void *ctx, size_t size)
+{
+  Meter *m = (Meter *)ctx;
+  void *p = m->heap->malloc(m->heap->ctx, size);
+
+  if (p) allocated(m, p);
+  else m->failed++;
+  return p;
+}
+
+
+static void
+meterFree(void *ctx, void *ptr)
+{
+  Meter *m = (Meter *)ctx;
+
+  m->inUse -= blockSize(m, ptr);
+  m->count--;
+  m->heap->free(m->heap->ctx, ptr);
+}
+
+
+static void *
+meterRealloc(void *ctx, void *ptr, size_t size)
+{
+  Meter *m = (Meter *)ctx;
+  size_t old = blockSize(m, ptr);
+  void *p = m->heap->realloc(m->heap->ctx, ptr, size);
+
+  if (!p) {
+    m->failed++;
+    return NULL;
+  }
+  m->inUse -= old;
+  m->count--;
+  allocated(m, p);
+  return p;
+}
+
+
+static size_t
+meterSize(void *ctx, void *ptr)
+{
+  Meter *m = (Meter *)ctx;
+  return m->heap->size(m->heap->ctx, ptr);
+}
+
+
+static size_t
+meterRoundUp(void *ctx, size_t size)
+{
+  Meter *m = (Meter *)ctx;
+  return m->heap->roundUp(m->heap->ctx, size);
+}
+
+
+static size_t
+meterMinPoolSize(void *ctx, size_t maxAlloc, size_t maxCount)
+{
+  Meter *m = (Meter *)ctx;
+  return m->heap->minPoolSize(m->heap->ctx, maxAlloc, maxCount);
+}
+
+
+static SnsrAllocRC
+meterSetUp(void *ctx)
+{
+  Meter *m = (Meter *)ctx;
+  return m->heap->setUp? m->heap->setUp(m->heap->ctx): SNSR_ALLOC_RC_OK;
+}
+
+
+static SnsrAllocRC
+meterTearDown(void *ctx)
+{
+  Meter *m = (Meter *)ctx;
+  return m->heap->tearDown? m->heap->tearDown(m->heap->ctx): SNSR_ALLOC_RC_OK;
+}
+
+
+/* Wrap heap in the global Meter and return its method table. */
+static const SnsrAlloc_Vmt *
+meter(const SnsrAlloc_Vmt *heap)
+{
+  memset(&Heap, 0, sizeof(Heap));
+  Heap.heap = heap;
+  memset(&MeterVmt, 0, sizeof(MeterVmt));
+  MeterVmt.malloc = meterMalloc;
+  MeterVmt.free = meterFree;
+  MeterVmt.realloc = meterRealloc;
+  if (heap->size) MeterVmt.size = meterSize;
+  if (heap->roundUp) MeterVmt.roundUp = meterRoundUp;
+  if (heap->minPoolSize) MeterVmt.minPoolSize = meterMinPoolSize;
+  MeterVmt.setUp = meterSetUp;
+  MeterVmt.tearDown = meterTearDown;
+  MeterVmt.ctx = &Heap;
+  return &MeterVmt;
+}
+
+
+/* Result callback function. Retrieves the result like an application
+ * would, so those allocations are included.
+ */
+static SnsrRC
+resultEvent(SnsrSession s, const char *key, void *privateData)
+{
+  const char *phrase;
+  double begin, end;
+
+  snsrGetDouble(s, SNSR_RES_BEGIN_SAMPLE, &begin);
+  snsrGetDouble(s, SNSR_RES_END_SAMPLE, &end);
+  return snsrGetString(s, SNSR_RES_TEXT, &phrase);
+}
+
+
+/* Load the model and push the corpus through it c->repeat times.
+ * Returns SNSR_RC_OK, or the first error.
+ */
+static SnsrRC
+runCorpus(const Corpus *c)
+{
+  SnsrSession s;
+  SnsrRC r;
+  size_t i;
+  int k, n;
+
+  r = snsrNew(&s);
+  if (r != SNSR_RC_OK) return r;
+  snsrLoad(s, c->model?
+           snsrStreamFromMemory(c->model, c->modelSize, SNSR_ST_MODE_READ):
+           snsrStreamFromCode(spot_hbg_enUS_1_3_0_m));
+  snsrSetHandler(s, SNSR_RESULT_EVENT, snsrCallback(resultEvent, NULL, NULL));
+  if (snsrRC(s) == SNSR_RC_SETTING_NOT_FOUND) snsrClearRC(s);
+  r = snsrRC(s);
+
+  for (k = 0; k < c->repeat && r == SNSR_RC_OK; k++) {
+    for (n = 0; n < c->clips && r == SNSR_RC_OK; n++) {
+      const Clip *p = c->clip + n;
+      for (i = 0; i < p->size && r == SNSR_RC_OK; i += BLOCK_BYTES) {
+        r = snsrPush(s, SNSR_SOURCE_AUDIO_PCM, p->data + i,
+                     MIN(BLOCK_BYTES, p->size - i));
+        if (r == SNSR_RC_STOP) {
+          snsrClearRC(s);
+          r = SNSR_RC_OK;
+        }
+      }
+    }
+  }
+  if (r == SNSR_RC_OK) r = snsrStop(s);
+  if (r == SNSR_RC_STOP || r == SNSR_RC_STREAM_END) r = SNSR_RC_OK;
+  if (r != SNSR_RC_OK && c->verbose)
+    fprintf(stderr, "  %s\n", snsrErrorDetail(s));
+  snsrRelease(s);
+  return r;
+}
+
+
+/* Run the corpus with heap as the library allocator.
+ * Returns 1 if every allocation succeeded and the run completed.
+ */
+static int
+run(const Corpus *c, const SnsrAlloc_Vmt *heap)
+{
+  SnsrRC r;
+
+  snsrConfig(SNSR_CONFIG_PANIC_FUNC, panicFunc);
+  if (setjmp(PanicJmp)) {
+    /* Abandon the heap, it is re-initialized for the next run. */
+    snsrTearDown();
+    return 0;
+  }
+  r = snsrConfig(SNSR_CONFIG_ALLOC, heap);
+  if (r != SNSR_RC_OK)
+    fatal(r, "Custom allocation failure: %s", snsrRCMessage(r));
+  r = runCorpus(c);
+  snsrTearDown();
+  return r == SNSR_RC_OK && !Heap.failed;
+}
+
+
+/* Run the corpus with a TLSF pool of size bytes. */
+static int
+trial(const Corpus *c, void *pool, size_t size)
+{
+  const SnsrAlloc_Vmt *tlsf = snsrAllocTLSF(pool, size);
+  int ok;
+
+  if (!tlsf) return 0;
+  ok = run(c, meter(tlsf));
+  if (c->verbose)
+    fprintf(stderr, "%9lu bytes: %s\n", (unsigned long)size,
+            ok? "pass": "fail");
+  return ok;
+}
+
+
+static void *
+readFile(const char *filename, size_t *size)
+{
+  FILE *f = fopen(filename, "rb");
+  unsigned char *data;
+  long n;
+
+  if (!f) fatal(SNSR_RC_NOT_FOUND, "Could not open \"%s\".", filename);
+  fseek(f, 0, SEEK_END);
+  n = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  data = malloc(n > 0? n: 1);
+  if (!data) fatal(SNSR_RC_NO_MEMORY, "Out of memory.");
+  if (n < 0 || fread(data, 1, n, f) != (size_t)n)
+    fatal(SNSR_RC_ERROR, "Could not read \"%s\".", filename);
+  fclose(f);
+  *size = (size_t)n;
+  return data;
+}
+
+
+/* Decode filename to 16 kHz 16-bit PCM in memory, with the default
+ * allocator, so that runs do not open files.
+ */
+static void
+readAudio(const char *filename, Clip *clip)
+{
+  SnsrStream a;
+  size_t n, capacity = 0;
+
+  a = snsrStreamFromAudioFile(filename, "r", SNSR_ST_AF_DEFAULT);
+  snsrRetain(a);
+  if (snsrStreamOpen(a) != SNSR_RC_OK)
+    fatal(snsrStreamRC(a), "%s", snsrStreamErrorDetail(a));
+  clip->data = NULL;
+  clip->size = 0;
+  do {
+    if (clip->size == capacity) {
+      capacity = capacity? 2 * capacity: 64 * 1024;
+      clip->data = realloc(clip->data, capacity);
+      if (!clip->data) fatal(SNSR_RC_NO_MEMORY, "Out of memory.");
+    }
+    n = snsrStreamRead(a, clip->data + clip->size, 1, capacity - clip->size);
+    clip->size += n;
+  } while (snsrStreamRC(a) == SNSR_RC_OK);
+  if (snsrStreamRC(a) != SNSR_RC_EOF)
+    fatal(snsrStreamRC(a), "%s", snsrStreamErrorDetail(a));
+  snsrRelease(a);
+}
+
+
+int
+main(int argc, char *argv[])
+{
+  Corpus c;
+  void *pool;
+  size_t estimate, peak, peakCount, lo, hi, mid, recommended;
+  size_t maxPool = DEFAULT_MAX_POOL, resolution = DEFAULT_RESOLUTION;
+  const char *task = NULL;
+  double seconds = 0;
+  int i, o, margin = DEFAULT_MARGIN, quiet = 0, trials = 0;
+  extern char *optarg;
+  extern int optind;
+
+  memset(&c, 0, sizeof(c));
+  c.repeat = 1;
+  while ((o = getopt(argc, argv, "g:m:qr:t:vx:?")) >= 0) {
+    switch (o) {
+    case 'g': resolution = (size_t)atol(optarg); break;
+    case 'm': margin = atoi(optarg); break;
+    case 'q': quiet = 1; break;
+    case 'r': c.repeat = atoi(optarg); break;
+    case 't': task = optarg; break;
+    case 'v': c.verbose = 1; break;
+    case 'x': maxPool = (size_t)atol(optarg); break;
+    default:  usage(argv[0]);
+    }
+  }
+  if (!resolution || margin < 0 || c.repeat <= 0 || !maxPool)
+    usage(argv[0]);
+
+  if (task) c.model = readFile(task, &c.modelSize);
+  c.clips = optind < argc? argc - optind: 1;
+  c.clip = calloc(c.clips, sizeof(*c.clip));
+  if (!c.clip) fatal(SNSR_RC_NO_MEMORY, "Out of memory.");
+  if (optind < argc) {
+    for (i = 0; i < c.clips; i++) readAudio(argv[optind + i], c.clip + i);
+    snsrTearDown();
+  } else {
+    c.clip[0].data = audioData;
+    c.clip[0].size = audioDataLen;
+  }
+  for (i = 0; i < c.clips; i++)
+    seconds += (double)c.clip[i].size / (SAMPLE_RATE * sizeof(short));
+
+  pool = malloc(maxPool);
+  if (!pool) fatal(SNSR_RC_NO_MEMORY, "Could not allocate a %lu byte pool.",
+                   (unsigned long)maxPool);
+
+  /* Measure the peak, and get the snsrAllocPerf() pool estimate */
+  if (!run(&c, snsrAllocPerf(meter(snsrAllocTLSF(pool, maxPool)))))
+    fatal(SNSR_RC_NO_MEMORY, "The corpus does not run in a %lu byte pool, "
+          "use -x to try a larger one.", (unsigned long)maxPool);
+  peak = Heap.peak;
+  peakCount = Heap.peakCount;
+  estimate = snsrAllocPerfStats(c.verbose?
+                                snsrStreamFromFILE(stderr, SNSR_ST_MODE_WRITE):
+                                NULL);
+  snsrTearDown();
+
+  /* Bisect between a known failing size and a known passing one */
+  lo = peak;
+  hi = estimate > lo? estimate: 2 * lo;
+  if (hi > maxPool) hi = maxPool;
+  for (;;) {
+    trials++;
+    if (trial(&c, pool, hi)) break;
+    if (hi == maxPool)
+      fatal(SNSR_RC_NO_MEMORY, "The corpus does not run in a %lu byte pool, "
+            "use -x to try a larger one.", (unsigned long)maxPool);
+    lo = hi;
+    hi = MIN(2 * hi, maxPool);
+  }
+  while (hi - lo > resolution) {
+    mid = (lo + (hi - lo) / 2) & ~(sizeof(size_t) - 1);
+    if (mid <= lo) break;
+    trials++;
+    if (trial(&c, pool, mid)) hi = mid;
+    else lo = mid;
+  }
+
+  /* TLSF placement depends on the pool size, so the margin is checked too */
+  recommended = hi + hi / 100 * margin;
+  recommended = (recommended + HEAP_SIZE_ALIGN - 1)
+    / HEAP_SIZE_ALIGN * HEAP_SIZE_ALIGN;
+  if (recommended > maxPool) recommended = maxPool;
+  trials++;
+  if (!trial(&c, pool, recommended))
+    fatal(SNSR_RC_NO_MEMORY, "The corpus failed with the recommended %lu byte "
+          "pool, use a larger -m margin.", (unsigned long)recommended);
+  free(pool);
+
+  if (quiet) {
+    printf("%lu\n", (unsigned long)recommended);
+    return 0;
+  }
+  printf("Model:                %s\n", task? task: "spot-hbg-enUS-1.4.0-m.c");
+  if (optind < argc) printf("Corpus:               %d wave file%s", c.clips,
+                            c.clips == 1? "": "s");
+  else printf("Corpus:               data.c");
+  printf(", %.1f s of audio, pushed %d time%s\n", seconds, c.repeat,
+         c.repeat == 1? "": "s");
+  printf("Peak heap use:        %9lu bytes in %lu blocks\n",
+         (unsigned long)peak, (unsigned long)peakCount);
+  printf("snsrAllocPerf():      %9lu bytes estimated\n",
+         (unsigned long)estimate);
+  printf("Smallest TLSF pool:   %9lu bytes, found in %d runs\n",
+         (unsigned long)hi, trials);
+  printf("TLSF overhead:        %9lu bytes (%.1f%%), metadata and "
+         "fragmentation\n",
+         (unsigned long)(hi - peak), 100.0 * (hi - peak) / hi);
+  printf("\n#define HEAP_SIZE %lu   /* smallest pool + %d%% */\n",
+         (unsigned long)recommended, margin);
+  return 0;
+}
@@ -0,0 +1,283 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK benchmark of a TLSF heap pool on huge pages.
+ *------------------------------------------------------------------------------
+ * Runs many spotter sessions from one snsrAllocTLSF() pool, as a server
+ * would, with the pool on 4 KiB pages, on transparent hugepages and on
+ * explicit hugepages, see huge-pool.c. The sessions are snsrDup() copies
+ * of one loaded model. The data.c audio is pushed one block at a time to
+ * each session in turn, so every block walks the working set of all of
+ * them.
+ *
+ * For each backing, reports the pool bytes on huge pages, the data TLB
+ * load misses counted with perf_event_open(), and the real-time factor:
+ * process CPU time divided by the audio duration of all sessions.
+ *
+ * The built-in spotter runs from code space, so only the session state is
+ * in the pool. Use -t to load a task file, which places the model weights
+ * in the pool too.
+ *
+ * Explicit hugepages must be reserved first, for example with
+ *   echo 128 > /proc/sys/vm/nr_hugepages
+ * otherwise that run falls back to transparent hugepages. Counting TLB
+ * misses needs /proc/sys/kernel/perf_event_paranoid at 2 or lower.
+ *
+ * Linux only.
+ *------------------------------------------------------------------------------
+ */
+
+#include <snsr.h>
+
+#include <linux/perf_event.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "huge-pool.h"
+
+/* See spot-hbg-enUS-1.4.0-m.c */
+extern SnsrCodeModel spot_hbg_enUS_1_3_0_m;
+
+/* See data.c */
+extern unsigned char audioData[];
+extern unsigned int  audioDataLen;
+
+#define DEFAULT_SESSIONS   64
+#define DEFAULT_POOL_MB   256
+#define DEFAULT_PASSES      3
+
+#define BLOCK_MS       15
+#define SAMPLE_RATE 16000
+#define BLOCK_BYTES (BLOCK_MS * SAMPLE_RATE / 1000 * sizeof(short))
+
+/* Utility, returns the lesser of a and b */
+#define MIN(a, b) ((a) < (b)? (a): (b))
+
+typedef struct {
+  HugePoolBacking backing;     /* backing obtained                      */
+  size_t hugeBytes;            /* pool bytes on huge pages              */
+  int counted;                 /* 1 if tlbMisses is valid               */
+  uint64_t tlbMisses;          /* data TLB load misses                  */
+  double cpuSeconds;
+  double rtf;                  /* cpuSeconds / audio seconds            */
+} Result;
+
+
+static void
+fatal(int rc, const char *format, ...)
+{
+  va_list a;
+  fprintf(stderr, "ERROR: ");
+  va_start(a, format);
+  vfprintf(stderr, format, a);
+  va_end(a);
+  fprintf(stderr, "\n");
+  exit(rc);
+}
+
+
+static void
+usage(const char *name)
+{
+  fprintf(stderr,
+          "usage: %s [options]\n"
+          " options:\n"
+          "  -m MiB      : pool size (default: %i)\n"
+          "  -n count    : number of sessions (default: %i)\n"
+          "  -p passes   : times the audio is pushed (default: %i)\n"
+          "  -t task     : task filename (default: built-in spotter)\n",
+          name, DEFAULT_POOL_MB, DEFAULT_SESSIONS, DEFAULT_PASSES);
+  exit(199);
+}
+
+
+/* Process CPU time in seconds */
+static double
+cpuSeconds(void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+
+/* Open a disabled counter of user-space data TLB load misses for this
+ * thread. Returns -1 if perf events are not available.
+ */
+static int
+openTlbCounter(void)
+{
+  struct perf_event_attr a;
+
+  memset(&a, 0, sizeof(a));
+  a.size = sizeof(a);
+  a.type = PERF_TYPE_HW_CACHE;
+  a.config = PERF_COUNT_HW_CACHE_DTLB
+    | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+    | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  a.disabled = 1;
+  a.exclude_kernel = 1;
+  a.exclude_hv = 1;
+  return (int)syscall(SYS_perf_event_open, &a, 0, -1, -1, 0);
+}
+
+
+/* Push the audio to each of the n sessions in s, one block at a time. */
+static void
+pushAll(SnsrSession *s, int n, int passes)
+{
+  size_t i;
+  SnsrRC r;
+  int k, p;
+
+  for (p = 0; p < passes; p++) {
+    for (i = 0; i < audioDataLen; i += BLOCK_BYTES) {
+      for (k = 0; k < n; k++) {
+        r = snsrPush(s[k], SNSR_SOURCE_AUDIO_PCM, audioData + i,
+                     MIN(BLOCK_BYTES, audioDataLen - i));
+        if (r == SNSR_RC_STOP) snsrClearRC(s[k]);
+        else if (r != SNSR_RC_OK)
+          fatal(r, "session %i: %s", k, snsrErrorDetail(s[k]));
+      }
+    }
+  }
+}
+
+
+/* Run n sessions of task, or of the built-in model if task is NULL, from
+ * a pool of poolSize bytes on backing.
+ */
+static void
+bench(HugePoolBacking backing, const char *task, size_t poolSize,
+      int n, int passes, Result *result)
+{
+  SnsrSession *s = calloc(n, sizeof(*s));
+  void *pool;
+  uint64_t misses;
+  double start;
+  SnsrRC r;
+  int k, fd;
+
+  if (!s) fatal(SNSR_RC_NO_MEMORY, "out of memory");
+  memset(result, 0, sizeof(*result));
+  pool = hugePool(&poolSize, &backing);
+  if (!pool) fatal(SNSR_RC_NO_MEMORY, "could not map a %lu byte pool",
+                   (unsigned long)poolSize);
+  result->backing = backing;
+  result->hugeBytes = hugePoolHugeBytes(pool, poolSize);
+
+  r = snsrConfig(SNSR_CONFIG_ALLOC, snsrAllocTLSF(pool, poolSize));
+  if (r != SNSR_RC_OK)
+    fatal(r, "Custom allocation failure: %s", snsrRCMessage(r));
+  r = snsrNew(s);
+  if (r != SNSR_RC_OK)
+    fatal(r, "%s", s[0]? snsrErrorDetail(s[0]): snsrRCMessage(r));
+  snsrLoad(s[0], task? snsrStreamFromFileName(task, "r"):
+           snsrStreamFromCode(spot_hbg_enUS_1_3_0_m));
+  if (snsrRC(s[0]) != SNSR_RC_OK)
+    fatal(snsrRC(s[0]), "%s", snsrErrorDetail(s[0]));
+  for (k = 1; k < n; k++) {
+    r = snsrDup(s[0], s + k);
+    if (r != SNSR_RC_OK)
+      fatal(r, "session %i: %s (try a larger pool with -m)", k,
+            snsrRCMessage(r));
+  }
+  /* Warm up the caches, and the kernel's page tables */
+  pushAll(s, n, 1);
+
+  fd = openTlbCounter();
+  if (fd >= 0) {
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+  start = cpuSeconds();
+  pushAll(s, n, passes);
+  result->cpuSeconds = cpuSeconds() - start;
+  if (fd >= 0) {
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    result->counted = read(fd, &misses, sizeof(misses)) == sizeof(misses);
+    result->tlbMisses = misses;
+    close(fd);
+  }
+  result->rtf = result->cpuSeconds
+    / ((double)n * passes * audioDataLen / (SAMPLE_RATE * sizeof(short)));
+
+  for (k = 0; k < n; k++) snsrRelease(s[k]);
+  snsrTearDown();
+  hugePoolRelease(pool, poolSize);
+  free(s);
+}
+
+
+int
+main(int argc, char *argv[])
+{
+  Result result[HUGE_POOL_BACKINGS], *base = result + HUGE_POOL_SMALL, *x;
+  const char *task = NULL;
+  int b, o, n = DEFAULT_SESSIONS, poolMB = DEFAULT_POOL_MB;
+  int passes = DEFAULT_PASSES;
+  extern char *optarg;
+  extern int optind;
+
+  while ((o = getopt(argc, argv, "m:n:p:t:?")) >= 0) {
+    switch (o) {
+    case 'm': poolMB = atoi(optarg); break;
+    case 'n': n = atoi(optarg); break;
+    case 'p': passes = atoi(optarg); break;
+    case 't': task = optarg; break;
+    default:  usage(argv[0]);
+    }
+  }
+  if (optind != argc || poolMB <= 0 || n <= 0 || passes <= 0)
+    usage(argv[0]);
+
+  printf("%i sessions, %i passes of %.2f s of audio, %i MiB pool:\n"
+         "  %-36s %8s %14s %9s\n", n, passes,
+         (double)audioDataLen / (SAMPLE_RATE * sizeof(short)), poolMB,
+         "backing", "huge MiB", "dTLB misses", "RTF");
+  for (b = 0; b < HUGE_POOL_BACKINGS; b++) {
+    char name[64], misses[32];
+
+    x = result + b;
+    bench((HugePoolBacking)b, task, (size_t)poolMB << 20, n, passes, x);
+    if (x->backing == (HugePoolBacking)b)
+      snprintf(name, sizeof(name), "%s", hugePoolBackingName(x->backing));
+    else
+      snprintf(name, sizeof(name), "%s -> %s",
+               hugePoolBackingName((HugePoolBacking)b),
+               hugePoolBackingName(x->backing));
+    if (x->counted)
+      snprintf(misses, sizeof(misses), "%llu",
+               (unsigned long long)x->tlbMisses);
+    else
+      snprintf(misses, sizeof(misses), "n/a");
+    printf("  %-36s %8.1f %14s %9.5f\n", name,
+           x->hugeBytes / (1024.0 * 1024.0), misses, x->rtf);
+  }
+
+  for (b = HUGE_POOL_SMALL + 1; b < HUGE_POOL_BACKINGS; b++) {
+    x = result + b;
+    if (x->backing != (HugePoolBacking)b) continue;
+    printf("%s vs %s:", hugePoolBackingName(x->backing),
+           hugePoolBackingName(HUGE_POOL_SMALL));
+    if (x->counted && base->counted && base->tlbMisses)
+      printf(" %+.1f%% dTLB misses,",
+             100.0 * ((double)x->tlbMisses - base->tlbMisses)
+             / base->tlbMisses);
+    printf(" %+.1f%% RTF\n", 100.0 * (x->rtf - base->rtf) / base->rtf);
+  }
+  if (!base->counted)
+    fprintf(stderr, "TLB misses not counted, perf events are not available."
+            " See /proc/sys/kernel/perf_event_paranoid.\n");
+  if (result[HUGE_POOL_EXPLICIT].backing != HUGE_POOL_EXPLICIT)
+    fprintf(stderr, "No explicit hugepages free, reserve them with "
+            "/proc/sys/vm/nr_hugepages.\n");
+  return 0;
+}
@@ -0,0 +1,163 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK example of a heap pool on huge pages.
+ *------------------------------------------------------------------------------
+ * spot-data.c passes snsrAllocTLSF() a static array, which the kernel maps
+ * with 4 KiB pages. A server that runs hundreds of sessions from one large
+ * pool touches far more pages than the data TLB can hold, and the
+ * acoustic model loops pay for the page walks. Backing the pool with
+ * 2 MiB pages covers the same memory with 512 times fewer TLB entries.
+ *
+ * hugePool() maps the pool with one of:
+ *
+ * - explicit hugepages, mmap(MAP_HUGETLB). These come from the pool the
+ *   administrator reserves, for example with
+ *     echo 64 > /proc/sys/vm/nr_hugepages
+ *   and are guaranteed to be huge, but fail if too few are free.
+ * - transparent hugepages, madvise(MADV_HUGEPAGE) on a 2 MiB-aligned
+ *   mapping. Needs no reservation, but the kernel only uses huge pages
+ *   if /sys/kernel/mm/transparent_hugepage/enabled is "always" or
+ *   "madvise" and it finds free 2 MiB blocks.
+ * - small pages, with madvise(MADV_NOHUGEPAGE) so that the kernel does
+ *   not promote them, for comparison.
+ *
+ * Use it as:
+ *
+ *   size_t size = 256 << 20;
+ *   HugePoolBacking backing = HUGE_POOL_EXPLICIT;
+ *   void *pool = hugePool(&size, &backing);
+ *   snsrConfig(SNSR_CONFIG_ALLOC, snsrAllocTLSF(pool, size));
+ *
+ * See huge-bench.c for a benchmark of the three. Linux only.
+ *------------------------------------------------------------------------------
+ */
+
+#include <snsr.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/mman.h>
+
+#include "huge-pool.h"
+
+/* Pages are touched at this stride, the smallest page size */
+#define SMALL_PAGE_SIZE 4096
+
+
+/* Write to every page of the pool, so that the kernel allocates them now. */
+static void
+touch(char *pool, size_t size)
+{
+  size_t i;
+
+  for (i = 0; i < size; i += SMALL_PAGE_SIZE) pool[i] = 0;
+}
+
+
+static void *
+mapExplicit(size_t size)
+{
+#ifdef MAP_HUGETLB
+  void *p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE,
+                 -1, 0);
+  return p == MAP_FAILED? NULL: p;
+#else
+  return NULL;
+#endif
+}
+
+
+/* Map size bytes at a HUGE_PAGE_SIZE-aligned address, as the kernel can
+ * only back aligned 2 MiB ranges with transparent hugepages.
+ */
+static void *
+mapAligned(size_t size)
+{
+  char *p, *start;
+  size_t head;
+
+  p = mmap(NULL, size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED) return NULL;
+  start = (char *)(((uintptr_t)p + HUGE_PAGE_SIZE - 1)
+                   & ~(uintptr_t)(HUGE_PAGE_SIZE - 1));
+  head = (size_t)(start - p);
+  if (head) munmap(p, head);
+  munmap(start + size, HUGE_PAGE_SIZE - head);
+  return start;
+}
+
+
+void *
+hugePool(size_t *size, HugePoolBacking *backing)
+{
+  size_t n = (*size + HUGE_PAGE_SIZE - 1) & ~(size_t)(HUGE_PAGE_SIZE - 1);
+  char *pool = NULL;
+
+  if (!n) n = HUGE_PAGE_SIZE;
+  if (*backing == HUGE_POOL_EXPLICIT) {
+    pool = mapExplicit(n);
+    if (!pool) *backing = HUGE_POOL_TRANSPARENT;
+  }
+  if (!pool) {
+    if (!(pool = mapAligned(n))) return NULL;
+#ifdef MADV_HUGEPAGE
+    if (*backing == HUGE_POOL_TRANSPARENT
+        && madvise(pool, n, MADV_HUGEPAGE))
+      *backing = HUGE_POOL_SMALL;
+#else
+    *backing = HUGE_POOL_SMALL;
+#endif
+#ifdef MADV_NOHUGEPAGE
+    /* Keep THP "always" from promoting the baseline */
+    if (*backing == HUGE_POOL_SMALL) madvise(pool, n, MADV_NOHUGEPAGE);
+#endif
+    touch(pool, n);
+  }
+  *size = n;
+  return pool;
+}
+
+
+size_t
+hugePoolHugeBytes(void *pool, size_t size)
+{
+  unsigned long start, end, kb, from = (uintptr_t)pool, to = from + size;
+  size_t huge = 0;
+  char line[256];
+  int inPool = 0;
+  FILE *f = fopen("/proc/self/smaps", "r");
+
+  if (!f) return 0;
+  while (fgets(line, sizeof(line), f)) {
+    if (sscanf(line, "%lx-%lx ", &start, &end) == 2)
+      inPool = start < to && end > from;
+    else if (inPool
+             && (sscanf(line, "AnonHugePages: %lu kB", &kb) == 1
+                 || sscanf(line, "Private_Hugetlb: %lu kB", &kb) == 1
+                 || sscanf(line, "Shared_Hugetlb: %lu kB", &kb) == 1))
+      huge += (size_t)kb * 1024;
+  }
+  fclose(f);
+  /* A mapping merged with its neighbours may extend past the pool */
+  return huge < size? huge: size;
+}
+
+
+void
+hugePoolRelease(void *pool, size_t size)
+{
+  if (pool) munmap(pool, size);
+}
+
+
+const char *
+hugePoolBackingName(HugePoolBacking backing)
+{
+  static const char *name[HUGE_POOL_BACKINGS] = {
+    "4 KiB pages", "transparent 2 MiB", "explicit 2 MiB"
+  };
+  return backing < HUGE_POOL_BACKINGS? name[backing]: "unknown";
+}
@@ -0,0 +1,44 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK hugepage heap pool header. See huge-pool.c.
+ *------------------------------------------------------------------------------
+ */
+
+/* Size of a huge page on x86_64 and most aarch64 kernels */
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+typedef enum {
+  HUGE_POOL_SMALL,             /* 4 KiB pages, hugepages disabled       */
+  HUGE_POOL_TRANSPARENT,       /* madvise(MADV_HUGEPAGE), THP           */
+  HUGE_POOL_EXPLICIT,          /* mmap(MAP_HUGETLB), reserved hugepages */
+  HUGE_POOL_BACKINGS
+} HugePoolBacking;
+
+/* Map a heap pool of at least *size bytes for snsrAllocTLSF(), backed by
+ * pages of type backing. If those are not available, falls back from
+ * explicit to transparent hugepages, and from those to small pages.
+ * The pages are touched before returning, so the run does not pay for
+ * the page faults.
+ *
+ * On return *size is the mapped size, a multiple of HUGE_PAGE_SIZE, and
+ * *backing the type obtained. Returns NULL if no memory could be mapped.
+ */
+void *
+hugePool(size_t *size, HugePoolBacking *backing);
+
+/* Bytes of the size byte pool that the kernel has placed on huge pages.
+ * The explicit backing is always all huge pages, transparent hugepages
+ * depend on /sys/kernel/mm/transparent_hugepage/enabled and on
+ * fragmentation.
+ */
+size_t
+hugePoolHugeBytes(void *pool, size_t size);
+
+/* Unmap a pool returned by hugePool(), after snsrTearDown(). */
+void
+hugePoolRelease(void *pool, size_t size);
+
+/* Human-readable name of backing. */
+const char *
+hugePoolBackingName(HugePoolBacking backing);
@@ -12,6 +12,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "sg-stream.h"
+
 #define DEFAULT_OUT  "enrolled-sv.snsr"
 #define ENROLL_TASK_VERSION "~0.8.0 || 1.0.0"
 
@@ -431,11 +433,11 @@ main(int argc, char *argv[])
     e.audio = snsrStreamFromAudioDevice(SNSR_ST_AF_DEFAULT);
   } else {
     SnsrStream tmp;
-    e.audio = snsrStreamFromString("");
+    e.audio = streamFromSegments();
     for (; i < argc; i++) {
       tmp = snsrStreamFromFileName(argv[i], "r");
       tmp = snsrStreamFromAudioStream(tmp, SNSR_ST_AF_DEFAULT);
-      e.audio = snsrStreamFromStreams(e.audio, tmp);
+      streamSegmentsAddStream(e.audio, tmp);
     }
   }
   snsrSetStream(s, SNSR_SOURCE_AUDIO_PCM, e.audio);
@@ -0,0 +1,130 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK example: several spotters sharing one microphone.
+ *------------------------------------------------------------------------------
+ * Each model runs in its own session on its own thread. All sessions read
+ * the same live audio through fan-out streams, see fanout-stream.c, so the
+ * audio device is opened and captured only once.
+ *------------------------------------------------------------------------------
+ */
+
+#include <snsr.h>
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "fanout-stream.h"
+
+/* Shared audio ring buffer size: 2 s of 16 kHz 16-bit mono audio */
+#define RING_SIZE (2 * 16000 * sizeof(short))
+
+typedef struct {
+  SnsrSession s;
+  const char *model;
+  SnsrRC rc;
+} Spotter;
+
+static pthread_mutex_t PrintLock = PTHREAD_MUTEX_INITIALIZER;
+
+
+static void
+fatal(int rc, const char *format, ...)
+{
+  va_list a;
+  va_start(a, format);
+  vfprintf(stderr, format, a);
+  va_end(a);
+  exit(rc);
+}
+
+
+static SnsrRC
+resultEvent(SnsrSession s, const char *key, void *privateData)
+{
+  Spotter *p = (Spotter *)privateData;
+  SnsrRC r;
+  const char *phrase;
+  double begin;
+
+  snsrGetDouble(s, SNSR_RES_BEGIN_MS, &begin);
+  r = snsrGetString(s, SNSR_RES_TEXT, &phrase);
+  if (r != SNSR_RC_OK) return r;
+  pthread_mutex_lock(&PrintLock);
+  printf("%s: spotted \"%s\" at %.2f seconds.\n",
+         p->model, phrase, begin/1000.0);
+  fflush(stdout);
+  pthread_mutex_unlock(&PrintLock);
+  return SNSR_RC_OK;
+}
+
+
+static void *
+spotterThread(void *arg)
+{
+  Spotter *p = (Spotter *)arg;
+
+  p->rc = snsrRun(p->s);
+  return NULL;
+}
+
+
+int
+main(int argc, char *argv[])
+{
+  FanOut f;
+  Spotter *spotter;
+  pthread_t *thread;
+  int i, n, failed = 0;
+
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s spotter-model [spotter-model ...]\n", argv[0]);
+    exit(1);
+  }
+  n = argc - 1;
+  spotter = calloc(n, sizeof(*spotter));
+  thread = calloc(n, sizeof(*thread));
+  if (!spotter || !thread) fatal(1, "Out of memory.\n");
+
+  f = fanOutNew(snsrStreamFromAudioDevice(SNSR_ST_AF_DEFAULT), RING_SIZE);
+  if (!f) fatal(1, "Could not create the fan-out stream.\n");
+
+  for (i = 0; i < n; i++) {
+    Spotter *p = spotter + i;
+    p->model = argv[i + 1];
+    snsrNew(&p->s);
+    snsrLoad(p->s, snsrStreamFromFileName(p->model, "r"));
+    snsrRequire(p->s, SNSR_TASK_TYPE, SNSR_PHRASESPOT);
+    snsrSetStream(p->s, SNSR_SOURCE_AUDIO_PCM, streamFromFanOut(f));
+    snsrSetHandler(p->s, SNSR_RESULT_EVENT,
+                   snsrCallback(resultEvent, NULL, p));
+    if (snsrRC(p->s) != SNSR_RC_OK)
+      fatal(1, "%s: %s\n", p->model, snsrErrorDetail(p->s));
+  }
+
+  for (i = 0; i < n; i++)
+    if (pthread_create(thread + i, NULL, spotterThread, spotter + i))
+      fatal(1, "Could not start the thread for %s.\n", spotter[i].model);
+
+  /* Sessions run until the audio stream fails, typically because
+   * one of them fell too far behind the others.
+   */
+  for (i = 0; i < n; i++) {
+    Spotter *p = spotter + i;
+    pthread_join(thread[i], NULL);
+    if (p->rc != SNSR_RC_OK && p->rc != SNSR_RC_STREAM_END) {
+      fprintf(stderr, "%s: %s\n", p->model, snsrErrorDetail(p->s));
+      failed = 1;
+    }
+  }
+  if (fanOutSlowReaders(f))
+    fprintf(stderr, "%lu of %d sessions could not keep up with the audio.\n",
+            (unsigned long)fanOutSlowReaders(f), n);
+  for (i = 0; i < n; i++) snsrRelease(spotter[i].s);
+  fanOutRelease(f);
+  free(thread);
+  free(spotter);
+  return failed;
+}
@@ -9,6 +9,9 @@
 
 #include <stdlib.h>
 
+/* Default fraction of each capture period reserved for recognition */
+#define DEFAULT_LOAD_MARGIN 0.5
+
 /* See alsa-stream.c for implementation details */
 #include "alsa-stream.h"
 
@@ -41,25 +44,58 @@ main(int argc, char *argv[])
 {
   SnsrRC r;
   SnsrSession s;
-
-  if (argc != 2) {
-    fprintf(stderr, "usage: %s spotter-model\n", argv[0]);
+  double margin = DEFAULT_LOAD_MARGIN;
+  int o, calibrate = 0;
+  extern char *optarg;
+  extern int optind;
+
+  while ((o = getopt(argc, argv, "c:?")) >= 0) {
+    switch (o) {
+    case 'c':
+      calibrate = 1;
+      margin = atof(optarg);
+      break;
+    default:
+      optind = argc;
+    }
+  }
+  if (argc - optind != 1) {
+    fprintf(stderr, "usage: %s [-c load-margin] spotter-model\n"
+            "  -c load-margin : calibrate the capture period size, keeping\n"
+            "                   this fraction (e.g. %.1f) of each period free\n"
+            "                   for recognition. Saved to \"%s\".\n",
+            argv[0], DEFAULT_LOAD_MARGIN, STREAM_CALIBRATION_FILE);
     exit(1);
   }
 
+  /* Find and save the smallest safe capture period for this device.
+   * STREAM_LATENCY_CALIBRATED below uses this saved value.
+   */
+  if (calibrate) {
+    long period = streamCalibrateALSA("default", 16000, margin,
+                                      STREAM_CALIBRATION_FILE, 1);
+    if (period < 0) {
+      fprintf(stderr, "ERROR: capture period calibration failed.\n");
+      exit(1);
+    }
+    printf("Calibrated capture period: %ld samples (%.0f ms).\n",
+           period, period / 16.0);
+  }
+
   /* Create a new session handle. */
   snsrNew(&s);
 
   /* Load and validate the spotter model task file. */
-  snsrLoad(s, snsrStreamFromFileName(argv[1], "r"));
+  snsrLoad(s, snsrStreamFromFileName(argv[optind], "r"));
   snsrRequire(s, SNSR_TASK_TYPE, SNSR_PHRASESPOT);
 
   /* Create a live audio stream instance using a custom stream type,
-   * then attach it to the session.
+   * then attach it to the session. This uses the calibrated period and
+   * buffer sizes for this device if available, low latency otherwise.
    */
   snsrSetStream(s, SNSR_SOURCE_AUDIO_PCM,
-                streamFromALSA("default",
-                               16000, SNSR_ST_MODE_READ, STREAM_LATENCY_LOW));
+                streamFromALSA("default", 16000, SNSR_ST_MODE_READ,
+                               STREAM_LATENCY_CALIBRATED));
 
   /* Register a result callback. Private data handle is not used */
   snsrSetHandler(s, SNSR_RESULT_EVENT, snsrCallback(resultEvent, NULL, NULL));
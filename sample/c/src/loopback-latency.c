@@ -0,0 +1,304 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK closed-loop spotter latency test, using the ALSA
+ * stream provider for both playback and capture. See alsa-stream.c.
+ *------------------------------------------------------------------------------
+ * Plays a wave file to an ALSA playback device, captures it back from a
+ * loopback capture device, and runs a phrase spotter on the captured audio.
+ * For every spotted phrase this reports the time from when the end of the
+ * phrase was played to when the result event fired, and at the end the
+ * process and recognizer CPU use.
+ *
+ * No sound card is needed: the snd-aloop kernel module provides a virtual
+ * loopback card. Audio played to hw:Loopback,0,0 is captured from
+ * hw:Loopback,1,0, the defaults used here.
+ *
+ *   sudo modprobe snd-aloop
+ *   loopback-latency -t model.snsr audio.wav
+ *------------------------------------------------------------------------------
+ */
+
+#include <snsr.h>
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include "alsa-stream.h"
+
+#define SAMPLE_RATE    16000
+/* Playback block size, 15 ms */
+#define BLOCK_SAMPLES    240
+/* Silence played before and after the wave file */
+#define LEAD_MS          500
+#define TAIL_MS         2000
+/* Largest number of spotted phrases tracked */
+#define MAX_RESULTS      256
+
+#define DEFAULT_PLAYBACK "hw:Loopback,0,0"
+#define DEFAULT_CAPTURE  "hw:Loopback,1,0"
+
+
+typedef struct {
+  const char *device;     /* ALSA playback device name                */
+  short *audio;           /* audio to play, including lead and tail   */
+  size_t samples;         /* number of samples in audio               */
+  _Atomic(double) start;  /* monotonic time of the first write, in ms,
+                           * read by the capture thread               */
+  SnsrRC rc;              /* playback result                          */
+} Player;
+
+
+typedef struct {
+  Player *player;
+  double end[MAX_RESULTS];      /* phrase end sample in the played audio */
+  double latency[MAX_RESULTS];  /* result latency in ms, live runs only  */
+  size_t count;                 /* number of results                     */
+  size_t expected;              /* reference results, live runs only     */
+  size_t extra;                 /* live results past expected            */
+  int live;                     /* 0 for the reference run               */
+} Results;
+
+
+static void
+fatal(int rc, const char *format, ...)
+{
+  va_list a;
+  fprintf(stderr, "ERROR: ");
+  va_start(a, format);
+  vfprintf(stderr, format, a);
+  va_end(a);
+  fprintf(stderr, "\n");
+  exit(rc);
+}
+
+
+static void
+usage(const char *name)
+{
+  fprintf(stderr,
+          "usage: %s -t task [options] wavefile\n"
+          " options:\n"
+          "  -c device : ALSA capture device (default: " DEFAULT_CAPTURE ")\n"
+          "  -p device : ALSA playback device (default: " DEFAULT_PLAYBACK ")\n"
+          "  -t task   : phrase spotter task filename (required)\n", name);
+  exit(199);
+}
+
+
+static double
+nowMs(void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+}
+
+
+static double
+cpuMs(void)
+{
+  struct rusage u;
+  getrusage(RUSAGE_SELF, &u);
+  return (u.ru_utime.tv_sec + u.ru_stime.tv_sec) * 1e3
+    + (u.ru_utime.tv_usec + u.ru_stime.tv_usec) / 1e3;
+}
+
+
+static SnsrRC
+resultEvent(SnsrSession s, const char *key, void *privateData)
+{
+  Results *r = (Results *)privateData;
+  const char *phrase;
+  double end, now = nowMs();
+  SnsrRC rc;
+
+  snsrGetDouble(s, SNSR_RES_END_SAMPLE, &end);
+  rc = snsrGetString(s, SNSR_RES_TEXT, &phrase);
+  if (rc != SNSR_RC_OK || r->count >= MAX_RESULTS) return rc;
+  if (!r->live) {
+    r->end[r->count++] = end;
+    return SNSR_RC_OK;
+  }
+  /* The k-th live result is matched with the k-th reference result,
+   * which gives the phrase end time in the played audio.
+   */
+  if (r->count >= r->expected) {
+    printf("Spotted \"%s\", not found in the reference run.\n", phrase);
+    fflush(stdout);
+    r->extra++;
+    return SNSR_RC_OK;
+  }
+  r->latency[r->count] = now - (atomic_load(&r->player->start)
+                                + r->end[r->count] * 1000 / SAMPLE_RATE);
+  printf("Spotted \"%s\", latency %.1f ms.\n", phrase, r->latency[r->count]);
+  fflush(stdout);
+  r->count++;
+  return SNSR_RC_OK;
+}
+
+
+static void *
+playAudio(void *arg)
+{
+  Player *p = (Player *)arg;
+  SnsrStream out;
+  size_t i, n;
+
+  out = streamFromALSA(p->device, SAMPLE_RATE,
+                       SNSR_ST_MODE_WRITE, STREAM_LATENCY_LOW);
+  snsrRetain(out);
+  snsrStreamOpen(out);
+  atomic_store(&p->start, nowMs());
+  for (i = 0; i < p->samples && snsrStreamRC(out) == SNSR_RC_OK; i += n) {
+    n = p->samples - i < BLOCK_SAMPLES? p->samples - i: BLOCK_SAMPLES;
+    snsrStreamWrite(out, p->audio + i, sizeof(short), n);
+  }
+  snsrStreamClose(out);
+  p->rc = snsrStreamRC(out);
+  if (p->rc != SNSR_RC_OK)
+    fprintf(stderr, "ERROR: playback: %s\n", snsrStreamErrorDetail(out));
+  snsrRelease(out);
+  return NULL;
+}
+
+
+/* Read a wave file, and pad it with LEAD_MS and TAIL_MS of silence. */
+static short *
+loadAudio(const char *filename, size_t *samples)
+{
+  SnsrStream a;
+  short *audio = NULL, *tmp;
+  size_t lead = LEAD_MS * SAMPLE_RATE / 1000;
+  size_t tail = TAIL_MS * SAMPLE_RATE / 1000;
+  size_t size = lead + SAMPLE_RATE, count = lead;
+
+  a = snsrStreamFromAudioFile(filename, "r", SNSR_ST_AF_DEFAULT);
+  snsrRetain(a);
+  snsrStreamOpen(a);
+  while (snsrStreamRC(a) == SNSR_RC_OK) {
+    if (!audio || count + BLOCK_SAMPLES > size) {
+      if (audio) size *= 2;
+      if (!(tmp = realloc(audio, (size + tail) * sizeof(*audio)))) {
+        free(audio);
+        fatal(SNSR_RC_NO_MEMORY, "out of memory");
+      }
+      audio = tmp;
+    }
+    count += snsrStreamRead(a, audio + count, sizeof(*audio), BLOCK_SAMPLES);
+  }
+  if (snsrStreamRC(a) != SNSR_RC_EOF)
+    fatal(snsrStreamRC(a), "%s", snsrStreamErrorDetail(a));
+  snsrRelease(a);
+  memset(audio, 0, lead * sizeof(*audio));
+  memset(audio + count, 0, tail * sizeof(*audio));
+  *samples = count + tail;
+  return audio;
+}
+
+
+int
+main(int argc, char *argv[])
+{
+  SnsrSession s, ref;
+  SnsrStream capture;
+  Player player;
+  Results results;
+  pthread_t thread;
+  const char *captureDevice = DEFAULT_CAPTURE, *task = NULL;
+  double cpuStart, wallStart, cpu, wall, recCpu = 0, samples = 0, sum, max;
+  size_t i, expected;
+  int o;
+  SnsrRC r;
+  extern char *optarg;
+  extern int optind;
+
+  memset(&player, 0, sizeof(player));
+  memset(&results, 0, sizeof(results));
+  player.device = DEFAULT_PLAYBACK;
+  results.player = &player;
+
+  while ((o = getopt(argc, argv, "c:p:t:?")) >= 0) {
+    switch (o) {
+    case 'c': captureDevice = optarg; break;
+    case 'p': player.device = optarg; break;
+    case 't': task = optarg; break;
+    default:  usage(argv[0]);
+    }
+  }
+  if (!task || optind != argc - 1) usage(argv[0]);
+
+  r = snsrNew(&s);
+  if (r != SNSR_RC_OK) fatal(r, "%s", s? snsrErrorDetail(s): snsrRCMessage(r));
+  snsrLoad(s, snsrStreamFromFileName(task, "r"));
+  snsrRequire(s, SNSR_TASK_TYPE, SNSR_PHRASESPOT);
+  snsrSetHandler(s, SNSR_RESULT_EVENT,
+                 snsrCallback(resultEvent, NULL, &results));
+  if (snsrRC(s) != SNSR_RC_OK) fatal(snsrRC(s), "%s", snsrErrorDetail(s));
+  player.audio = loadAudio(argv[optind], &player.samples);
+
+  /* Reference run on the audio as played, to find where each phrase ends. */
+  snsrDup(s, &ref);
+  snsrSetStream(ref, SNSR_SOURCE_AUDIO_PCM,
+                snsrStreamFromMemory(player.audio,
+                                     player.samples * sizeof(short),
+                                     SNSR_ST_MODE_READ));
+  r = snsrRun(ref);
+  if (r != SNSR_RC_STREAM_END) fatal(r, "%s", snsrErrorDetail(ref));
+  snsrRelease(ref);
+  expected = results.expected = results.count;
+  results.count = 0;
+  results.live = 1;
+
+  /* Live run: capture as much audio as is played. */
+  capture = streamFromALSA(captureDevice, SAMPLE_RATE,
+                           SNSR_ST_MODE_READ, STREAM_LATENCY_LOW);
+  snsrRetain(capture);
+  snsrStreamOpen(capture);
+  if (snsrStreamRC(capture) != SNSR_RC_OK)
+    fatal(snsrStreamRC(capture), "%s", snsrStreamErrorDetail(capture));
+  snsrSetStream(s, SNSR_SOURCE_AUDIO_PCM,
+                snsrStreamFromOpenStream(capture,
+                                         player.samples * sizeof(short)));
+  snsrRelease(capture);
+
+  wallStart = nowMs();
+  cpuStart = cpuMs();
+  if (pthread_create(&thread, NULL, playAudio, &player))
+    fatal(SNSR_RC_ERROR, "could not start the playback thread");
+  r = snsrRun(s);
+  pthread_join(thread, NULL);
+  cpu = cpuMs() - cpuStart;
+  wall = nowMs() - wallStart;
+  if (r != SNSR_RC_OK && r != SNSR_RC_STREAM_END)
+    fatal(r, "%s", snsrErrorDetail(s));
+  if (player.rc != SNSR_RC_OK) fatal(player.rc, "playback failed");
+
+  snsrGetDouble(s, SNSR_RES_CPU_SECONDS_USED, &recCpu);
+  snsrGetDouble(s, SNSR_RES_SAMPLES, &samples);
+  sum = max = 0;
+  for (i = 0; i < results.count; i++) {
+    sum += results.latency[i];
+    if (results.latency[i] > max) max = results.latency[i];
+  }
+  printf("Spotted %lu of %lu phrases found in the reference run.\n",
+         (unsigned long)results.count, (unsigned long)expected);
+  if (results.extra)
+    printf("Spotted %lu phrases not found in the reference run.\n",
+           (unsigned long)results.extra);
+  if (results.count)
+    printf("Latency: mean %.1f ms, max %.1f ms.\n", sum / results.count, max);
+  printf("Process CPU: %.2f%%, recognizer CPU: %.2f%% of real time.\n",
+         100 * cpu / wall,
+         samples > 0? 100 * recCpu / samples * SAMPLE_RATE: 0.0);
+
+  snsrRelease(s);
+  snsrTearDown();
+  free(player.audio);
+  return results.count == expected && !results.extra? 0: 1;
+}
@@ -0,0 +1,222 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK tool that measures the memory saved by sharing one
+ * copy of a model between processes.
+ *------------------------------------------------------------------------------
+ * snsrLoad(s, snsrStreamFromFileName(...)) parses the model into the
+ * process heap, so 32 worker processes hold 32 private copies of the
+ * weights. A model converted to C source with snsr-edit -c runs from
+ * read-only code space instead, see spot-hbg-enUS-1.4.0-m.c. Compiled into
+ * a shared library, that read-only image lives in the page cache once, and
+ * every process that loads the library maps the same physical pages.
+ *
+ * Placing the .snsr file image in a shared memfd or hugetlbfs mapping does
+ * not help, as snsrLoad() still copies the model from that mapping into
+ * each heap. Code space is the library's only load path that does not.
+ *
+ * This tool starts -n processes that each load the model one way, waits
+ * until all have loaded it, and reads their resident (Rss) and
+ * proportional (Pss) set sizes from /proc/pid/smaps_rollup. Pss divides
+ * each shared page among the processes that map it, so the Pss total is
+ * what the group of processes really costs.
+ *
+ * Build the shared library from the snsr-edit -c output with, for example:
+ *
+ *   snsr-edit -t model.snsr -c model -o model.c
+ *   cc -shared -fPIC -I include -o libmodel.so model.c
+ *
+ * The Makefile builds bin/libspot-hbg-model.so from
+ * spot-hbg-enUS-1.4.0-m.c, for use with:
+ *
+ *   model-share -t spot-hbg-enUS-1.4.0-m.snsr \
+ *     -c bin/libspot-hbg-model.so:spot_hbg_enUS_1_3_0_m
+ *
+ * Linux only.
+ *------------------------------------------------------------------------------
+ */
+
+#include <snsr.h>
+
+#include <dlfcn.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define DEFAULT_PROCESSES 8
+#define MAX_PROCESSES   256
+
+typedef struct {
+  unsigned long rss;           /* resident set size, in kB              */
+  unsigned long pss;           /* proportional set size, in kB          */
+} Usage;
+
+
+static void
+fatal(int rc, const char *format, ...)
+{
+  va_list a;
+  fprintf(stderr, "ERROR: ");
+  va_start(a, format);
+  vfprintf(stderr, format, a);
+  va_end(a);
+  fprintf(stderr, "\n");
+  exit(rc);
+}
+
+
+static void
+usage(const char *name)
+{
+  fprintf(stderr,
+          "usage: %s [options]\n"
+          " options:\n"
+          "  -c library:symbol : code-space model in a shared library\n"
+          "  -n count          : number of processes (default: %i)\n"
+          "  -t task           : task filename, loaded into each heap\n"
+          "\nAt least one of -c and -t is required. With both, the\n"
+          "two are compared.\n",
+          name, DEFAULT_PROCESSES);
+  exit(199);
+}
+
+
+/* Load the model as a child process would, and return the session.
+ * model is a task filename, or library:symbol if code is set.
+ */
+static SnsrSession
+loadModel(const char *model, int code)
+{
+  SnsrSession s;
+  SnsrRC r;
+
+  r = snsrNew(&s);
+  if (r != SNSR_RC_OK) fatal(r, "%s", s? snsrErrorDetail(s): snsrRCMessage(r));
+  if (code) {
+    char *library = strdup(model), *symbol = strrchr(library, ':');
+    SnsrCodeModel *m;
+    void *h;
+
+    if (!symbol) fatal(SNSR_RC_INVALID_ARG, "expected library:symbol");
+    *symbol++ = '\0';
+    if (!(h = dlopen(library, RTLD_NOW | RTLD_LOCAL)))
+      fatal(SNSR_RC_NOT_FOUND, "%s", dlerror());
+    if (!(m = (SnsrCodeModel *)dlsym(h, symbol)))
+      fatal(SNSR_RC_NOT_FOUND, "%s", dlerror());
+    snsrLoad(s, snsrStreamFromCode(*m));
+    free(library);
+  } else {
+    snsrLoad(s, snsrStreamFromFileName(model, "r"));
+  }
+  if (snsrRC(s) != SNSR_RC_OK) fatal(snsrRC(s), "%s", snsrErrorDetail(s));
+  return s;
+}
+
+
+/* Read the Rss and Pss totals of process pid. */
+static void
+readUsage(pid_t pid, Usage *u)
+{
+  char path[64], line[256];
+  unsigned long kb;
+  FILE *f;
+
+  snprintf(path, sizeof(path), "/proc/%ld/smaps_rollup", (long)pid);
+  if (!(f = fopen(path, "r")))
+    fatal(SNSR_RC_NOT_FOUND, "could not open \"%s\"", path);
+  while (fgets(line, sizeof(line), f)) {
+    if (sscanf(line, "Rss: %lu kB", &kb) == 1) u->rss += kb;
+    else if (sscanf(line, "Pss: %lu kB", &kb) == 1) u->pss += kb;
+  }
+  fclose(f);
+}
+
+
+/* Start n processes that load model and stay alive until released.
+ * Returns the sum of their memory use.
+ */
+static Usage
+measure(const char *model, int code, int n)
+{
+  pid_t pid[MAX_PROCESSES];
+  int ready[2], release[2];
+  Usage total = {0, 0};
+  char c;
+  int i;
+
+  if (pipe(ready) || pipe(release))
+    fatal(SNSR_RC_ERROR, "could not create pipes");
+  fflush(stdout);
+  for (i = 0; i < n; i++) {
+    if ((pid[i] = fork()) < 0) fatal(SNSR_RC_ERROR, "fork failed");
+    if (!pid[i]) {
+      close(ready[0]);
+      close(release[1]);
+      loadModel(model, code);
+      c = 1;
+      if (write(ready[1], &c, 1) != 1) _exit(1);
+      /* Returns at end-of-file, when the parent closes its end */
+      while (read(release[0], &c, 1) > 0)
+        ;
+      _exit(0);
+    }
+  }
+  close(ready[1]);
+  close(release[0]);
+  for (i = 0; i < n; i++)
+    if (read(ready[0], &c, 1) != 1)
+      fatal(SNSR_RC_ERROR, "a process failed to load the model");
+  for (i = 0; i < n; i++) readUsage(pid[i], &total);
+  close(release[1]);
+  close(ready[0]);
+  for (i = 0; i < n; i++) waitpid(pid[i], NULL, 0);
+  return total;
+}
+
+
+static void
+report(const char *name, Usage u, int n)
+{
+  printf("  %-15s %11lu %11lu %11lu\n", name, u.rss, u.pss, u.pss / n);
+}
+
+
+int
+main(int argc, char *argv[])
+{
+  const char *task = NULL, *library = NULL;
+  Usage file = {0, 0}, shared = {0, 0};
+  int o, n = DEFAULT_PROCESSES;
+  extern char *optarg;
+  extern int optind;
+
+  while ((o = getopt(argc, argv, "c:n:t:?")) >= 0) {
+    switch (o) {
+    case 'c': library = optarg; break;
+    case 'n': n = atoi(optarg); break;
+    case 't': task = optarg; break;
+    default:  usage(argv[0]);
+    }
+  }
+  if (optind != argc || (!task && !library)
+      || n <= 0 || n > MAX_PROCESSES) usage(argv[0]);
+
+  printf("Model loaded by %i processes, in kB:\n"
+         "  source            Rss total   Pss total Pss/process\n", n);
+  if (task) {
+    file = measure(task, 0, n);
+    report("task file", file, n);
+  }
+  if (library) {
+    shared = measure(library, 1, n);
+    report("shared library", shared, n);
+  }
+  if (task && library && file.pss > shared.pss)
+    printf("Sharing saves %lu kB (%.1f%%).\n", file.pss - shared.pss,
+           100.0 * (file.pss - shared.pss) / file.pss);
+  return 0;
+}
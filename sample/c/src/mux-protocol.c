@@ -0,0 +1,217 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK framed, multiplexed audio protocol, used by
+ * snsr-eval -m.
+ *------------------------------------------------------------------------------
+ * A parent process can send audio for many logical streams over a single
+ * pipe, rather than spawning a process and loading the model once per
+ * stream. Each stream gets its own snsrDup() copy of the configured
+ * session, which shares the model data. Audio is processed in push mode
+ * as it arrives, see push-audio.c.
+ *------------------------------------------------------------------------------
+ */
+
+#include <snsr.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#  include <fcntl.h>
+#  include <io.h>
+#endif
+
+#include "mux-protocol.h"
+
+/* Initial stream table size, doubles as needed */
+#define INITIAL_STREAMS 16
+
+typedef struct {
+  FILE *out;
+  SnsrSession s;
+  unsigned long id;
+} MuxStream;
+
+typedef struct {
+  MuxStream **stream;
+  size_t count;
+  size_t alloc;
+} MuxTable;
+
+
+static void
+putLE32(unsigned char *p, unsigned long v)
+{
+  p[0] = (unsigned char)v;
+  p[1] = (unsigned char)(v >> 8);
+  p[2] = (unsigned char)(v >> 16);
+  p[3] = (unsigned char)(v >> 24);
+}
+
+
+static unsigned long
+getLE32(const unsigned char *p)
+{
+  return p[0] | (unsigned long)p[1] << 8
+    | (unsigned long)p[2] << 16 | (unsigned long)p[3] << 24;
+}
+
+
+static void
+writeRecord(FILE *out, int type, unsigned long id,
+            const void *payload, size_t size)
+{
+  unsigned char h[MUX_HEADER_SIZE];
+
+  h[0] = (unsigned char)type;
+  putLE32(h + 1, id);
+  putLE32(h + 5, (unsigned long)size);
+  fwrite(h, 1, sizeof(h), out);
+  if (size) fwrite(payload, 1, size, out);
+  fflush(out);
+}
+
+
+static SnsrRC
+muxResultEvent(SnsrSession s, const char *key, void *privateData)
+{
+  MuxStream *m = (MuxStream *)privateData;
+  const char *phrase;
+  double begin, end;
+  char *text;
+  int n;
+  SnsrRC r;
+
+  snsrGetDouble(s, SNSR_RES_BEGIN_MS, &begin);
+  snsrGetDouble(s, SNSR_RES_END_MS, &end);
+  r = snsrGetString(s, SNSR_RES_TEXT, &phrase);
+  if (r != SNSR_RC_OK) return r;
+  if (!phrase[0]) return SNSR_RC_OK;
+  n = snprintf(NULL, 0, "%.0f %.0f %s", begin, end, phrase);
+  text = malloc(n + 1);
+  if (!text) return SNSR_RC_NO_MEMORY;
+  snprintf(text, n + 1, "%.0f %.0f %s", begin, end, phrase);
+  writeRecord(m->out, MUX_RESULT, m->id, text, n);
+  free(text);
+  return SNSR_RC_OK;
+}
+
+
+static MuxStream *
+findStream(MuxTable *t, unsigned long id, size_t *index)
+{
+  size_t i;
+
+  for (i = 0; i < t->count; i++) {
+    if (t->stream[i]->id == id) {
+      if (index) *index = i;
+      return t->stream[i];
+    }
+  }
+  return NULL;
+}
+
+
+static MuxStream *
+newStream(MuxTable *t, SnsrSession model, FILE *out, unsigned long id)
+{
+  MuxStream *m;
+  SnsrRC r;
+
+  if (t->count == t->alloc) {
+    size_t alloc = t->alloc? 2 * t->alloc: INITIAL_STREAMS;
+    MuxStream **s = realloc(t->stream, alloc * sizeof(*s));
+    if (!s) return NULL;
+    t->stream = s;
+    t->alloc = alloc;
+  }
+  m = calloc(1, sizeof(*m));
+  if (!m) return NULL;
+  m->out = out;
+  m->id = id;
+  r = snsrDup(model, &m->s);
+  if (r == SNSR_RC_OK) {
+    r = snsrSetHandler(m->s, SNSR_RESULT_EVENT,
+                       snsrCallback(muxResultEvent, NULL, m));
+    if (r == SNSR_RC_SETTING_NOT_FOUND) snsrClearRC(m->s);
+  }
+  t->stream[t->count++] = m;
+  return m;
+}
+
+
+/* Flush stream index, report its status, and remove it from the table.
+ */
+static void
+endStream(MuxTable *t, size_t index)
+{
+  MuxStream *m = t->stream[index];
+  SnsrRC r;
+
+  r = m->s? snsrRC(m->s): SNSR_RC_NO_MEMORY;
+  if (r == SNSR_RC_OK) r = snsrStop(m->s);
+  if (r == SNSR_RC_OK || r == SNSR_RC_STOP || r == SNSR_RC_STREAM_END) {
+    writeRecord(m->out, MUX_DONE, m->id, NULL, 0);
+  } else {
+    const char *msg = m->s? snsrErrorDetail(m->s): snsrRCMessage(r);
+    writeRecord(m->out, MUX_DONE, m->id, msg, strlen(msg));
+  }
+  snsrRelease(m->s);
+  free(m);
+  t->stream[index] = t->stream[--t->count];
+}
+
+
+SnsrRC
+serveMultiplexed(SnsrSession model, FILE *in, FILE *out)
+{
+  MuxTable table = {NULL, 0, 0};
+  MuxStream *m;
+  unsigned char h[MUX_HEADER_SIZE];
+  unsigned char *payload;
+  unsigned long id, size;
+  size_t index;
+  SnsrRC r = SNSR_RC_OK;
+
+#ifdef _WIN32
+  _setmode(_fileno(in), _O_BINARY);
+  _setmode(_fileno(out), _O_BINARY);
+#endif
+  payload = malloc(MUX_MAX_PAYLOAD);
+  if (!payload) return SNSR_RC_NO_MEMORY;
+
+  while (fread(h, 1, sizeof(h), in) == sizeof(h)) {
+    id = getLE32(h + 1);
+    size = getLE32(h + 5);
+    if (size > MUX_MAX_PAYLOAD || fread(payload, 1, size, in) != size) {
+      r = SNSR_RC_FORMAT_NOT_SUPPORTED;
+      break;
+    }
+    m = findStream(&table, id, &index);
+    if (h[0] == MUX_AUDIO) {
+      if (!m) m = newStream(&table, model, out, id);
+      if (!m) {
+        r = SNSR_RC_NO_MEMORY;
+        break;
+      }
+      /* Once a stream fails or stops, its remaining audio is ignored
+       * and the error is reported in its 'D' record.
+       */
+      if (m->s && snsrRC(m->s) == SNSR_RC_OK)
+        snsrPush(m->s, SNSR_SOURCE_AUDIO_PCM, payload, size);
+    } else if (h[0] == MUX_END) {
+      if (m) endStream(&table, index);
+      else writeRecord(out, MUX_DONE, id, NULL, 0);
+    } else {
+      r = SNSR_RC_FORMAT_NOT_SUPPORTED;
+      break;
+    }
+  }
+
+  while (table.count) endStream(&table, table.count - 1);
+  free(table.stream);
+  free(payload);
+  return r;
+}
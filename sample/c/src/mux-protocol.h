@@ -0,0 +1,35 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK framed, multiplexed audio protocol. See mux-protocol.c.
+ *------------------------------------------------------------------------------
+ * Every record starts with a 9-byte header:
+ *   uint8  type
+ *   uint32 stream id, little-endian
+ *   uint32 payload size in bytes, little-endian
+ * followed by the payload.
+ *
+ * Records sent to the recognizer:
+ *   'A'  audio: 16-bit little-endian PCM at the model sample rate.
+ *        The first record for an id starts a new logical stream.
+ *   'E'  end of stream, no payload.
+ * Records sent by the recognizer:
+ *   'R'  result: UTF-8 text "begin-ms end-ms phrase".
+ *   'D'  done: sent once per stream, after 'E' or at end of input.
+ *        The payload is empty on success, or an error message.
+ *------------------------------------------------------------------------------
+ */
+
+#define MUX_AUDIO        'A'
+#define MUX_END          'E'
+#define MUX_RESULT       'R'
+#define MUX_DONE         'D'
+#define MUX_HEADER_SIZE    9
+/* Largest payload accepted */
+#define MUX_MAX_PAYLOAD  (1 << 20)
+
+/* Read framed records from in until it ends, and run a duplicate of
+ * session model for each logical stream. Results are written to out.
+ */
+SnsrRC
+serveMultiplexed(SnsrSession model, FILE *in, FILE *out);
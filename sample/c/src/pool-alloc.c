@@ -0,0 +1,236 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK example of a custom heap allocator that places
+ * blocks in memory pools of different speeds.
+ *------------------------------------------------------------------------------
+ * Many boards have a small amount of fast, tightly coupled on-chip SRAM and
+ * megabytes of slower external DRAM. SNSR_CONFIG_ALLOC_ADD_POOL adds memory
+ * to a single heap, so the library cannot tell the two apart.
+ *
+ * allocPools() takes a table of pools with a priority and a largest
+ * request size each. Small requests, such as the per-frame state that is
+ * read and written for every block of audio, land in the fast pool while it
+ * has room. Large buffers, such as model weights and audio history, are
+ * placed in the slow pool. A request the preferred pool is too full for
+ * spills over to the next pool in priority order.
+ *
+ * Each pool is an address-ordered first-fit free list. Adjacent free blocks
+ * are merged. Every block has a HEADER byte prefix with its size and pool.
+ * This is a simple allocator, use it with few pools of modest size.
+ *
+ * Separate snsrAllocTLSF() heaps, one per pool as in shard-alloc.c, would
+ * also work. The free list is used instead because its only overhead is
+ * the block header. A TLSF heap keeps its control structure in its pool,
+ * which takes a noticeable share of a few KiB of tightly coupled memory.
+ *
+ * See pool-bench.c for a benchmark that reports the fast pool hit ratio.
+ *------------------------------------------------------------------------------
+ */
+
+#include <snsr.h>
+
+#include <stdint.h>
+#include <string.h>
+
+#include "pool-alloc.h"
+
+/* Block header size and alignment */
+#define HEADER     16
+/* Smallest block, the header and a free list link */
+#define MIN_BLOCK  32
+
+/* Rounds size up to a multiple of HEADER */
+#define ALIGN_UP(size) (((size) + HEADER - 1) & ~(size_t)(HEADER - 1))
+
+/* Allocated blocks start with a Header, free blocks with a FreeBlock */
+typedef struct {
+  size_t size;                 /* block size, including the header      */
+  size_t pool;                 /* index into Pools.pool                 */
+} Header;
+
+typedef struct FreeBlock_ {
+  size_t size;
+  struct FreeBlock_ *next;     /* next free block, by address           */
+} FreeBlock;
+
+typedef struct {
+  AllocPool def;
+  FreeBlock *free;
+  AllocPoolStats stats;
+} Pool;
+
+typedef struct {
+  Pool pool[ALLOC_POOLS_MAX];
+  unsigned order[ALLOC_POOLS_MAX]; /* pool indices, highest priority first */
+  unsigned count;
+} Pools;
+
+static Pools Heap;
+static SnsrAlloc_Vmt PoolsVmt;
+
+
+static void
+initPool(Pool *p, const AllocPool *def)
+{
+  uintptr_t start = ALIGN_UP((uintptr_t)def->start);
+  uintptr_t end = ((uintptr_t)def->start + def->size) & ~(uintptr_t)(HEADER-1);
+
+  memset(p, 0, sizeof(*p));
+  p->def = *def;
+  if (end > start && end - start >= MIN_BLOCK) {
+    p->free = (FreeBlock *)start;
+    p->free->size = end - start;
+    p->free->next = NULL;
+  }
+}
+
+
+/* First fit. Returns a block of size bytes, or NULL. */
+static Header *
+takeBlock(Pool *p, size_t size)
+{
+  FreeBlock **link, *b, *rest;
+
+  for (link = &p->free; (b = *link); link = &b->next) {
+    if (b->size < size) continue;
+    if (b->size - size >= MIN_BLOCK) {
+      rest = (FreeBlock *)((char *)b + size);
+      rest->size = b->size - size;
+      rest->next = b->next;
+      *link = rest;
+    } else {
+      size = b->size;
+      *link = b->next;
+    }
+    p->stats.inUse += size;
+    if (p->stats.inUse > p->stats.peak) p->stats.peak = p->stats.inUse;
+    ((Header *)b)->size = size;
+    return (Header *)b;
+  }
+  return NULL;
+}
+
+
+/* Return h to the free list, merging it with its free neighbors. */
+static void
+giveBlock(Pool *p, Header *h)
+{
+  FreeBlock **link, *b = (FreeBlock *)h, *prev = NULL;
+
+  p->stats.inUse -= h->size;
+  for (link = &p->free; *link && *link < b; link = &(*link)->next)
+    prev = *link;
+  b->next = *link;
+  *link = b;
+  if (b->next && (char *)b + b->size == (char *)b->next) {
+    b->size += b->next->size;
+    b->next = b->next->next;
+  }
+  if (prev && (char *)prev + prev->size == (char *)b) {
+    prev->size += b->size;
+    prev->next = b->next;
+  }
+}
+
+
+static void *
+poolsMalloc(void *ctx, size_t size)
+{
+  Pools *h = (Pools *)ctx;
+  size_t need;
+  unsigned i;
+  Header *b;
+
+  if (size > (size_t)-1 - 2 * HEADER) return NULL;
+  need = ALIGN_UP(HEADER + size);
+  if (need < MIN_BLOCK) need = MIN_BLOCK;
+  for (i = 0; i < h->count; i++) {
+    Pool *p = h->pool + h->order[i];
+    if (p->def.maxAlloc && size > p->def.maxAlloc) continue;
+    if ((b = takeBlock(p, need))) {
+      b->pool = h->order[i];
+      p->stats.allocs++;
+      p->stats.bytes += size;
+      return (char *)b + HEADER;
+    }
+    p->stats.spills++;
+  }
+  return NULL;
+}
+
+
+static void
+poolsFree(void *ctx, void *ptr)
+{
+  Pools *h = (Pools *)ctx;
+  Header *b = (Header *)((char *)ptr - HEADER);
+
+  giveBlock(h->pool + b->pool, b);
+}
+
+
+static size_t
+poolsSize(void *ctx, void *ptr)
+{
+  return ((Header *)((char *)ptr - HEADER))->size - HEADER;
+}
+
+
+static void *
+poolsRealloc(void *ctx, void *ptr, size_t size)
+{
+  size_t old = poolsSize(ctx, ptr);
+  void *p;
+
+  if (size <= old) return ptr;
+  p = poolsMalloc(ctx, size);
+  if (!p) return NULL;
+  memcpy(p, ptr, old);
+  poolsFree(ctx, ptr);
+  return p;
+}
+
+
+static size_t
+poolsRoundUp(void *ctx, size_t size)
+{
+  size_t need = ALIGN_UP(HEADER + size);
+  return (need < MIN_BLOCK? MIN_BLOCK: need) - HEADER;
+}
+
+
+const SnsrAlloc_Vmt *
+allocPools(const AllocPool *pool, unsigned count)
+{
+  unsigned i, j;
+
+  if (!count || count > ALLOC_POOLS_MAX) return NULL;
+  memset(&Heap, 0, sizeof(Heap));
+  Heap.count = count;
+  for (i = 0; i < count; i++) {
+    initPool(Heap.pool + i, pool + i);
+    /* Insertion sort on priority, keeping the table order for ties */
+    for (j = i; j > 0; j--) {
+      if (pool[Heap.order[j - 1]].priority >= pool[i].priority) break;
+      Heap.order[j] = Heap.order[j - 1];
+    }
+    Heap.order[j] = i;
+  }
+  memset(&PoolsVmt, 0, sizeof(PoolsVmt));
+  PoolsVmt.malloc = poolsMalloc;
+  PoolsVmt.free = poolsFree;
+  PoolsVmt.realloc = poolsRealloc;
+  PoolsVmt.size = poolsSize;
+  PoolsVmt.roundUp = poolsRoundUp;
+  PoolsVmt.ctx = &Heap;
+  return &PoolsVmt;
+}
+
+
+void
+allocPoolsStats(unsigned index, AllocPoolStats *stats)
+{
+  if (index < Heap.count) *stats = Heap.pool[index].stats;
+  else memset(stats, 0, sizeof(*stats));
+}
@@ -0,0 +1,39 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK custom heap allocator header. See pool-alloc.c.
+ *------------------------------------------------------------------------------
+ */
+
+#define ALLOC_POOLS_MAX 4
+
+typedef struct {
+  void *start;                 /* pool memory, 16-byte aligned          */
+  size_t size;                 /* pool size in bytes                    */
+  int priority;                /* pools are tried highest first         */
+  size_t maxAlloc;             /* largest request placed here, 0 for any */
+} AllocPool;
+
+typedef struct {
+  size_t allocs;               /* blocks allocated from this pool       */
+  size_t bytes;                /* bytes requested from this pool        */
+  size_t spills;               /* eligible requests this pool was too
+                                * full for, passed to the next pool     */
+  size_t inUse;                /* bytes allocated now, with overhead    */
+  size_t peak;                 /* largest inUse                         */
+} AllocPoolStats;
+
+/* Heap allocator over up to ALLOC_POOLS_MAX memory pools, such as a small
+ * fast on-chip SRAM and a large external DRAM. A request goes to the
+ * highest priority pool that accepts its size and has room.
+ * The pool table is copied. Not thread-safe, wrap it with snsrAllocLock()
+ * if the library is used on more than one thread.
+ */
+const SnsrAlloc_Vmt *
+allocPools(const AllocPool *pool, unsigned count);
+
+/* Statistics for pool index, in the order given to allocPools(), since
+ * the allocPools() call.
+ */
+void
+allocPoolsStats(unsigned index, AllocPoolStats *stats);
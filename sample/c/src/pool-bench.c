@@ -0,0 +1,197 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK benchmark for the multi-pool allocator in pool-alloc.c.
+ *------------------------------------------------------------------------------
+ * Simulates a board with a small fast on-chip SRAM and a large slow
+ * external DRAM with two static arrays. Runs the built-in spotter model on
+ * the data.c audio once for each fast pool size limit, and reports the
+ * share of allocations served by the fast pool.
+ *
+ * The load phase covers snsrNew() and snsrLoad(), the run phase the
+ * snsrPush() calls. Blocks allocated while audio is processed are the hot
+ * ones, so the run phase hit ratio is the number to maximize, without
+ * running the fast pool out of room for them during the load phase.
+ *------------------------------------------------------------------------------
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <snsr.h>
+
+#include "pool-alloc.h"
+
+/* See spot-hbg-enUS-1.4.0-m.c */
+extern SnsrCodeModel spot_hbg_enUS_1_3_0_m;
+
+/* See data.c */
+extern unsigned char audioData[];
+extern unsigned int  audioDataLen;
+
+#define BLOCK_MS       15
+#define SAMPLE_RATE 16000
+#define BLOCK_BYTES (BLOCK_MS * SAMPLE_RATE / 1000 * sizeof(short))
+
+/* Simulated tightly coupled SRAM, the largest -f accepts */
+#define FAST_POOL_SIZE (256 * 1024)
+/* Simulated external DRAM */
+#define SLOW_POOL_SIZE (16 * 1024 * 1024)
+
+#define FAST 0
+#define SLOW 1
+
+/* Utility, returns the lesser of a and b */
+#define MIN(a, b) ((a) < (b)? (a): (b))
+
+static size_t FastPool[FAST_POOL_SIZE / sizeof(size_t)];
+static size_t SlowPool[SLOW_POOL_SIZE / sizeof(size_t)];
+
+/* Fast pool size limits tried without -m. 0 places any size. */
+static const size_t MaxAlloc[] = {64, 256, 1024, 4096, 16384, 65536, 0};
+
+
+static void
+fatal(int rc, const char *format, ...)
+{
+  va_list a;
+  fprintf(stderr, "ERROR: ");
+  va_start(a, format);
+  vfprintf(stderr, format, a);
+  va_end(a);
+  fprintf(stderr, "\n");
+  exit(rc);
+}
+
+
+static void
+usage(const char *name)
+{
+  fprintf(stderr,
+          "usage: %s [options]\n"
+          " options:\n"
+          "  -f bytes    : fast pool size (default and largest: %i)\n"
+          "  -m bytes    : largest request placed in the fast pool\n"
+          "                (default: try several)\n"
+          "  -r count    : push the audio count times per run (default: 1)\n",
+          name, FAST_POOL_SIZE);
+  exit(199);
+}
+
+
+/* The slow pool is large enough for the built-in model, running out of
+ * it is a configuration error.
+ */
+static void
+panicFunc(const char *format, va_list a)
+{
+  fprintf(stderr, "ERROR: ");
+  vfprintf(stderr, format, a);
+  fprintf(stderr, "\n");
+  exit(SNSR_RC_NO_MEMORY);
+}
+
+
+static double
+percent(size_t part, size_t whole)
+{
+  return whole? 100.0 * part / whole: 0;
+}
+
+
+/* Run the model on the built-in audio with the given fast pool, and print
+ * one line of the report.
+ */
+static void
+bench(size_t fastSize, size_t maxAlloc, int repeat)
+{
+  AllocPool pool[2];
+  AllocPoolStats load[2], done[2];
+  SnsrSession s;
+  SnsrRC r;
+  size_t runAllocs[2];
+  unsigned i;
+  int k;
+  char limit[32];
+
+  memset(pool, 0, sizeof(pool));
+  pool[FAST].start = FastPool;
+  pool[FAST].size = fastSize;
+  pool[FAST].priority = 1;
+  pool[FAST].maxAlloc = maxAlloc;
+  pool[SLOW].start = SlowPool;
+  pool[SLOW].size = sizeof(SlowPool);
+
+  r = snsrConfig(SNSR_CONFIG_ALLOC, allocPools(pool, 2));
+  if (r != SNSR_RC_OK)
+    fatal(r, "Custom allocation failure: %s", snsrRCMessage(r));
+  r = snsrNew(&s);
+  if (r != SNSR_RC_OK)
+    fatal(r, "%s", s? snsrErrorDetail(s): snsrRCMessage(r));
+  snsrLoad(s, snsrStreamFromCode(spot_hbg_enUS_1_3_0_m));
+  if (snsrRequire(s, SNSR_TASK_TYPE, SNSR_PHRASESPOT) != SNSR_RC_OK)
+    fatal(snsrRC(s), "%s", snsrErrorDetail(s));
+  for (i = 0; i < 2; i++) allocPoolsStats(i, load + i);
+
+  for (k = 0; k < repeat; k++) {
+    for (i = 0; i < audioDataLen; i += BLOCK_BYTES) {
+      r = snsrPush(s, SNSR_SOURCE_AUDIO_PCM, audioData + i,
+                   MIN(BLOCK_BYTES, audioDataLen - i));
+      if (r == SNSR_RC_STOP) snsrClearRC(s);
+      else if (r != SNSR_RC_OK) fatal(r, "%s", snsrErrorDetail(s));
+    }
+  }
+  r = snsrStop(s);
+  if (r != SNSR_RC_OK && r != SNSR_RC_STOP && r != SNSR_RC_STREAM_END)
+    fatal(r, "%s", snsrErrorDetail(s));
+  for (i = 0; i < 2; i++) {
+    allocPoolsStats(i, done + i);
+    runAllocs[i] = done[i].allocs - load[i].allocs;
+  }
+  snsrRelease(s);
+  snsrTearDown();
+
+  if (maxAlloc) sprintf(limit, "%lu", (unsigned long)maxAlloc);
+  else strcpy(limit, "any");
+  printf("%9s %9.1f%% %9.1f%% %10lu %10lu %8lu\n", limit,
+         percent(load[FAST].allocs, load[FAST].allocs + load[SLOW].allocs),
+         percent(runAllocs[FAST], runAllocs[FAST] + runAllocs[SLOW]),
+         (unsigned long)done[FAST].peak, (unsigned long)done[SLOW].peak,
+         (unsigned long)done[FAST].spills);
+}
+
+
+int
+main(int argc, char *argv[])
+{
+  long fastSize = FAST_POOL_SIZE, maxAlloc = -1;
+  int o, repeat = 1;
+  unsigned i;
+  extern char *optarg;
+  extern int optind;
+
+  while ((o = getopt(argc, argv, "f:m:r:?")) >= 0) {
+    switch (o) {
+    case 'f': fastSize = atol(optarg); break;
+    case 'm': maxAlloc = atol(optarg); break;
+    case 'r': repeat = atoi(optarg); break;
+    default:  usage(argv[0]);
+    }
+  }
+  if (optind != argc || fastSize <= 0 || fastSize > FAST_POOL_SIZE
+      || repeat <= 0 || maxAlloc < -1) usage(argv[0]);
+
+  snsrConfig(SNSR_CONFIG_PANIC_FUNC, panicFunc);
+  printf("Fast pool %ld bytes, slow pool %lu bytes.\n",
+         fastSize, (unsigned long)sizeof(SlowPool));
+  printf(" max fast  load hits   run hits  fast peak  slow peak   spills\n");
+  if (maxAlloc >= 0) {
+    bench((size_t)fastSize, (size_t)maxAlloc, repeat);
+  } else {
+    for (i = 0; i < sizeof(MaxAlloc) / sizeof(*MaxAlloc); i++)
+      bench((size_t)fastSize, MaxAlloc[i], repeat);
+  }
+  return 0;
+}
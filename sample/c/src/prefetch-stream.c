@@ -0,0 +1,293 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK example of a custom stream that reads another ahead
+ * on a helper thread.
+ *------------------------------------------------------------------------------
+ * snsrRun() pulls audio from its source stream on the session thread, so
+ * every slow read from a network share, a cold disk or a decoder stalls
+ * recognition. This stream wraps any readable stream and keeps up to a
+ * configurable number of bytes read ahead in a single-producer
+ * single-consumer ring.
+ *
+ * The ring head and tail are atomic byte counts, so neither side takes a
+ * lock while data or space is available. A side only sleeps on the
+ * condition variable after finding the ring empty or full, and the other
+ * side only takes the lock to wake it if it said it was waiting.
+ *
+ * Windows builds return the source stream unchanged.
+ *------------------------------------------------------------------------------
+ */
+
+#include <snsr.h>
+
+#include "prefetch-stream.h"
+
+#ifdef _WIN32
+
+SnsrStream
+streamFromPrefetch(SnsrStream source, size_t ahead)
+{
+  return source;
+}
+
+
+size_t
+prefetchStalls(SnsrStream b)
+{
+  return 0;
+}
+
+#else
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MIN_RING  4096
+/* Largest single read from the source */
+#define MAX_READ  (64 * 1024)
+
+typedef struct {
+  SnsrStream source;
+  char *ring;
+  size_t ringMask;             /* ring size in bytes, minus one         */
+  size_t stalls;               /* reads that found the ring empty       */
+  atomic_size_t head;          /* total bytes written by the thread     */
+  atomic_size_t tail;          /* total bytes read by streamRead()      */
+  atomic_int done;             /* set once the source read fails        */
+  atomic_int stop;             /* set to ask the helper thread to exit  */
+  atomic_int readerWaiting;    /* 1 while streamRead() waits for data   */
+  atomic_int writerWaiting;    /* 1 while the thread waits for space    */
+  SnsrRC sourceRC;             /* source status, valid once done is set */
+  char *detail;                /* source error detail, or NULL          */
+  int threadRunning;
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t woken;
+} ProviderData;
+
+
+/* Wake the side that set waiting, if it is asleep. The fence orders the
+ * preceding head, tail, done or stop update before the waiting check, so
+ * a side that sets waiting and then rechecks cannot miss the update.
+ */
+static void
+wake(ProviderData *d, atomic_int *waiting)
+{
+  atomic_thread_fence(memory_order_seq_cst);
+  if (!atomic_load_explicit(waiting, memory_order_relaxed)) return;
+  if (!atomic_exchange(waiting, 0)) return;
+  pthread_mutex_lock(&d->lock);
+  pthread_cond_broadcast(&d->woken);
+  pthread_mutex_unlock(&d->lock);
+}
+
+
+/* Sleep until the other side calls wake() on waiting. */
+static void
+sleepUntilWoken(ProviderData *d, atomic_int *waiting)
+{
+  pthread_mutex_lock(&d->lock);
+  while (atomic_load(waiting)) pthread_cond_wait(&d->woken, &d->lock);
+  pthread_mutex_unlock(&d->lock);
+}
+
+
+static void *
+prefetchLoop(void *arg)
+{
+  ProviderData *d = (ProviderData *)arg;
+  size_t size = d->ringMask + 1;
+  size_t head, tail, at, n;
+  SnsrRC r;
+
+  while (!atomic_load(&d->stop)) {
+    head = atomic_load_explicit(&d->head, memory_order_relaxed);
+    tail = atomic_load_explicit(&d->tail, memory_order_acquire);
+    if (head - tail == size) {
+      atomic_store(&d->writerWaiting, 1);
+      atomic_thread_fence(memory_order_seq_cst);
+      if (tail == atomic_load(&d->tail) && !atomic_load(&d->stop))
+        sleepUntilWoken(d, &d->writerWaiting);
+      else atomic_store(&d->writerWaiting, 0);
+      continue;
+    }
+    at = head & d->ringMask;
+    n = size - (head - tail);
+    if (n > size - at) n = size - at;
+    if (n > MAX_READ) n = MAX_READ;
+    n = snsrStreamRead(d->source, d->ring + at, 1, n);
+    atomic_store_explicit(&d->head, head + n, memory_order_release);
+    r = snsrStreamRC(d->source);
+    if (r != SNSR_RC_OK) {
+      d->sourceRC = r;
+      if (r != SNSR_RC_EOF)
+        d->detail = strdup(snsrStreamErrorDetail(d->source));
+      atomic_store(&d->done, 1);
+    }
+    wake(d, &d->readerWaiting);
+    if (r != SNSR_RC_OK) break;
+  }
+  return NULL;
+}
+
+
+static void
+stopThread(ProviderData *d)
+{
+  if (!d->threadRunning) return;
+  atomic_store(&d->stop, 1);
+  wake(d, &d->writerWaiting);
+  pthread_join(d->thread, NULL);
+  d->threadRunning = 0;
+}
+
+
+static SnsrRC
+streamOpen(SnsrStream b)
+{
+  ProviderData *d = (ProviderData *)snsrStream_getData(b);
+  SnsrRC r;
+  int e;
+
+  r = snsrStreamOpen(d->source);
+  if (r != SNSR_RC_OK) {
+    snsrStream_setDetail(b, "%s", snsrStreamErrorDetail(d->source));
+    return r;
+  }
+  free(d->detail);
+  d->detail = NULL;
+  d->sourceRC = SNSR_RC_OK;
+  d->stalls = 0;
+  atomic_store(&d->head, 0);
+  atomic_store(&d->tail, 0);
+  atomic_store(&d->done, 0);
+  atomic_store(&d->stop, 0);
+  atomic_store(&d->readerWaiting, 0);
+  atomic_store(&d->writerWaiting, 0);
+  e = pthread_create(&d->thread, NULL, prefetchLoop, d);
+  if (e) {
+    snsrStreamClose(d->source);
+    snsrStream_setDetail(b, "Could not start prefetch thread: %s",
+                         strerror(e));
+    return SNSR_RC_ERROR;
+  }
+  d->threadRunning = 1;
+  return SNSR_RC_OK;
+}
+
+
+static SnsrRC
+streamClose(SnsrStream b)
+{
+  ProviderData *d = (ProviderData *)snsrStream_getData(b);
+
+  stopThread(d);
+  return snsrStreamClose(d->source);
+}
+
+
+static void
+streamRelease(SnsrStream b)
+{
+  ProviderData *d = (ProviderData *)snsrStream_getData(b);
+
+  stopThread(d);
+  snsrRelease(d->source);
+  pthread_cond_destroy(&d->woken);
+  pthread_mutex_destroy(&d->lock);
+  free(d->detail);
+  free(d->ring);
+  free(d);
+}
+
+
+static size_t
+streamRead(SnsrStream b, void *buffer, size_t size)
+{
+  ProviderData *d = (ProviderData *)snsrStream_getData(b);
+  size_t head, tail, at, n, total = 0;
+
+  while (total < size) {
+    tail = atomic_load_explicit(&d->tail, memory_order_relaxed);
+    head = atomic_load_explicit(&d->head, memory_order_acquire);
+    if (head == tail) {
+      if (atomic_load(&d->done)) {
+        /* The last read may have landed after head was loaded above */
+        head = atomic_load_explicit(&d->head, memory_order_acquire);
+        if (head != tail) continue;
+        if (d->sourceRC != SNSR_RC_EOF)
+          snsrStream_setDetail(b, "%s", d->detail? d->detail: "");
+        snsrStream_setRC(b, d->sourceRC);
+        break;
+      }
+      d->stalls++;
+      atomic_store(&d->readerWaiting, 1);
+      atomic_thread_fence(memory_order_seq_cst);
+      if (head == atomic_load(&d->head) && !atomic_load(&d->done))
+        sleepUntilWoken(d, &d->readerWaiting);
+      else atomic_store(&d->readerWaiting, 0);
+      continue;
+    }
+    at = tail & d->ringMask;
+    n = head - tail;
+    if (n > size - total) n = size - total;
+    if (n > d->ringMask + 1 - at) n = d->ringMask + 1 - at;
+    memcpy((char *)buffer + total, d->ring + at, n);
+    atomic_store_explicit(&d->tail, tail + n, memory_order_release);
+    wake(d, &d->writerWaiting);
+    total += n;
+  }
+  return total;
+}
+
+
+static SnsrStream_Vmt ProviderDef = {
+  "prefetch",
+  &streamOpen, &streamClose, &streamRelease, &streamRead, NULL
+};
+
+
+SnsrStream
+streamFromPrefetch(SnsrStream source, size_t ahead)
+{
+  SnsrStream b;
+  ProviderData *d;
+  size_t size = MIN_RING;
+
+  if (!source) return NULL;
+  snsrRetain(source);
+  while (size < ahead) size <<= 1;
+  d = calloc(1, sizeof(*d));
+  if (d) d->ring = malloc(size);
+  if (!d || !d->ring) {
+    free(d);
+    snsrRelease(source);
+    return NULL;
+  }
+  d->source = source;
+  d->ringMask = size - 1;
+  pthread_mutex_init(&d->lock, NULL);
+  pthread_cond_init(&d->woken, NULL);
+  b = snsrStream_alloc(&ProviderDef, d, 1, 0);
+  if (!b) {
+    pthread_cond_destroy(&d->woken);
+    pthread_mutex_destroy(&d->lock);
+    snsrRelease(source);
+    free(d->ring);
+    free(d);
+  }
+  return b;
+}
+
+
+size_t
+prefetchStalls(SnsrStream b)
+{
+  if (!b || snsrStream_getVmt(b) != &ProviderDef) return 0;
+  return ((ProviderData *)snsrStream_getData(b))->stalls;
+}
+
+#endif
@@ -0,0 +1,19 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK custom stream header. See prefetch-stream.c.
+ *------------------------------------------------------------------------------
+ */
+
+/* Readable stream that reads source ahead on a helper thread, keeping up
+ * to ahead bytes buffered. ahead is rounded up to a power of two.
+ * Takes ownership of source.
+ */
+SnsrStream
+streamFromPrefetch(SnsrStream source, size_t ahead);
+
+/* Number of times a read from b found the buffer empty and had to wait
+ * for the helper thread.
+ */
+size_t
+prefetchStalls(SnsrStream b);
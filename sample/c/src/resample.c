@@ -0,0 +1,227 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK sample rate converter, used by alsa-stream.c to
+ * convert 44.1 kHz or 48 kHz capture devices to the 16 kHz the recognizer
+ * expects without relying on the ALSA plug layer.
+ *------------------------------------------------------------------------------
+ * Polyphase FIR resampler for 16-bit mono audio. The rate ratio is reduced
+ * to outRate/inRate = L/M, and a Kaiser-windowed sinc low-pass prototype is
+ * split into L phases of TAPS coefficients each. Every output sample is a
+ * single TAPS-long dot product of Q15 coefficients with the input history,
+ * vectorized with SSE2 or NEON where available.
+ *------------------------------------------------------------------------------
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#  include <arm_neon.h>
+#endif
+
+#include "resample.h"
+
+/* Zero crossings of the sinc prototype on each side of the center tap,
+ * measured at the lower of the two sample rates.
+ */
+#define ZERO_CROSSINGS 8
+/* Pass band edge, as a fraction of the lower Nyquist frequency */
+#define CUTOFF      0.90
+/* Kaiser window shape, ~80 dB stop band attenuation */
+#define KAISER_BETA 8.0
+/* Coefficient count per phase is padded to a multiple of this */
+#define TAP_ALIGN      8
+/* Q15 fixed-point scale */
+#define Q15        32768
+
+#ifndef M_PI
+#  define M_PI 3.14159265358979323846
+#endif
+
+struct Resampler_ {
+  int16_t *coef;       /* L phases of taps coefficients, time-reversed */
+  int16_t *history;    /* input samples, taps - 1 of history + maxIn   */
+  size_t maxIn;        /* largest input block accepted                 */
+  size_t count;        /* valid samples in history                     */
+  unsigned taps;       /* coefficients per phase                       */
+  unsigned L, M;       /* interpolation and decimation factors         */
+  unsigned phase;      /* current phase, 0 <= phase < L                */
+  size_t q;            /* history index of the next output's center    */
+};
+
+
+static unsigned
+gcd(unsigned a, unsigned b)
+{
+  while (b) {
+    unsigned t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+
+/* Zeroth-order modified Bessel function of the first kind */
+static double
+besselI0(double x)
+{
+  double sum = 1, term = 1, k;
+  for (k = 1; k < 50; k++) {
+    term *= (x / (2 * k)) * (x / (2 * k));
+    sum += term;
+    if (term < sum * 1e-12) break;
+  }
+  return sum;
+}
+
+
+/* Returns the dot product of n 16-bit samples and coefficients.
+ * n is a multiple of TAP_ALIGN.
+ */
+static int32_t
+dot(const int16_t *x, const int16_t *c, unsigned n)
+{
+  unsigned i;
+#if defined(__SSE2__)
+  __m128i acc = _mm_setzero_si128();
+  for (i = 0; i < n; i += 8) {
+    __m128i a = _mm_loadu_si128((const __m128i *)(x + i));
+    __m128i b = _mm_loadu_si128((const __m128i *)(c + i));
+    acc = _mm_add_epi32(acc, _mm_madd_epi16(a, b));
+  }
+  acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+  acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(acc);
+#elif defined(__ARM_NEON)
+  int32x4_t acc = vdupq_n_s32(0);
+  int32x2_t sum;
+  for (i = 0; i < n; i += 8) {
+    acc = vmlal_s16(acc, vld1_s16(x + i), vld1_s16(c + i));
+    acc = vmlal_s16(acc, vld1_s16(x + i + 4), vld1_s16(c + i + 4));
+  }
+  sum = vadd_s32(vget_low_s32(acc), vget_high_s32(acc));
+  return vget_lane_s32(vpadd_s32(sum, sum), 0);
+#else
+  int32_t acc = 0;
+  for (i = 0; i < n; i++) acc += (int32_t)x[i] * c[i];
+  return acc;
+#endif
+}
+
+
+Resampler
+resamplerNew(unsigned int inRate, unsigned int outRate, size_t maxIn)
+{
+  Resampler r;
+  unsigned g, k, p, n, length;
+  double fc, center, t, w, sum;
+  double *proto;
+
+  if (!inRate || !outRate || !maxIn) return NULL;
+  r = calloc(1, sizeof(*r));
+  if (!r) return NULL;
+  g = gcd(inRate, outRate);
+  r->L = outRate / g;
+  r->M = inRate / g;
+  r->maxIn = maxIn;
+  r->taps = 2 * ZERO_CROSSINGS * (inRate > outRate? inRate: outRate)
+    / (inRate < outRate? inRate: outRate);
+  r->taps = (r->taps + TAP_ALIGN - 1) / TAP_ALIGN * TAP_ALIGN;
+
+  length = r->taps * r->L;
+  proto = malloc(length * sizeof(*proto));
+  r->coef = malloc(length * sizeof(*r->coef));
+  r->history = calloc(r->taps - 1 + maxIn, sizeof(*r->history));
+  if (!proto || !r->coef || !r->history) {
+    free(proto);
+    resamplerRelease(r);
+    return NULL;
+  }
+
+  /* Low-pass prototype at the interpolated rate inRate * L */
+  fc = CUTOFF * 0.5 * (inRate < outRate? inRate: outRate)
+    / ((double)inRate * r->L);
+  center = (length - 1) / 2.0;
+  for (n = 0; n < length; n++) {
+    t = n - center;
+    w = 1 - (t / center) * (t / center);
+    w = besselI0(KAISER_BETA * sqrt(w > 0? w: 0)) / besselI0(KAISER_BETA);
+    proto[n] = 2 * fc * (t == 0? 1: sin(2 * M_PI * fc * t) / (2 * M_PI * fc * t));
+    proto[n] *= w;
+  }
+
+  /* Split into phases. Each phase is normalized to unity DC gain and
+   * stored time-reversed, so the dot product runs forward over history.
+   */
+  for (p = 0; p < r->L; p++) {
+    sum = 0;
+    for (k = 0; k < r->taps; k++) sum += proto[k * r->L + p];
+    for (k = 0; k < r->taps; k++) {
+      double v = proto[k * r->L + p] / sum * Q15;
+      r->coef[p * r->taps + r->taps - 1 - k] =
+        (int16_t)(v >= Q15 - 1? Q15 - 1: floor(v + 0.5));
+    }
+  }
+  free(proto);
+  r->count = r->taps - 1;
+  r->q = r->taps - 1;
+  return r;
+}
+
+
+size_t
+resamplerMaxOut(Resampler r, size_t inCount)
+{
+  return inCount * r->L / r->M + 2;
+}
+
+
+size_t
+resamplerProcess(Resampler r, const short *in, size_t inCount, short *out)
+{
+  size_t produced = 0, keep;
+  int32_t acc;
+
+  if (inCount > r->maxIn) inCount = r->maxIn;
+  memcpy(r->history + r->count, in, inCount * sizeof(*in));
+  r->count += inCount;
+
+  /* Output sample y[n] uses history[q - taps + 1 .. q] with phase
+   * coefficients coef[phase]. Each output advances the upsampled
+   * time index by M.
+   */
+  while (r->q < r->count) {
+    acc = dot(r->history + r->q - (r->taps - 1),
+              r->coef + r->phase * r->taps, r->taps);
+    acc = (acc + Q15 / 2) >> 15;
+    out[produced++] = acc > INT16_MAX? INT16_MAX:
+      acc < INT16_MIN? INT16_MIN: (short)acc;
+    r->phase += r->M;
+    r->q += r->phase / r->L;
+    r->phase %= r->L;
+  }
+
+  /* Discard input that no future output depends on. */
+  keep = r->count - (r->q - (r->taps - 1) < r->count?
+                     r->q - (r->taps - 1): r->count);
+  memmove(r->history, r->history + r->count - keep, keep * sizeof(*in));
+  r->q -= r->count - keep;
+  r->count = keep;
+  return produced;
+}
+
+
+void
+resamplerRelease(Resampler r)
+{
+  if (!r) return;
+  free(r->coef);
+  free(r->history);
+  free(r);
+}
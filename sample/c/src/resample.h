@@ -0,0 +1,30 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK sample rate converter header. See resample.c.
+ *------------------------------------------------------------------------------
+ */
+
+typedef struct Resampler_ *Resampler;
+
+/* Create a converter for 16-bit mono audio from inRate to outRate Hz.
+ * Each resamplerProcess() call accepts at most maxIn input samples.
+ * Returns NULL if the rates are not supported or memory is exhausted.
+ */
+Resampler
+resamplerNew(unsigned int inRate, unsigned int outRate, size_t maxIn);
+
+/* Convert inCount samples from in, writing the result to out.
+ * out must have room for resamplerMaxOut(r, inCount) samples.
+ * Returns the number of samples written to out.
+ */
+size_t
+resamplerProcess(Resampler r, const short *in, size_t inCount, short *out);
+
+/* Upper bound on the number of samples produced from inCount input samples.
+ */
+size_t
+resamplerMaxOut(Resampler r, size_t inCount);
+
+void
+resamplerRelease(Resampler r);
@@ -0,0 +1,206 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK example of a custom stream that reads a list of
+ * memory blocks and streams as one, without copying.
+ *------------------------------------------------------------------------------
+ * Nesting snsrStreamFromStreams(a, b) N times to concatenate N inputs
+ * creates a chain N streams deep that every read has to walk. This stream
+ * keeps a flat array of segments and the index of the current one, so a
+ * read costs the same no matter how many segments there are. Stream
+ * segments are opened when the read reaches them, and closed at their
+ * end, so only one file is open at a time.
+ *------------------------------------------------------------------------------
+ */
+
+#include <snsr.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "sg-stream.h"
+
+/* Initial segment array size, doubles as needed */
+#define INITIAL_SEGMENTS 16
+
+typedef struct {
+  const char *data;            /* memory segment, or NULL               */
+  SnsrStream stream;           /* stream segment, or NULL               */
+  size_t size;                 /* memory segment size in bytes          */
+} Segment;
+
+typedef struct {
+  Segment *segment;
+  size_t segmentCount;
+  size_t segmentAlloc;
+  size_t current;              /* index of the segment being read       */
+  size_t offset;               /* read offset in a memory segment       */
+  int streamOpen;              /* 1 if the current stream is open       */
+} ProviderData;
+
+
+static void
+closeCurrent(ProviderData *d)
+{
+  if (d->streamOpen) {
+    snsrStreamClose(d->segment[d->current].stream);
+    d->streamOpen = 0;
+  }
+}
+
+
+static SnsrRC
+streamOpen(SnsrStream b)
+{
+  ProviderData *d = (ProviderData *)snsrStream_getData(b);
+
+  d->current = 0;
+  d->offset = 0;
+  return SNSR_RC_OK;
+}
+
+
+static SnsrRC
+streamClose(SnsrStream b)
+{
+  ProviderData *d = (ProviderData *)snsrStream_getData(b);
+
+  closeCurrent(d);
+  return SNSR_RC_OK;
+}
+
+
+static void
+streamRelease(SnsrStream b)
+{
+  ProviderData *d = (ProviderData *)snsrStream_getData(b);
+  size_t i;
+
+  closeCurrent(d);
+  for (i = 0; i < d->segmentCount; i++) snsrRelease(d->segment[i].stream);
+  free(d->segment);
+  free(d);
+}
+
+
+static size_t
+streamRead(SnsrStream b, void *buffer, size_t size)
+{
+  ProviderData *d = (ProviderData *)snsrStream_getData(b);
+  size_t n, total = 0;
+
+  while (total < size && d->current < d->segmentCount) {
+    Segment *s = d->segment + d->current;
+    if (s->stream) {
+      SnsrRC rc;
+      if (!d->streamOpen) {
+        rc = snsrStreamOpen(s->stream);
+        if (rc != SNSR_RC_OK) {
+          snsrStream_setDetail(b, "%s", snsrStreamErrorDetail(s->stream));
+          snsrStream_setRC(b, rc);
+          return total;
+        }
+        d->streamOpen = 1;
+      }
+      total += snsrStreamRead(s->stream, (char *)buffer + total,
+                              1, size - total);
+      rc = snsrStreamRC(s->stream);
+      if (rc == SNSR_RC_OK) continue;
+      if (rc != SNSR_RC_EOF) {
+        snsrStream_setDetail(b, "%s", snsrStreamErrorDetail(s->stream));
+        snsrStream_setRC(b, rc);
+        return total;
+      }
+      closeCurrent(d);
+    } else {
+      n = s->size - d->offset;
+      if (n > size - total) n = size - total;
+      memcpy((char *)buffer + total, s->data + d->offset, n);
+      d->offset += n;
+      total += n;
+      if (d->offset < s->size) continue;
+    }
+    d->current++;
+    d->offset = 0;
+  }
+  if (d->current == d->segmentCount) snsrStream_setRC(b, SNSR_RC_EOF);
+  return total;
+}
+
+
+static SnsrStream_Vmt ProviderDef = {
+  "scatter-gather",
+  &streamOpen, &streamClose, &streamRelease, &streamRead, NULL
+};
+
+
+static int
+isSegmentStream(SnsrStream b)
+{
+  return b && snsrStream_getVmt(b) == &ProviderDef;
+}
+
+
+static Segment *
+addSegment(SnsrStream b)
+{
+  ProviderData *d = (ProviderData *)snsrStream_getData(b);
+
+  if (d->segmentCount == d->segmentAlloc) {
+    size_t alloc = d->segmentAlloc? 2 * d->segmentAlloc: INITIAL_SEGMENTS;
+    Segment *s = realloc(d->segment, alloc * sizeof(*s));
+    if (!s) return NULL;
+    d->segment = s;
+    d->segmentAlloc = alloc;
+  }
+  return memset(d->segment + d->segmentCount++, 0, sizeof(Segment));
+}
+
+
+SnsrStream
+streamFromSegments(void)
+{
+  ProviderData *d = calloc(1, sizeof(*d));
+  SnsrStream b;
+
+  if (!d) return NULL;
+  b = snsrStream_alloc(&ProviderDef, d, 1, 0);
+  if (!b) free(d);
+  return b;
+}
+
+
+SnsrRC
+streamSegmentsAddMemory(SnsrStream b, const void *data, size_t size)
+{
+  Segment *s;
+
+  if (!isSegmentStream(b)) return SNSR_RC_INVALID_HANDLE;
+  if (!data && size) return SNSR_RC_INVALID_ARG;
+  s = addSegment(b);
+  if (!s) return SNSR_RC_NO_MEMORY;
+  s->data = data? data: "";
+  s->size = size;
+  return SNSR_RC_OK;
+}
+
+
+SnsrRC
+streamSegmentsAddStream(SnsrStream b, SnsrStream stream)
+{
+  Segment *s;
+
+  if (!stream) return SNSR_RC_INVALID_ARG;
+  snsrRetain(stream);
+  if (!isSegmentStream(b)) {
+    snsrRelease(stream);
+    return SNSR_RC_INVALID_HANDLE;
+  }
+  s = addSegment(b);
+  if (!s) {
+    snsrRelease(stream);
+    return SNSR_RC_NO_MEMORY;
+  }
+  s->stream = stream;
+  return SNSR_RC_OK;
+}
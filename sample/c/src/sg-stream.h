@@ -0,0 +1,25 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK custom stream header. See sg-stream.c.
+ *------------------------------------------------------------------------------
+ */
+
+/* Create an empty readable scatter-gather stream.
+ * Add segments with streamSegmentsAddMemory() and streamSegmentsAddStream()
+ * before the first read.
+ */
+SnsrStream
+streamFromSegments(void);
+
+/* Append size bytes at data. The memory is not copied, and must remain
+ * valid until the stream is released.
+ */
+SnsrRC
+streamSegmentsAddMemory(SnsrStream b, const void *data, size_t size);
+
+/* Append the contents of readable stream s, up to its end.
+ * The scatter-gather stream retains s.
+ */
+SnsrRC
+streamSegmentsAddStream(SnsrStream b, SnsrStream s);
@@ -0,0 +1,266 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK example of a lock-sharded TLSF heap allocator for
+ * sessions that run on many threads.
+ *------------------------------------------------------------------------------
+ * snsrAllocLock(snsrAllocTLSF(pool, size)) serializes every allocation
+ * of every thread behind one mutex. This allocator splits the pool into
+ * up to SHARDS_MAX snsrAllocTLSF() heaps, each with a lock of its own:
+ *
+ * - Each thread is given an id the first time it allocates, and its home
+ *   shard is the id modulo the number of shards. Threads contend only
+ *   with those that share their shard.
+ * - Each block carries a HEADER byte prefix that records the shard it
+ *   came from.
+ * - A thread that frees a block from another shard does not take that
+ *   shard's lock. It pushes the block onto a lock-free deferred free
+ *   queue in the owning shard, which is emptied by the next thread to
+ *   lock that shard.
+ * - When the home shard is full, the allocation spills to the next shard
+ *   that has room.
+ *
+ * Unlike arena-alloc.c, all memory comes from the fixed pool, as on
+ * systems without a system heap. The pool is split evenly, so each shard
+ * must hold the sessions of the threads that share it; size it with
+ * heap-size.c and some margin for spills.
+ *------------------------------------------------------------------------------
+ */
+
+#include <snsr.h>
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#include "shard-alloc.h"
+
+/* Keeps blocks aligned to 16 bytes */
+#define HEADER 16
+
+typedef union Header_ {
+  struct {
+    unsigned shard;            /* index into Shards                     */
+    union Header_ *next;       /* deferred free queue link              */
+  } h;
+  char align[HEADER];
+} Header;
+
+typedef struct {
+  pthread_mutex_t lock;
+  const SnsrAlloc_Vmt *heap;   /* snsrAllocTLSF() on this part of pool  */
+  size_t allocs;               /* statistics, under lock                */
+  size_t locks;
+  size_t contended;
+  size_t spills;
+  /* Written by other threads, kept off the owner's cache lines */
+  char pad[64];
+  _Atomic(Header *) deferred;  /* blocks freed by other shards' threads */
+  atomic_size_t deferredFrees;
+  /* Keeps the next shard's lock off these cache lines */
+  char tail[64];
+} Shard;
+
+static Shard Shards[SHARDS_MAX];
+static unsigned ShardCount;
+static SnsrAlloc_Vmt ShardVmt;
+static atomic_uint NextThread;
+
+/* 1 + the thread's id, 0 until the thread first allocates */
+static _Thread_local unsigned ThreadId;
+
+
+static unsigned
+homeShard(void)
+{
+  if (!ThreadId) ThreadId = atomic_fetch_add(&NextThread, 1) + 1;
+  return (ThreadId - 1) % ShardCount;
+}
+
+
+/* Lock s and free the blocks other threads queued on it. */
+static void
+lockShard(Shard *s)
+{
+  Header *b, *next;
+
+  if (pthread_mutex_trylock(&s->lock)) {
+    pthread_mutex_lock(&s->lock);
+    s->contended++;
+  }
+  s->locks++;
+  if (!atomic_load_explicit(&s->deferred, memory_order_relaxed)) return;
+  b = atomic_exchange_explicit(&s->deferred, NULL, memory_order_acquire);
+  for (; b; b = next) {
+    next = b->h.next;
+    s->heap->free(s->heap->ctx, b);
+  }
+}
+
+
+static void *
+shardMalloc(void *ctx, size_t size)
+{
+  Header *b = NULL;
+  unsigned home, i, k;
+  Shard *s;
+
+  if (size > (size_t)-1 - HEADER) return NULL;
+  home = homeShard();
+  for (i = 0; i < ShardCount && !b; i++) {
+    k = (home + i) % ShardCount;
+    s = Shards + k;
+    lockShard(s);
+    if (!i) s->allocs++;
+    b = (Header *)s->heap->malloc(s->heap->ctx, HEADER + size);
+    if (b) {
+      b->h.shard = k;
+      if (i) s->spills++;
+    }
+    pthread_mutex_unlock(&s->lock);
+  }
+  return b? b + 1: NULL;
+}
+
+
+static void
+shardFree(void *ctx, void *ptr)
+{
+  Header *b = (Header *)ptr - 1;
+  Shard *s = Shards + b->h.shard;
+
+  if (b->h.shard == homeShard()) {
+    lockShard(s);
+    s->heap->free(s->heap->ctx, b);
+    pthread_mutex_unlock(&s->lock);
+  } else {
+    atomic_fetch_add_explicit(&s->deferredFrees, 1, memory_order_relaxed);
+    b->h.next = atomic_load_explicit(&s->deferred, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(
+             &s->deferred, &b->h.next, b,
+             memory_order_release, memory_order_relaxed))
+      ;
+  }
+}
+
+
+static size_t
+shardSize(void *ctx, void *ptr)
+{
+  Header *b = (Header *)ptr - 1;
+  Shard *s = Shards + b->h.shard;
+  size_t size;
+
+  lockShard(s);
+  size = s->heap->size(s->heap->ctx, b) - HEADER;
+  pthread_mutex_unlock(&s->lock);
+  return size;
+}
+
+
+/* Resizes in the owning shard, which may be another thread's. If that
+ * shard is full, moves the block to the home shard.
+ */
+static void *
+shardRealloc(void *ctx, void *ptr, size_t size)
+{
+  Header *b = (Header *)ptr - 1, *n;
+  Shard *s = Shards + b->h.shard;
+  size_t old;
+  void *p;
+
+  if (size > (size_t)-1 - HEADER) return NULL;
+  lockShard(s);
+  s->allocs++;
+  old = s->heap->size(s->heap->ctx, b) - HEADER;
+  n = (Header *)s->heap->realloc(s->heap->ctx, b, HEADER + size);
+  pthread_mutex_unlock(&s->lock);
+  if (n) return n + 1;
+
+  if (!(p = shardMalloc(ctx, size))) return NULL;
+  memcpy(p, ptr, old < size? old: size);
+  shardFree(ctx, ptr);
+  return p;
+}
+
+
+static SnsrAllocRC
+shardSetUp(void *ctx)
+{
+  SnsrAllocRC r = SNSR_ALLOC_RC_OK;
+  unsigned i;
+
+  for (i = 0; i < ShardCount && r == SNSR_ALLOC_RC_OK; i++)
+    if (Shards[i].heap->setUp)
+      r = Shards[i].heap->setUp(Shards[i].heap->ctx);
+  return r;
+}
+
+
+/* Release all memory. Must not race with any other allocator call. */
+static SnsrAllocRC
+shardTearDown(void *ctx)
+{
+  SnsrAllocRC r = SNSR_ALLOC_RC_OK, t;
+  unsigned i;
+
+  for (i = 0; i < ShardCount; i++) {
+    atomic_store(&Shards[i].deferred, NULL);
+    if (Shards[i].heap->tearDown) {
+      t = Shards[i].heap->tearDown(Shards[i].heap->ctx);
+      if (r == SNSR_ALLOC_RC_OK) r = t;
+    }
+  }
+  return r;
+}
+
+
+const SnsrAlloc_Vmt *
+allocShards(void *start, size_t size, unsigned shards)
+{
+  size_t part;
+  unsigned i;
+
+  if (!shards || shards > SHARDS_MAX) return NULL;
+  /* Keeps each part aligned as start is */
+  part = size / shards & ~(size_t)(HEADER - 1);
+  for (i = 0; i < ShardCount; i++) pthread_mutex_destroy(&Shards[i].lock);
+  memset(Shards, 0, sizeof(Shards));
+  ShardCount = 0;
+  for (i = 0; i < shards; i++) {
+    Shards[i].heap = snsrAllocTLSF((char *)start + i * part, part);
+    if (!Shards[i].heap || !Shards[i].heap->size) return NULL;
+    pthread_mutex_init(&Shards[i].lock, NULL);
+    ShardCount = i + 1;
+  }
+  memset(&ShardVmt, 0, sizeof(ShardVmt));
+  ShardVmt.malloc = shardMalloc;
+  ShardVmt.free = shardFree;
+  ShardVmt.realloc = shardRealloc;
+  ShardVmt.size = shardSize;
+  ShardVmt.setUp = shardSetUp;
+  ShardVmt.tearDown = shardTearDown;
+  return &ShardVmt;
+}
+
+
+void
+allocShardsStats(ShardStats *stats)
+{
+  unsigned i;
+  Shard *s;
+
+  memset(stats, 0, sizeof(*stats));
+  stats->shards = ShardCount;
+  for (i = 0; i < ShardCount; i++) {
+    s = Shards + i;
+    pthread_mutex_lock(&s->lock);
+    stats->allocs += s->allocs;
+    stats->locks += s->locks;
+    stats->contended += s->contended;
+    stats->spills += s->spills;
+    pthread_mutex_unlock(&s->lock);
+    stats->deferredFrees += atomic_load_explicit(&s->deferredFrees,
+                                                 memory_order_relaxed);
+  }
+}
@@ -0,0 +1,34 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK sharded heap allocator header. See shard-alloc.c.
+ *------------------------------------------------------------------------------
+ */
+
+#define SHARDS_MAX 64
+
+/* Thread-safe heap allocator that splits the size byte pool at start
+ * into shards snsrAllocTLSF() heaps, each with its own lock. Use with
+ * snsrConfig(SNSR_CONFIG_ALLOC, allocShards(pool, size, shards)).
+ * Do not wrap it with snsrAllocLock().
+ *
+ * Returns NULL if shards is 0 or larger than SHARDS_MAX, or if the pool
+ * is too small to split.
+ */
+const SnsrAlloc_Vmt *
+allocShards(void *start, size_t size, unsigned shards);
+
+typedef struct {
+  unsigned shards;
+  size_t allocs;               /* malloc and realloc calls              */
+  size_t locks;                /* shard lock acquisitions               */
+  size_t contended;            /* of locks, the ones that had to wait   */
+  size_t deferredFrees;        /* blocks freed by a thread of another
+                                * shard, queued for the owner           */
+  size_t spills;               /* allocations from another shard,
+                                * because the thread's shard was full   */
+} ShardStats;
+
+/* Allocator statistics since the allocShards() call. */
+void
+allocShardsStats(ShardStats *stats);
@@ -0,0 +1,289 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK multi-threaded session scaling benchmark.
+ *------------------------------------------------------------------------------
+ * Runs spotter sessions on 1, 2, 4, ... threads from one fixed pool, with
+ * snsrAllocLock(snsrAllocTLSF()) and with the lock-sharded allocator in
+ * shard-alloc.c.
+ *
+ * The model is loaded once. Each thread takes an snsrDup() copy of it,
+ * then for each pass duplicates that copy, pushes the data.c audio
+ * through the duplicate and releases it, as a server does for each
+ * request. All allocation is in the timed loop, so the run measures both
+ * the recognizer and the allocator under contention.
+ *
+ * Reports the audio processed per second of wall time, in multiples of
+ * real time, and the speedup over one thread. For the sharded allocator
+ * also the share of lock acquisitions that had to wait, the frees
+ * deferred to another shard, and the allocations that spilled into
+ * another shard.
+ *------------------------------------------------------------------------------
+ */
+
+#include <snsr.h>
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "shard-alloc.h"
+
+/* See spot-hbg-enUS-1.4.0-m.c */
+extern SnsrCodeModel spot_hbg_enUS_1_3_0_m;
+
+/* See data.c */
+extern unsigned char audioData[];
+extern unsigned int  audioDataLen;
+
+#define DEFAULT_THREADS   64
+#define DEFAULT_PASSES    20
+#define DEFAULT_POOL_MB  256
+
+#define BLOCK_MS       15
+#define SAMPLE_RATE 16000
+#define BLOCK_BYTES (BLOCK_MS * SAMPLE_RATE / 1000 * sizeof(short))
+
+/* Utility, returns the lesser of a and b */
+#define MIN(a, b) ((a) < (b)? (a): (b))
+
+typedef enum {
+  ALLOC_LOCK,
+  ALLOC_SHARDS,
+  ALLOC_KINDS
+} AllocKind;
+
+typedef struct Bench_ Bench;
+
+typedef struct {
+  Bench *bench;
+  SnsrRC rc;
+  pthread_t thread;
+} Worker;
+
+struct Bench_ {
+  SnsrSession model;
+  pthread_mutex_t modelLock;   /* the model handle is shared            */
+  int passes;
+  /* Start gate, workers wait on gate until all of them are ready */
+  pthread_mutex_t gateLock;
+  pthread_cond_t gate;
+  unsigned ready;              /* workers waiting at the gate           */
+  int go;                      /* 1 once the timed run has started      */
+};
+
+static const char *AllocName[ALLOC_KINDS] = {
+  "tlsf+lock", "tlsf shards"
+};
+
+
+static void
+fatal(int rc, const char *format, ...)
+{
+  va_list a;
+  fprintf(stderr, "ERROR: ");
+  va_start(a, format);
+  vfprintf(stderr, format, a);
+  va_end(a);
+  fprintf(stderr, "\n");
+  exit(rc);
+}
+
+
+static void
+usage(const char *name)
+{
+  fprintf(stderr,
+          "usage: %s [options]\n"
+          " options:\n"
+          "  -m MiB      : pool size (default: %i)\n"
+          "  -p passes   : sessions run by each thread (default: %i)\n"
+          "  -s shards   : number of shards (default: one per thread, "
+          "at most %i)\n"
+          "  -t threads  : largest number of threads (default: %i)\n"
+          "  -T task     : task filename (default: built-in spotter)\n",
+          name, DEFAULT_POOL_MB, DEFAULT_PASSES, SHARDS_MAX,
+          DEFAULT_THREADS);
+  exit(199);
+}
+
+
+/* Monotonic clock time in seconds */
+static double
+wallSeconds(void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+
+/* Push the data.c audio through s. Returns SNSR_RC_OK, or the error. */
+static SnsrRC
+pushAudio(SnsrSession s)
+{
+  size_t i;
+  SnsrRC r = SNSR_RC_OK;
+
+  for (i = 0; i < audioDataLen && r == SNSR_RC_OK; i += BLOCK_BYTES) {
+    r = snsrPush(s, SNSR_SOURCE_AUDIO_PCM, audioData + i,
+                 MIN(BLOCK_BYTES, audioDataLen - i));
+    if (r == SNSR_RC_STOP) {
+      snsrClearRC(s);
+      r = SNSR_RC_OK;
+    }
+  }
+  return r;
+}
+
+
+static void *
+workerThread(void *arg)
+{
+  Worker *w = (Worker *)arg;
+  Bench *b = w->bench;
+  SnsrSession own = NULL, s;
+  int p;
+
+  pthread_mutex_lock(&b->modelLock);
+  w->rc = snsrDup(b->model, &own);
+  pthread_mutex_unlock(&b->modelLock);
+  pthread_mutex_lock(&b->gateLock);
+  b->ready++;
+  pthread_cond_broadcast(&b->gate);
+  while (!b->go) pthread_cond_wait(&b->gate, &b->gateLock);
+  pthread_mutex_unlock(&b->gateLock);
+  for (p = 0; p < b->passes && w->rc == SNSR_RC_OK; p++) {
+    s = NULL;
+    w->rc = snsrDup(own, &s);
+    if (w->rc == SNSR_RC_OK) w->rc = pushAudio(s);
+    snsrRelease(s);
+  }
+  snsrRelease(own);
+  return NULL;
+}
+
+
+/* Run threads sessions at a time with allocator kind on the pool, and
+ * report the audio processed per second, in multiples of real time.
+ * single is the speed with one thread, set when threads is 1.
+ */
+static void
+bench(AllocKind kind, unsigned threads, unsigned shards, int passes,
+      void *pool, size_t poolSize, const char *task, double *single)
+{
+  const SnsrAlloc_Vmt *vmt;
+  ShardStats stats;
+  Bench b;
+  Worker *w = calloc(threads, sizeof(*w));
+  double start, seconds, speed;
+  SnsrRC r;
+  unsigned t;
+
+  if (!w) fatal(SNSR_RC_NO_MEMORY, "out of memory");
+  if (!shards) shards = MIN(threads, SHARDS_MAX);
+  if (kind == ALLOC_SHARDS)
+    vmt = allocShards(pool, poolSize, shards);
+  else
+    vmt = snsrAllocLock(snsrAllocTLSF(pool, poolSize));
+  if (!vmt) fatal(SNSR_RC_NO_MEMORY, "%s: pool too small", AllocName[kind]);
+  r = snsrConfig(SNSR_CONFIG_ALLOC, vmt);
+  if (r != SNSR_RC_OK)
+    fatal(r, "Custom allocation failure: %s", snsrRCMessage(r));
+
+  memset(&b, 0, sizeof(b));
+  b.passes = passes;
+  pthread_mutex_init(&b.modelLock, NULL);
+  pthread_mutex_init(&b.gateLock, NULL);
+  pthread_cond_init(&b.gate, NULL);
+  r = snsrNew(&b.model);
+  if (r != SNSR_RC_OK)
+    fatal(r, "%s", b.model? snsrErrorDetail(b.model): snsrRCMessage(r));
+  snsrLoad(b.model, task? snsrStreamFromFileName(task, "r"):
+           snsrStreamFromCode(spot_hbg_enUS_1_3_0_m));
+  if (snsrRC(b.model) != SNSR_RC_OK)
+    fatal(snsrRC(b.model), "%s", snsrErrorDetail(b.model));
+
+  for (t = 0; t < threads; t++) {
+    w[t].bench = &b;
+    if (pthread_create(&w[t].thread, NULL, workerThread, w + t))
+      fatal(SNSR_RC_ERROR, "could not start thread %u", t);
+  }
+  pthread_mutex_lock(&b.gateLock);
+  while (b.ready < threads) pthread_cond_wait(&b.gate, &b.gateLock);
+  start = wallSeconds();
+  b.go = 1;
+  pthread_cond_broadcast(&b.gate);
+  pthread_mutex_unlock(&b.gateLock);
+  for (t = 0; t < threads; t++) pthread_join(w[t].thread, NULL);
+  seconds = wallSeconds() - start;
+  for (t = 0; t < threads; t++)
+    if (w[t].rc != SNSR_RC_OK)
+      fatal(w[t].rc, "%s, thread %u: %s (try a larger pool with -m)",
+            AllocName[kind], t, snsrRCMessage(w[t].rc));
+
+  snsrRelease(b.model);
+  if (kind == ALLOC_SHARDS) allocShardsStats(&stats);
+  snsrTearDown();
+  pthread_cond_destroy(&b.gate);
+  pthread_mutex_destroy(&b.gateLock);
+  pthread_mutex_destroy(&b.modelLock);
+  free(w);
+
+  speed = threads * passes * (double)audioDataLen
+    / (SAMPLE_RATE * sizeof(short)) / seconds;
+  if (threads == 1) *single = speed;
+  printf("%-12s %3u threads: %8.1f x real time, %5.2fx", AllocName[kind],
+         threads, speed, speed / *single);
+  if (kind == ALLOC_SHARDS)
+    printf(", %2u shards, %5.2f%% contended, %lu deferred, %lu spilled",
+           stats.shards,
+           stats.locks? 100.0 * stats.contended / stats.locks: 0.0,
+           (unsigned long)stats.deferredFrees, (unsigned long)stats.spills);
+  printf("\n");
+}
+
+
+int
+main(int argc, char *argv[])
+{
+  double single[ALLOC_KINDS];
+  const char *task = NULL;
+  int o, threads = DEFAULT_THREADS, passes = DEFAULT_PASSES;
+  int poolMB = DEFAULT_POOL_MB, shards = 0;
+  unsigned t, k;
+  void *pool;
+  extern char *optarg;
+  extern int optind;
+
+  while ((o = getopt(argc, argv, "m:p:s:t:T:?")) >= 0) {
+    switch (o) {
+    case 'm': poolMB = atoi(optarg); break;
+    case 'p': passes = atoi(optarg); break;
+    case 's': shards = atoi(optarg); break;
+    case 't': threads = atoi(optarg); break;
+    case 'T': task = optarg; break;
+    default:  usage(argv[0]);
+    }
+  }
+  if (optind != argc || poolMB <= 0 || passes <= 0 || threads <= 0
+      || shards < 0 || shards > SHARDS_MAX) usage(argv[0]);
+
+  /* Aligned to the CPU word size, as snsrAllocTLSF() requires */
+  pool = malloc((size_t)poolMB << 20);
+  if (!pool) fatal(SNSR_RC_NO_MEMORY, "out of memory");
+
+  /* 1, 2, 4, ... threads, ending with the given number */
+  for (t = 1;; t = 2 * t < (unsigned)threads? 2 * t: (unsigned)threads) {
+    for (k = 0; k < ALLOC_KINDS; k++)
+      bench((AllocKind)k, t, (unsigned)shards, passes, pool,
+            (size_t)poolMB << 20, task, single + k);
+    if (t == (unsigned)threads) break;
+  }
+  free(pool);
+  return 0;
+}
@@ -0,0 +1,123 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK example of an allocator that tracks the live bytes.
+ *------------------------------------------------------------------------------
+ * allocSized() wraps another allocator and counts the bytes requested
+ * and not yet freed. Each block carries a HEADER byte prefix that holds
+ * the requested size, so frees are accounted for exactly whether or not
+ * the wrapped allocator implements size().
+ *
+ * The heap profiler in alloc-profile.c and the fault injector in
+ * fault-alloc.c are built on it, through the fail and event callbacks.
+ *------------------------------------------------------------------------------
+ */
+
+#include <snsr.h>
+
+#include <string.h>
+
+#include "sized-alloc.h"
+
+/* Keeps blocks aligned to 16 bytes */
+#define HEADER 16
+
+
+static void *
+sizedMalloc(void *ctx, size_t size)
+{
+  SizedHeap *h = (SizedHeap *)ctx;
+  char *b;
+
+  if (h->fail && h->fail(h, size)) return NULL;
+  b = size <= (size_t)-1 - HEADER?
+    (char *)h->heap->malloc(h->heap->ctx, HEADER + size): NULL;
+  if (!b) {
+    if (h->event) h->event(h, SIZED_FAILED, size);
+    return NULL;
+  }
+  memcpy(b, &size, sizeof(size));
+  h->live += size;
+  h->liveBlocks++;
+  if (h->event) h->event(h, SIZED_MALLOC, size);
+  return b + HEADER;
+}
+
+
+static void
+sizedFree(void *ctx, void *ptr)
+{
+  SizedHeap *h = (SizedHeap *)ctx;
+  char *b = (char *)ptr - HEADER;
+  size_t size;
+
+  memcpy(&size, b, sizeof(size));
+  h->live -= size;
+  h->liveBlocks--;
+  h->heap->free(h->heap->ctx, b);
+  if (h->event) h->event(h, SIZED_FREE, size);
+}
+
+
+static void *
+sizedRealloc(void *ctx, void *ptr, size_t size)
+{
+  SizedHeap *h = (SizedHeap *)ctx;
+  char *b = (char *)ptr - HEADER;
+  size_t old;
+
+  if (h->fail && h->fail(h, size)) return NULL;
+  memcpy(&old, b, sizeof(old));
+  b = size <= (size_t)-1 - HEADER?
+    (char *)h->heap->realloc(h->heap->ctx, b, HEADER + size): NULL;
+  if (!b) {
+    if (h->event) h->event(h, SIZED_FAILED, size);
+    return NULL;
+  }
+  memcpy(b, &size, sizeof(size));
+  h->live = h->live - old + size;
+  if (h->event) h->event(h, SIZED_REALLOC, size);
+  return b + HEADER;
+}
+
+
+static size_t
+sizedSize(void *ctx, void *ptr)
+{
+  size_t size;
+
+  memcpy(&size, (char *)ptr - HEADER, sizeof(size));
+  return size;
+}
+
+
+static SnsrAllocRC
+sizedSetUp(void *ctx)
+{
+  SizedHeap *h = (SizedHeap *)ctx;
+  return h->heap->setUp? h->heap->setUp(h->heap->ctx): SNSR_ALLOC_RC_OK;
+}
+
+
+static SnsrAllocRC
+sizedTearDown(void *ctx)
+{
+  SizedHeap *h = (SizedHeap *)ctx;
+  return h->heap->tearDown? h->heap->tearDown(h->heap->ctx): SNSR_ALLOC_RC_OK;
+}
+
+
+const SnsrAlloc_Vmt *
+allocSized(SizedHeap *h, const SnsrAlloc_Vmt *heap)
+{
+  memset(h, 0, sizeof(*h));
+  h->heap = heap;
+  h->vmt.malloc = sizedMalloc;
+  h->vmt.free = sizedFree;
+  h->vmt.realloc = sizedRealloc;
+  h->vmt.size = sizedSize;
+  h->vmt.setUp = sizedSetUp;
+  h->vmt.tearDown = sizedTearDown;
+  h->vmt.ctx = h;
+  return &h->vmt;
+}
@@ -0,0 +1,39 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK size-prefix allocator header. See sized-alloc.c.
+ *------------------------------------------------------------------------------
+ */
+
+typedef enum {
+  SIZED_MALLOC,                /* malloc() succeeded                    */
+  SIZED_REALLOC,               /* realloc() succeeded                   */
+  SIZED_FREE,
+  SIZED_FAILED                 /* the wrapped heap returned NULL        */
+} SizedEvent;
+
+typedef struct SizedHeap_ SizedHeap;
+
+struct SizedHeap_ {
+  const SnsrAlloc_Vmt *heap;   /* wrapped allocator                     */
+  /* Called before each malloc() and realloc() with the requested size.
+   * Returns 1 to fail the call without passing it to heap. May be NULL.
+   */
+  int (*fail)(SizedHeap *h, size_t size);
+  /* Called after the live counts below are updated. size is the size
+   * requested, or for SIZED_FREE the size of the block freed. May be NULL.
+   */
+  void (*event)(SizedHeap *h, SizedEvent e, size_t size);
+  void *ctx;                   /* for the callbacks                     */
+  size_t live;                 /* requested bytes currently allocated   */
+  size_t liveBlocks;           /* blocks currently allocated            */
+  SnsrAlloc_Vmt vmt;
+};
+
+/* Allocator that passes each call to heap and keeps the size requested
+ * for each block, so h->live is exact whether or not heap implements
+ * size(). Set h->fail, h->event and h->ctx after this call. Returns
+ * &h->vmt. Not thread-safe.
+ */
+const SnsrAlloc_Vmt *
+allocSized(SizedHeap *h, const SnsrAlloc_Vmt *heap);
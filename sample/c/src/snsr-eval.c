@@ -22,6 +22,16 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "alloc-profile.h"
+#include "async-stream.h"
+#include "codec-stream.h"
+#include "direct-stream.h"
+#include "flac-stream.h"
+#include "mux-protocol.h"
+#include "prefetch-stream.h"
+#include "sg-stream.h"
+#include "trace-stream.h"
+
 #define TASKS_SUPPORTED\
   SNSR_PHRASESPOT " ~0.5.0 || 1.0.0;"\
   SNSR_PHRASESPOT_VAD " ~0.5.0 || 1.0.0;"\
@@ -34,6 +44,8 @@
 
 #define DEFAULT_SAMPLE_RATE 16000
 #define DEFAULT_FRAME_SIZE_MS  15
+/* Sample rate of headerless -e encoded audio */
+#define DEFAULT_ENCODED_RATE 8000
 
 #if defined(_MSC_VER) && (_MSC_VER < 1900)
 # define snprintf _snprintf
@@ -416,20 +428,40 @@ usage(const char *name)
   fprintf(stderr,
           "usage: %s -t task [options] [wavefile ...]\n"
           " options:\n"
+          "  -a depth            : read audio files ahead asynchronously,\n"
+          "                        keeping depth reads in flight\n"
+          "  -b bytes            : read audio input ahead on a helper thread,\n"
+          "                        keeping up to bytes buffered\n"
           "  -d directory        : VAD audio output directory\n"
+          "  -e encoding[:rate]  : input audio encoding, one of alaw, ulaw,\n"
+          "                        ima (headerless, default rate %i Hz) or\n"
+          "                        wav (A-law, mu-law or IMA-ADPCM WAV)\n"
           "  -f setting filename : load filename into task setting\n"
           "  -g setting value    : load string into task setting\n"
+          "  -i text|json        : time audio input stream calls, report\n"
+          "                        on stderr when done\n"
           "  -l [-l [-l]]        : reduce verbosity\n"
+          "  -m                  : serve framed, multiplexed audio streams\n"
+          "                        on stdin, write results to stdout\n"
           "  -o out              : VAD audio output filename\n"
-          "  -p [-p]             : Enable pipeline profiling (experimental)\n"
+          "  -p [-p [-p]]        : show the real-time factor, add pipeline\n"
+          "                        profiling (experimental), add a heap\n"
+          "                        allocation report\n"
           "  -s setting=value    : override a task setting\n"
           "  -t task             : specify task filename (required)\n"
-          "  -v [-v [-v]]        : increase verbosity\n", name);
+          "  -u                  : read audio files with direct I/O, without\n"
+          "                        filling the page cache\n"
+          "  -v [-v [-v]]        : increase verbosity\n",
+          name, DEFAULT_ENCODED_RATE);
   fprintf(stderr, "\nUse a filename of - to read\n"
-          "headerless linear 16-bit PCM little-endian audio from stdin.\n");
+          "headerless linear 16-bit PCM little-endian audio from stdin.\n"
+          "Files with a .flac extension are decoded as FLAC.\n");
   fprintf(stderr,
           "If no wave files are specified, live audio captured from\n"
           "the default audio device is used.\n");
+  fprintf(stderr, "\nWith -m, wavefile arguments are not allowed. Records of\n"
+          "(type, stream-id, size, payload) carry audio for any number\n"
+          "of logical streams, see mux-protocol.h for the record format.\n");
   fprintf(stderr, "\nThe -d and -o options are multually exclusive. "
           "The output directory\n"
           "must be writable. Audio files created by VAD segmentation are "
@@ -454,6 +486,47 @@ quitOnError(SnsrSession s)
 }
 
 
+/* Open filename for reading, bypassing the page cache if uncached is set,
+ * or with depth asynchronous reads in flight if depth is not zero.
+ */
+static SnsrStream
+openFile(const char *filename, int uncached, int depth)
+{
+  if (uncached) return streamFromDirectFile(filename);
+  if (depth) return streamFromAsyncFile(filename, depth, ASYNC_FILE_AUTO);
+  return snsrStreamFromFileName(filename, "r");
+}
+
+
+/* Parse an -e encoding[:rate] argument.
+ */
+static void
+parseEncoding(const char *spec, StreamCodec *codec, unsigned *rate)
+{
+  static const struct {
+    const char *name;
+    StreamCodec codec;
+  } encoding[] = {
+    {"alaw", STREAM_CODEC_ALAW},
+    {"ulaw", STREAM_CODEC_MULAW},
+    {"ima", STREAM_CODEC_IMA_ADPCM},
+    {"wav", STREAM_CODEC_WAV}
+  };
+  const char *colon = strchr(spec, ':');
+  size_t i, n = colon? (size_t)(colon - spec): strlen(spec);
+
+  for (i = 0; i < sizeof(encoding) / sizeof(*encoding); i++) {
+    if (strlen(encoding[i].name) == n && !strncmp(spec, encoding[i].name, n))
+      break;
+  }
+  if (i == sizeof(encoding) / sizeof(*encoding))
+    fatal(SNSR_RC_INVALID_ARG, "unknown audio encoding \"%s\"", spec);
+  *codec = encoding[i].codec;
+  *rate = colon? (unsigned)atoi(colon + 1): DEFAULT_ENCODED_RATE;
+  if (!*rate) fatal(SNSR_RC_INVALID_ARG, "invalid sample rate in \"%s\"", spec);
+}
+
+
 /* Report model license keys.
  */
 static void
@@ -493,6 +566,40 @@ showRealTimeFactor(SnsrSession s)
 }
 
 
+/* Duration of the audio processed, in seconds, or 0 if not available.
+ */
+static double
+audioSeconds(SnsrSession s)
+{
+  double samplesProcessed = 0;
+  int sampleRate = 0;
+
+  snsrGetDouble(s, SNSR_RES_SAMPLES, &samplesProcessed);
+  snsrGetInt(s, SNSR_SAMPLE_RATE, &sampleRate);
+  snsrClearRC(s);
+  return sampleRate > 0? samplesProcessed / sampleRate: 0;
+}
+
+
+/* Number of -p options. The heap profiler has to be configured before
+ * the first library call, so this runs ahead of getopt().
+ */
+static int
+profileLevel(int argc, char *argv[])
+{
+  int i, level = 0;
+  const char *a;
+
+  for (i = 1; i < argc && strcmp(argv[i], "--"); i++) {
+    if (argv[i][0] != '-' || argv[i][1] != 'p') continue;
+    for (a = argv[i] + 1; *a == 'p'; a++)
+      ;
+    if (!*a) level += (int)(a - argv[i]) - 1;
+  }
+  return level;
+}
+
+
 int
 main(int argc, char *argv[])
 {
@@ -500,7 +607,13 @@ main(int argc, char *argv[])
   SnsrSession s;
   SnsrStream tmp, audio = NULL;
   int i, o, profile = 0;
-  int verbose = 0;
+  int verbose = 0, encoded = 0, mux = 0, uncached = 0, depth = 0;
+  int trace = 0, heapProfile;
+  long ahead = 0;
+  double seconds = 0;
+  TraceFormat traceFormat = TRACE_TEXT;
+  StreamCodec codec = STREAM_CODEC_WAV;
+  unsigned encodedRate = DEFAULT_ENCODED_RATE;
   const char *dir = NULL, *msg = NULL, *out = NULL;
   extern char *optarg;
   extern int optind;
@@ -516,14 +629,36 @@ main(int argc, char *argv[])
 #endif
 
   if (argc == 1) usage(argv[0]);
+
+  /* With -p -p -p, count every allocation from the first one on.
+   * snsrAllocPerf() adds its own minimum pool size estimate to the report,
+   * and its lock serializes the calls into allocProfile().
+   */
+  heapProfile = profileLevel(argc, argv) > 2;
+  if (heapProfile)
+    snsrConfig(SNSR_CONFIG_ALLOC,
+               snsrAllocPerf(allocProfile(snsrAllocStdlib())));
+
   r = snsrNew(&s);
   if (r != SNSR_RC_OK) fatal(r, "%s", s? snsrErrorDetail(s): snsrRCMessage(r));
 
-  while ((o = getopt(argc, argv, "d:f:g:lo:ps:t:v?")) >= 0) {
+  while ((o = getopt(argc, argv, "a:b:d:e:f:g:i:lmo:ps:t:uv?")) >= 0) {
     switch (o) {
+    case 'a':
+      depth = atoi(optarg);
+      if (depth <= 0) usage(argv[0]);
+      break;
+    case 'b':
+      ahead = atol(optarg);
+      if (ahead <= 0) usage(argv[0]);
+      break;
     case 'd':
       dir = optarg;
       break;
+    case 'e':
+      parseEncoding(optarg, &codec, &encodedRate);
+      encoded = 1;
+      break;
     case 'f':
       if (optind >= argc) usage(argv[0]);
       snsrSetStream(s, optarg, snsrStreamFromFileName(argv[optind++], "r"));
@@ -535,9 +670,18 @@ main(int argc, char *argv[])
       snsrSetStream(s, optarg, snsrStreamFromString(argv[optind++]));
       quitOnError(s);
       break;
+    case 'i':
+      if (!strcmp(optarg, "text")) traceFormat = TRACE_TEXT;
+      else if (!strcmp(optarg, "json")) traceFormat = TRACE_JSON;
+      else usage(argv[0]);
+      trace = 1;
+      break;
     case 'l':
       verbose--;
       break;
+    case 'm':
+      mux = 1;
+      break;
     case 'o':
       out = optarg;
       break;
@@ -553,6 +697,9 @@ main(int argc, char *argv[])
       quitOnError(s);
       reportModelLicense(s, optarg, verbose);
       break;
+    case 'u':
+      uncached = 1;
+      break;
     case 'v': verbose++;
       break;
     case '?':
@@ -566,6 +713,8 @@ main(int argc, char *argv[])
 
   if (out && dir) fatal(SNSR_RC_INVALID_ARG,
                         "The -d and -o options are multually exclusive.\n");
+  if (mux && optind < argc)
+    fatal(SNSR_RC_INVALID_ARG, "The -m option does not accept wave files.\n");
 
   /* Report application license status */
   if (verbose > 1) {
@@ -578,7 +727,13 @@ main(int argc, char *argv[])
 
   r = snsrSetStream(s, SNSR_SOURCE_AUDIO_PCM, NULL);
   snsrClearRC(s);
-  if (r == SNSR_RC_OK) {
+  if (mux) {
+    /* Audio is pushed into per-stream session copies by serveMultiplexed(),
+     * leave the source stream unset.
+     */
+    if (r != SNSR_RC_OK)
+      fatal(r, "The -m option requires a task with audio input.\n");
+  } else if (r == SNSR_RC_OK) {
     /* No audio files provided, use live audio from the
      * default capture device
      */
@@ -590,17 +745,35 @@ main(int argc, char *argv[])
       }
     } else {
       /* Create stream concatenation of all the audio files */
-      audio = snsrStreamFromString("");
+      audio = streamFromSegments();
       for (i = optind; i < argc; i++) {
         if (argv[i][0] == '-' && argv[i][1] == '\0') {
           tmp = snsrStreamFromFILE(stdin, SNSR_ST_MODE_READ);
+          if (encoded) tmp = streamFromEncoded(tmp, codec, encodedRate, 0);
+        } else if (isFLACFilename(argv[i])) {
+          tmp = streamFromFLAC(openFile(argv[i], uncached, depth));
+        } else if (encoded) {
+          tmp = streamFromEncoded(openFile(argv[i], uncached, depth),
+                                  codec, encodedRate, 0);
+        } else if (uncached || depth) {
+          tmp = snsrStreamFromAudioStream(openFile(argv[i], uncached, depth),
+                                          SNSR_ST_AF_DEFAULT);
         } else {
           tmp = snsrStreamFromAudioFile(argv[i], "r", SNSR_ST_AF_DEFAULT);
         }
-        audio = snsrStreamFromStreams(audio, tmp);
+        streamSegmentsAddStream(audio, tmp);
       }
     }
 
+    /* Keep file and device reads off the session thread */
+    if (ahead) audio = streamFromPrefetch(audio, (size_t)ahead);
+
+    /* The report is printed when the session releases the stream. */
+    if (trace)
+      audio = streamFromTraced(audio, "audio",
+                               snsrStreamFromFILE(stderr, SNSR_ST_MODE_WRITE),
+                               traceFormat);
+
     /* Wire up the audio input stream. */
     snsrSetStream(s, SNSR_SOURCE_AUDIO_PCM, audio);
 
@@ -610,15 +783,16 @@ main(int argc, char *argv[])
     snsrClearRC(s);
     if (r == SNSR_RC_OK) {
       SnsrStream feature;
-      feature = snsrStreamFromString("");
-      for (i = optind; i < argc; i++) {
-        SnsrStream tmp = snsrStreamFromFileName(argv[i], "r");
-        feature = snsrStreamFromStreams(feature, tmp);
-      }
+      feature = streamFromSegments();
+      for (i = optind; i < argc; i++)
+        streamSegmentsAddStream(feature, openFile(argv[i], uncached, depth));
       r = snsrSetStream(s, SNSR_SOURCE_FEATURE, feature);
     } else r = SNSR_RC_OK;
   }
 
+  /* stdout carries protocol records with -m */
+  if (mux && verbose > 1) verbose = 1;
+
   /* The SNSR_OPERATING_POINT setting was introduced with 5.0.0-beta.10 */
   if (verbose > 1 && snsrRC(s) == SNSR_RC_OK) {
     int first = 1, point = 0;
@@ -671,6 +845,14 @@ main(int argc, char *argv[])
 
   if (r != SNSR_RC_OK) fatal(r, "%s", snsrErrorDetail(s));
 
+  if (mux) {
+    r = serveMultiplexed(s, stdin, stdout);
+    if (r != SNSR_RC_OK) fatal(r, "Multiplexed input: %s", snsrRCMessage(r));
+    snsrRelease(s);
+    snsrTearDown();
+    return 0;
+  }
+
   /* SNSR_RESULT_MAX introduced in 6.17.0, missing from older models */
   r = snsrGetInt(s, SNSR_RESULT_MAX, &full.nBest);
   if (r != SNSR_RC_OK) snsrClearRC(s);
@@ -759,7 +941,9 @@ main(int argc, char *argv[])
     if (snsrRC(s) == SNSR_RC_SETTING_NOT_FOUND) snsrClearRC(s);
   }
 
+  if (heapProfile) allocProfilePhase(ALLOC_PHASE_RUN);
   r = snsrRun(s);
+  if (heapProfile) allocProfilePhase(ALLOC_PHASE_EXIT);
   if (r != SNSR_RC_OK && r != SNSR_RC_STREAM_END)
     fatal(r, "%s", snsrErrorDetail(s));
 
@@ -768,10 +952,17 @@ main(int argc, char *argv[])
   if (profile == 1) showRealTimeFactor(s);
   else if (profile > 1)
     snsrProfile(s, snsrStreamFromFILE(stdout, SNSR_ST_MODE_WRITE));
+  if (heapProfile) seconds = audioSeconds(s);
 
   snsrRelease(s);
   snsrTearDown();
 
+  /* Blocks still live after snsrTearDown() are leaks. */
+  if (heapProfile) {
+    allocProfileReport(stdout, seconds);
+    snsrAllocPerfStats(snsrStreamFromFILE(stdout, SNSR_ST_MODE_WRITE));
+  }
+
   if (out && verbose > 0) printf("VAD audio saved to \"%s\".\n", out);
   return 0;
 }
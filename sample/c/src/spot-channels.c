@@ -0,0 +1,156 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK example: evaluate each channel of a multichannel
+ * WAV file, such as a stereo call recording, in its own session.
+ *------------------------------------------------------------------------------
+ * The file is read once and split into one stream per channel, see
+ * demux-stream.c. Each channel is processed by a copy of the same session
+ * on its own thread.
+ *------------------------------------------------------------------------------
+ */
+
+#include <snsr.h>
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "demux-stream.h"
+
+/* Per-channel ring buffer size: 2 s of 16-bit audio at 16 kHz */
+#define RING_SIZE (2 * 16000 * sizeof(short))
+
+typedef struct {
+  SnsrSession s;
+  SnsrStream audio;            /* this channel of the demultiplexer     */
+  unsigned channel;
+  SnsrRC rc;
+} Channel;
+
+static pthread_mutex_t PrintLock = PTHREAD_MUTEX_INITIALIZER;
+
+
+static void
+fatal(int rc, const char *format, ...)
+{
+  va_list a;
+  va_start(a, format);
+  vfprintf(stderr, format, a);
+  va_end(a);
+  exit(rc);
+}
+
+
+static SnsrRC
+resultEvent(SnsrSession s, const char *key, void *privateData)
+{
+  Channel *p = (Channel *)privateData;
+  SnsrRC r;
+  const char *phrase;
+  double begin, end;
+
+  snsrGetDouble(s, SNSR_RES_BEGIN_MS, &begin);
+  snsrGetDouble(s, SNSR_RES_END_MS, &end);
+  r = snsrGetString(s, SNSR_RES_TEXT, &phrase);
+  if (r != SNSR_RC_OK) return r;
+  pthread_mutex_lock(&PrintLock);
+  printf("%u %6.0f %6.0f %s\n", p->channel, begin, end, phrase);
+  fflush(stdout);
+  pthread_mutex_unlock(&PrintLock);
+  return SNSR_RC_OK;
+}
+
+
+static void *
+channelThread(void *arg)
+{
+  Channel *p = (Channel *)arg;
+
+  p->rc = snsrRun(p->s);
+  /* A failed channel stops reading, but its open stream would still hold
+   * the others back until main() releases the session, after the joins.
+   * Closing it lets the demultiplexer fill the other rings without it.
+   */
+  if (p->rc != SNSR_RC_OK && p->rc != SNSR_RC_STREAM_END)
+    snsrStreamClose(p->audio);
+  return NULL;
+}
+
+
+int
+main(int argc, char *argv[])
+{
+  SnsrSession model;
+  Demux d;
+  Channel *channel;
+  pthread_t *thread;
+  unsigned c, n;
+  int failed = 0;
+
+  if (argc < 3) {
+    fprintf(stderr, "usage: %s task wavefile [channel ...]\n"
+            "Channels are numbered from 0, the default is all channels.\n",
+            argv[0]);
+    exit(199);
+  }
+
+  snsrNew(&model);
+  snsrLoad(model, snsrStreamFromFileName(argv[1], "r"));
+  snsrRequire(model, SNSR_TASK_TYPE, SNSR_PHRASESPOT);
+  if (snsrRC(model) != SNSR_RC_OK)
+    fatal(1, "%s: %s\n", argv[1], snsrErrorDetail(model));
+
+  d = demuxNew(snsrStreamFromFileName(argv[2], "r"), RING_SIZE);
+  if (!d) fatal(1, "Could not create the demultiplexer.\n");
+  if (!demuxChannels(d)) {
+    /* Reading a channel stream reports why the file is not supported */
+    SnsrStream b = streamFromDemux(d, 0);
+    snsrRetain(b);
+    snsrStreamOpen(b);
+    fatal(1, "%s: %s\n", argv[2], snsrStreamErrorDetail(b));
+  }
+
+  n = argc > 3? (unsigned)(argc - 3): demuxChannels(d);
+  channel = calloc(n, sizeof(*channel));
+  thread = calloc(n, sizeof(*thread));
+  if (!channel || !thread) fatal(1, "Out of memory.\n");
+
+  for (c = 0; c < n; c++) {
+    Channel *p = channel + c;
+    p->channel = argc > 3? (unsigned)atoi(argv[c + 3]): c;
+    p->audio = streamFromDemux(d, p->channel);
+    if (!p->audio)
+      fatal(1, "Channel %u is out of range or was selected twice.\n",
+            p->channel);
+    snsrRetain(p->audio);
+    snsrDup(model, &p->s);
+    snsrSetStream(p->s, SNSR_SOURCE_AUDIO_PCM, p->audio);
+    snsrSetHandler(p->s, SNSR_RESULT_EVENT,
+                   snsrCallback(resultEvent, NULL, p));
+    if (snsrRC(p->s) != SNSR_RC_OK)
+      fatal(1, "channel %u: %s\n", p->channel, snsrErrorDetail(p->s));
+  }
+  demuxRelease(d);
+  snsrRelease(model);
+
+  for (c = 0; c < n; c++)
+    if (pthread_create(thread + c, NULL, channelThread, channel + c))
+      fatal(1, "Could not start the thread for channel %u.\n",
+            channel[c].channel);
+
+  for (c = 0; c < n; c++) {
+    Channel *p = channel + c;
+    pthread_join(thread[c], NULL);
+    if (p->rc != SNSR_RC_OK && p->rc != SNSR_RC_STREAM_END) {
+      fprintf(stderr, "channel %u: %s\n", p->channel, snsrErrorDetail(p->s));
+      failed = 1;
+    }
+    snsrRelease(p->s);
+    snsrRelease(p->audio);
+  }
+  free(thread);
+  free(channel);
+  return failed;
+}
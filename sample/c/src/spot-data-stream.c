@@ -8,11 +8,16 @@
  *
  * The spotter model is loaded from code space. On platforms where code is
  * read directly from ROM, this will reduce heap requirements.
+ *
+ * With -b the audio data is byte-swapped to big-endian before use, to
+ * test streamFromSamples(..) with audio that does not match the host
+ * byte order.
  *-----------------------------------------------------------------------------
  */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <snsr.h>
 
@@ -60,6 +65,21 @@ main(int argc, char **argv)
   SnsrRC rc;
   SnsrSession s = NULL;
   SnsrStream audioStream = NULL;
+  DataByteOrder order = DATA_LITTLE_ENDIAN;
+
+  if (argc == 2 && !strcmp(argv[1], "-b")) {
+    unsigned int i;
+    unsigned char t;
+    for (i = 0; i + 1 < audioDataLen; i += 2) {
+      t = audioData[i];
+      audioData[i] = audioData[i + 1];
+      audioData[i + 1] = t;
+    }
+    order = DATA_BIG_ENDIAN;
+  } else if (argc != 1) {
+    fprintf(stderr, "usage: %s [-b]\n", argv[0]);
+    exit(199);
+  }
 
   rc = snsrNew(&s);
   if (rc != SNSR_RC_OK) {
@@ -80,9 +100,10 @@ main(int argc, char **argv)
 
   /* NOTE: Audio stream should be 16 KHz, 16 bits/sample, mono */
 
-  /* NOTE: Directly casting char to short works on little-endian only */
-  /* ARM and x86 are little-endian, MIPS may not be */
-  audioStream = streamFromData(audioData, audioDataLen, SNSR_ST_MODE_READ);
+  /* NOTE: audioData is little-endian, unless swapped by -b above.
+   * streamFromSamples() converts it to host byte order if needed.
+   */
+  audioStream = streamFromSamples(audioData, audioDataLen, order);
   snsrSetStream(s, SNSR_SOURCE_AUDIO_PCM, audioStream);
 
   /* snsrRun won't return until stopped or interrupted or end of data */
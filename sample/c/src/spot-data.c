@@ -6,8 +6,16 @@
  * and push the data into the input stream and get results from the session.
  *
  * Illustrates the use of a custom memory allocator to avoid runtime
- * allocations from the system heap, and use of a panic function to
- * recover from otherwise fatal memory errors.
+ * allocations from the system heap, graceful recovery from allocation
+ * failures, and use of a panic function to recover from otherwise fatal
+ * memory errors.
+ *
+ * When an allocation fails, the allocator wrapper below first asks the
+ * application to release memory it can do without, and then adds a reserve
+ * pool to the heap, retrying the allocation after each step. Only when
+ * both are exhausted does the library panic, and the application restart.
+ * With -f count, allocation number count fails, to test this path. See
+ * fault-sweep.c for a tool that fails every allocation in turn.
  *
  * Similar to sample push-audio.c but even simpler and does not use
  * a filesystem.
@@ -47,11 +55,38 @@ extern unsigned int  audioDataLen;
 /* Heap backing store, see snsrConfig(SNSR_CONFIG_ALLOC, ...) call in main.
  *
  * Set HEAP_SIZE to 100000 to trigger an out-of-memory panic and and
- * subsequent recovery.
+ * subsequent recovery. See heap-size.c for a tool that finds the smallest
+ * size that works for a given model and audio, pool-alloc.c for an
+ * allocator that splits the heap between fast and slow memory, and
+ * huge-pool.c for a large server pool on huge pages.
  */
 #define HEAP_SIZE 200000
 static size_t HeapPool[HEAP_SIZE / sizeof(size_t)];
 
+/* Emergency memory, added to the heap when it runs out */
+#define RESERVE_SIZE 32768
+static size_t ReservePool[RESERVE_SIZE / sizeof(size_t)];
+
+/* Application buffer sharing the library heap, such as a cache of prompt
+ * audio. It is released under memory pressure, see lowMemory().
+ */
+#define CACHE_SIZE 16384
+static void *Cache;
+
+/* Allocator wrapper that recovers from allocation failures */
+typedef struct {
+  const SnsrAlloc_Vmt *heap;   /* snsrAllocTLSF() on HeapPool            */
+  /* Application callback, releases memory and returns 1 if it did */
+  int (*lowMemory)(size_t size);
+  int reserveAdded;            /* 1 once ReservePool is part of the heap */
+  unsigned long calls;         /* malloc and realloc calls so far        */
+  unsigned long failAt;        /* call number that fails, 0 for none     */
+  unsigned long recovered;     /* failures followed by a good retry      */
+} Guard;
+
+static Guard Heap;
+static SnsrAlloc_Vmt GuardVmt;
+
 /* Utility, returns the lesser of a and b */
 #define MIN(a, b) ((a) < (b)? (a): (b))
 
@@ -82,6 +117,144 @@ resultEvent(SnsrSession s, const char *key, void *privateData)
 }
 
 
+/* Low-memory callback, see Guard. Releases the application cache.
+ * This runs inside a library call, so it must not call the library.
+ */
+static int
+lowMemory(size_t size)
+{
+  if (!Cache) return 0;
+  GuardVmt.free(GuardVmt.ctx, Cache);
+  Cache = NULL;
+  fprintf(stderr, "Low memory: released the application cache.\n");
+  return 1;
+}
+
+
+/* Called after an allocation failure. Frees memory for a retry, and
+ * returns 1 if a retry might succeed.
+ */
+static int
+recover(Guard *g, size_t size)
+{
+  if (g->lowMemory && g->lowMemory(size)) return 1;
+  if (!g->reserveAdded && g->heap->addPool
+      && g->heap->addPool(g->heap->ctx, ReservePool, sizeof(ReservePool))
+      == SNSR_ALLOC_RC_OK) {
+    g->reserveAdded = 1;
+    fprintf(stderr, "Low memory: added the reserve pool.\n");
+    return 1;
+  }
+  return 0;
+}
+
+
+/* Returns 1 if this call is the -f fault injection target. */
+static int
+injectFault(Guard *g)
+{
+  return ++g->calls == g->failAt;
+}
+
+
+static void *
+guardMalloc(void *ctx, size_t size)
+{
+  Guard *g = (Guard *)ctx;
+  void *p = injectFault(g)? NULL: g->heap->malloc(g->heap->ctx, size);
+
+  if (p) return p;
+  while (recover(g, size)) {
+    g->calls++;
+    if ((p = g->heap->malloc(g->heap->ctx, size))) {
+      g->recovered++;
+      break;
+    }
+  }
+  return p;
+}
+
+
+static void
+guardFree(void *ctx, void *ptr)
+{
+  Guard *g = (Guard *)ctx;
+  g->heap->free(g->heap->ctx, ptr);
+}
+
+
+static void *
+guardRealloc(void *ctx, void *ptr, size_t size)
+{
+  Guard *g = (Guard *)ctx;
+  void *p = injectFault(g)? NULL: g->heap->realloc(g->heap->ctx, ptr, size);
+
+  if (p) return p;
+  while (recover(g, size)) {
+    g->calls++;
+    if ((p = g->heap->realloc(g->heap->ctx, ptr, size))) {
+      g->recovered++;
+      break;
+    }
+  }
+  return p;
+}
+
+
+static size_t
+guardSize(void *ctx, void *ptr)
+{
+  Guard *g = (Guard *)ctx;
+  return g->heap->size(g->heap->ctx, ptr);
+}
+
+
+static size_t
+guardRoundUp(void *ctx, size_t size)
+{
+  Guard *g = (Guard *)ctx;
+  return g->heap->roundUp(g->heap->ctx, size);
+}
+
+
+static SnsrAllocRC
+guardSetUp(void *ctx)
+{
+  Guard *g = (Guard *)ctx;
+  return g->heap->setUp? g->heap->setUp(g->heap->ctx): SNSR_ALLOC_RC_OK;
+}
+
+
+static SnsrAllocRC
+guardTearDown(void *ctx)
+{
+  Guard *g = (Guard *)ctx;
+  return g->heap->tearDown? g->heap->tearDown(g->heap->ctx): SNSR_ALLOC_RC_OK;
+}
+
+
+/* Wrap heap in the global Guard and return its method table. */
+static const SnsrAlloc_Vmt *
+guard(const SnsrAlloc_Vmt *heap, unsigned long failAt)
+{
+  if (!heap) return NULL;
+  memset(&Heap, 0, sizeof(Heap));
+  Heap.heap = heap;
+  Heap.lowMemory = lowMemory;
+  Heap.failAt = failAt;
+  memset(&GuardVmt, 0, sizeof(GuardVmt));
+  GuardVmt.malloc = guardMalloc;
+  GuardVmt.free = guardFree;
+  GuardVmt.realloc = guardRealloc;
+  if (heap->size) GuardVmt.size = guardSize;
+  if (heap->roundUp) GuardVmt.roundUp = guardRoundUp;
+  GuardVmt.setUp = guardSetUp;
+  GuardVmt.tearDown = guardTearDown;
+  GuardVmt.ctx = &Heap;
+  return &GuardVmt;
+}
+
+
 /* Saved calling environment used by panicFunc() below */
 static jmp_buf PanicJmp;
 
@@ -104,21 +277,34 @@ main(int argc, char **argv)
 {
   SnsrRC rc;
   SnsrSession s = NULL;
-  int jmp;
+  int jmp, guarded = 0;
   unsigned i;
+  unsigned long failAt = 0;
+
+  if (argc == 3 && !strcmp(argv[1], "-f")) {
+    failAt = strtoul(argv[2], NULL, 10);
+  } else if (argc != 1) {
+    fprintf(stderr, "usage: %s [-f count]\n", argv[0]);
+    return 199;
+  }
 
   /* Register a custom panic handler */
   snsrConfig(SNSR_CONFIG_PANIC_FUNC, panicFunc);
 
   if ((jmp = setjmp(PanicJmp))) {
-    /* Out-of-memory error occurred. Abandon heap, re-initialize */
+    /* Out-of-memory error occurred and recovery failed.
+     * Abandon heap, re-initialize.
+     */
     snsrTearDown();
+    Cache = NULL;
+    guarded = 0;
     fprintf(stderr, "Restarting application with default allocator.\n");
 
   } else {
     /* Use a custom allocator to avoid calls to malloc(), et al */
     rc = snsrConfig(SNSR_CONFIG_ALLOC,
-                    snsrAllocTLSF(HeapPool, sizeof(HeapPool)));
+                    guard(snsrAllocTLSF(HeapPool, sizeof(HeapPool)), failAt));
+    guarded = 1;
     if (rc != SNSR_RC_OK) {
       fprintf(stderr, "Custom allocation failure: %s\n", snsrRCMessage(rc));
       return rc;
@@ -131,6 +317,9 @@ main(int argc, char **argv)
     return rc;
   }
 
+  /* The application cache shares the library heap */
+  if (guarded) Cache = GuardVmt.malloc(GuardVmt.ctx, CACHE_SIZE);
+
   /* Load and validate the spotter model task from code space */
   snsrLoad(s, snsrStreamFromCode(spot_hbg_enUS_1_3_0_m));
   if (snsrRequire(s, SNSR_TASK_TYPE, SNSR_PHRASESPOT) != SNSR_RC_OK) {
@@ -158,7 +347,15 @@ main(int argc, char **argv)
   /* Flush any remaining internally-buffered audio */
   rc = snsrStop(s);
 
+  if (guarded && Heap.recovered)
+    fprintf(stderr, "Recovered from %lu allocation failure%s.\n",
+            Heap.recovered, Heap.recovered == 1? "": "s");
+  /* A real application might now release secondary sessions */
+  if (guarded && Heap.reserveAdded)
+    fprintf(stderr, "WARNING: running on the reserve heap pool.\n");
+
   snsrRelease(s);
+  if (Cache) GuardVmt.free(GuardVmt.ctx, Cache);
 
   snsrTearDown();
   return rc;
@@ -11,6 +11,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "flac-stream.h"
+
 #define DEFAULT_OUT  "enrolled-sv.snsr"
 #define ENROLL_TASK_VERSION "~0.10.0 || 1.0.0"
 
@@ -367,7 +369,8 @@ main(int argc, char *argv[])
         if (hasContext && ++i >= argc) usage(argv[0]);
         a = snsrStreamFromFileName(argv[i], "r");
         e.enrollfile = argv[i];
-        a = snsrStreamFromAudioStream(a, SNSR_ST_AF_DEFAULT);
+        if (isFLACFilename(argv[i])) a = streamFromFLAC(a);
+        else a = snsrStreamFromAudioStream(a, SNSR_ST_AF_DEFAULT);
         snsrSetStream(s, SNSR_SOURCE_AUDIO_PCM, a);
         snsrSetInt(s, SNSR_ADD_CONTEXT, hasContext);
         if (e.verbosity >= 2) {
@@ -0,0 +1,605 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK custom stream benchmarks.
+ *------------------------------------------------------------------------------
+ * async:    cold-cache read throughput of synchronous file reads and of
+ *           the read-ahead stream in async-stream.c, with io_uring and
+ *           with pread() threads. With -t, also the end-to-end time to
+ *           run a recognizer on each.
+ * cache:    read throughput and page-cache footprint of buffered file
+ *           reads and of the direct I/O stream in direct-stream.c.
+ * codec:    decode throughput of the mu-law, A-law and IMA-ADPCM streams
+ *           in codec-stream.c, and the source bytes each reads per second
+ *           of audio.
+ * flac:     time to decode a FLAC file and to read the same audio from a
+ *           WAV file, see flac-stream.c. With -t, also the end-to-end
+ *           time to run a recognizer on each. Fails if the two files do
+ *           not decode to the same samples.
+ * prefetch: cold-cache wall time to run a recognizer on a corpus read
+ *           directly and through the read-ahead helper thread in
+ *           prefetch-stream.c.
+ * sg:       read throughput of many small concatenated memory segments,
+ *           using nested snsrStreamFromStreams() and the flat
+ *           scatter-gather stream in sg-stream.c.
+ *------------------------------------------------------------------------------
+ */
+
+#include <snsr.h>
+
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "async-stream.h"
+#include "codec-stream.h"
+#include "direct-stream.h"
+#include "flac-stream.h"
+#include "prefetch-stream.h"
+#include "sg-stream.h"
+
+#define DEFAULT_AHEAD  (1 << 20)
+#define DEFAULT_DEPTH        8
+#define DEFAULT_SEGMENTS 10000
+#define DEFAULT_PASSES       5
+/* Audio duration decoded by the codec benchmark */
+#define DEFAULT_SECONDS    600
+#define SAMPLE_RATE      16000
+/* Segment size: 10 ms of 16 kHz 16-bit audio */
+#define SEGMENT_BYTES      320
+/* Read block size: 15 ms of 16 kHz 16-bit audio */
+#define BLOCK_BYTES        480
+
+
+static void
+fatal(int rc, const char *format, ...)
+{
+  va_list a;
+  fprintf(stderr, "ERROR: ");
+  va_start(a, format);
+  vfprintf(stderr, format, a);
+  va_end(a);
+  fprintf(stderr, "\n");
+  exit(rc);
+}
+
+
+static void
+usage(const char *name)
+{
+  fprintf(stderr,
+          "usage: %s [options] benchmark [file ...]\n"
+          " options:\n"
+          "  -b bytes    : read-ahead buffer size (prefetch, default: %i)\n"
+          "  -d depth    : reads in flight (async, default: %i)\n"
+          "  -n count    : number of segments (sg, default: %i)\n"
+          "  -p passes   : number of timed passes (default: %i)\n"
+          "  -s seconds  : audio duration (codec, default: %i)\n"
+          "  -t task     : recognizer task for end-to-end runs (async,\n"
+          "                flac), required for prefetch\n"
+          " benchmarks:\n"
+          "  async       : sync vs async reads, requires file ...\n"
+          "  cache       : buffered vs direct reads, requires file ...\n"
+          "  codec       : compressed audio decode throughput\n"
+          "  flac        : FLAC vs WAV input, requires file.flac file.wav\n"
+          "  prefetch    : direct vs read-ahead input, requires file ...\n"
+          "  sg          : chained streams vs scatter-gather stream\n",
+          name, DEFAULT_AHEAD, DEFAULT_DEPTH, DEFAULT_SEGMENTS, DEFAULT_PASSES,
+          DEFAULT_SECONDS);
+  exit(199);
+}
+
+
+/* Monotonic clock time in seconds */
+static double
+wallSeconds(void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+
+/* Read b to the end, return the number of bytes read. */
+static size_t
+drain(SnsrStream b)
+{
+  char buffer[BLOCK_BYTES];
+  size_t n, total = 0;
+
+  snsrStreamOpen(b);
+  do {
+    n = snsrStreamRead(b, buffer, 1, sizeof(buffer));
+    total += n;
+  } while (n == sizeof(buffer) && snsrStreamRC(b) == SNSR_RC_OK);
+  if (snsrStreamRC(b) != SNSR_RC_OK && snsrStreamRC(b) != SNSR_RC_EOF)
+    fatal(snsrStreamRC(b), "%s", snsrStreamErrorDetail(b));
+  snsrStreamClose(b);
+  return total;
+}
+
+
+/* Decode seconds of encoded audio at rate Hz, passes times, or just
+ * read it if codec is NULL. Report the decode speed and the source bytes
+ * per second of audio.
+ */
+static void
+benchCodec(const char *name, const StreamCodec *codec, unsigned rate,
+           size_t bytesPerSecond, int seconds, int passes)
+{
+  SnsrStream b;
+  size_t i, n, size = bytesPerSecond * seconds;
+  unsigned char *data = malloc(size);
+  double start, used = 0;
+  int p;
+
+  if (!data) fatal(SNSR_RC_NO_MEMORY, "out of memory");
+  srand(1);
+  for (i = 0; i < size; i++) data[i] = (unsigned char)rand();
+  for (p = 0; p < passes; p++) {
+    b = snsrStreamFromMemory(data, size, SNSR_ST_MODE_READ);
+    if (codec) b = streamFromEncoded(b, *codec, rate, 0);
+    if (!b) fatal(SNSR_RC_NO_MEMORY, "out of memory");
+    snsrRetain(b);
+    start = wallSeconds();
+    n = drain(b);
+    used += wallSeconds() - start;
+    snsrRelease(b);
+    if (n < (size_t)seconds * SAMPLE_RATE * sizeof(short) * 99 / 100)
+      fatal(SNSR_RC_ERROR, "%s decoded %lu bytes, expected %lu", name,
+            (unsigned long)n,
+            (unsigned long)seconds * SAMPLE_RATE * sizeof(short));
+  }
+  used /= passes;
+  printf("%-10s %5u Hz: %6lu source bytes/s, %8.1fx real time, "
+         "%7.2f ns per sample\n", name, rate, (unsigned long)bytesPerSecond,
+         seconds / used, 1e9 * used / ((double)seconds * SAMPLE_RATE));
+  free(data);
+}
+
+
+static SnsrStream
+openAudio(const char *filename)
+{
+  if (isFLACFilename(filename))
+    return streamFromFLAC(snsrStreamFromFileName(filename, "r"));
+  return snsrStreamFromAudioFile(filename, "r", SNSR_ST_AF_DEFAULT);
+}
+
+
+/* Read filename passes times, then run task on it passes times if
+ * task is not NULL. Report the average times and the file size.
+ */
+static void
+benchFile(const char *filename, const char *task, int passes)
+{
+  SnsrSession s;
+  SnsrStream b;
+  SnsrRC r;
+  FILE *f;
+  size_t n = 0;
+  long fileSize = 0;
+  double start, read = 0, run = 0, audio;
+  int p;
+
+  f = fopen(filename, "rb");
+  if (!f) fatal(SNSR_RC_NOT_FOUND, "could not open \"%s\"", filename);
+  fseek(f, 0, SEEK_END);
+  fileSize = ftell(f);
+  fclose(f);
+
+  for (p = 0; p < passes; p++) {
+    b = openAudio(filename);
+    if (!b) fatal(SNSR_RC_NO_MEMORY, "out of memory");
+    snsrRetain(b);
+    start = wallSeconds();
+    n = drain(b);
+    read += wallSeconds() - start;
+    snsrRelease(b);
+  }
+  read /= passes;
+  audio = (double)n / (SAMPLE_RATE * sizeof(short));
+  printf("%-24s %9ld bytes, %7.1f s audio: read %8.3f ms",
+         filename, fileSize, audio, 1e3 * read);
+
+  if (task) {
+    for (p = 0; p < passes; p++) {
+      snsrNew(&s);
+      snsrLoad(s, snsrStreamFromFileName(task, "r"));
+      snsrSetStream(s, SNSR_SOURCE_AUDIO_PCM, openAudio(filename));
+      start = wallSeconds();
+      r = snsrRun(s);
+      run += wallSeconds() - start;
+      if (r != SNSR_RC_STREAM_END) fatal(r, "%s", snsrErrorDetail(s));
+      snsrRelease(s);
+    }
+    run /= passes;
+    printf(", run %8.3f ms (%.1fx real time)", 1e3 * run, audio / run);
+  }
+  printf("\n");
+}
+
+
+/* Check that flac and wav decode to the same samples. */
+static void
+compareAudio(const char *flac, const char *wav)
+{
+  SnsrStream a = openAudio(flac), b = openAudio(wav);
+  char x[BLOCK_BYTES], y[BLOCK_BYTES];
+  size_t n, m, total = 0;
+  SnsrRC r;
+
+  if (!a || !b) fatal(SNSR_RC_NO_MEMORY, "out of memory");
+  snsrRetain(a);
+  snsrRetain(b);
+  snsrStreamOpen(a);
+  snsrStreamOpen(b);
+  do {
+    n = snsrStreamRead(a, x, 1, sizeof(x));
+    m = snsrStreamRead(b, y, 1, sizeof(y));
+    if (n != m || memcmp(x, y, n)) {
+      r = snsrStreamRC(a);
+      fatal(SNSR_RC_ERROR, "%s and %s differ after %lu samples: %s",
+            flac, wav, (unsigned long)(total / sizeof(short)),
+            r == SNSR_RC_OK || r == SNSR_RC_EOF?
+            "different audio": snsrStreamErrorDetail(a));
+    }
+    total += n;
+  } while (n == sizeof(x));
+  snsrRelease(a);
+  snsrRelease(b);
+  printf("FLAC and WAV audio match, %lu samples.\n",
+         (unsigned long)(total / sizeof(short)));
+}
+
+
+/* Drop the clean pages of filename from the page cache. Where there is
+ * no POSIX_FADV_DONTNEED, as on macOS, the reads are not cold.
+ */
+static void
+evictFile(const char *filename)
+{
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) fatal(SNSR_RC_NOT_FOUND, "could not open \"%s\"", filename);
+#ifdef POSIX_FADV_DONTNEED
+  posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+  close(fd);
+}
+
+
+/* Bytes of filename currently in the page cache. */
+static size_t
+cachedBytes(const char *filename, size_t *fileSize)
+{
+  struct stat st;
+  unsigned char *vec;
+  size_t i, pages, resident = 0;
+  long pageSize = sysconf(_SC_PAGESIZE);
+  void *map;
+  int fd;
+
+  fd = open(filename, O_RDONLY);
+  if (fd < 0 || fstat(fd, &st))
+    fatal(SNSR_RC_NOT_FOUND, "could not open \"%s\"", filename);
+  *fileSize = (size_t)st.st_size;
+  if (!st.st_size) {
+    close(fd);
+    return 0;
+  }
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) fatal(SNSR_RC_ERROR, "could not map \"%s\"", filename);
+  pages = (st.st_size + pageSize - 1) / pageSize;
+  vec = malloc(pages);
+  if (!vec) fatal(SNSR_RC_NO_MEMORY, "out of memory");
+  if (!mincore(map, st.st_size, (void *)vec))
+    for (i = 0; i < pages; i++) resident += vec[i] & 1;
+  free(vec);
+  munmap(map, st.st_size);
+  return resident * pageSize;
+}
+
+
+/* Read filename from a cold cache passes times, with buffered reads and
+ * then with streamFromDirectFile(). Report the read throughput and the
+ * page-cache footprint left behind by each.
+ */
+static void
+benchCache(const char *filename, int passes)
+{
+  SnsrStream b;
+  size_t fileSize, cached;
+  double start, used;
+  int p, direct, uncached;
+
+  /* File systems without O_DIRECT support fall back to dropping pages */
+  b = streamFromDirectFile(filename);
+  snsrRetain(b);
+  if (snsrStreamOpen(b) != SNSR_RC_OK)
+    fatal(snsrStreamRC(b), "%s", snsrStreamErrorDetail(b));
+  uncached = directFileIsUncached(b);
+  snsrRelease(b);
+
+  for (direct = 0; direct < 2; direct++) {
+    used = 0;
+    for (p = 0; p < passes; p++) {
+      evictFile(filename);
+      b = direct? streamFromDirectFile(filename):
+        snsrStreamFromFileName(filename, "r");
+      if (!b) fatal(SNSR_RC_NO_MEMORY, "out of memory");
+      snsrRetain(b);
+      start = wallSeconds();
+      drain(b);
+      used += wallSeconds() - start;
+      snsrRelease(b);
+    }
+    used /= passes;
+    cached = cachedBytes(filename, &fileSize);
+    printf("%-24s %-8s %8.1f MB/s, %9lu of %9lu bytes left in the "
+           "page cache\n", filename,
+           direct? (uncached? "direct": "dropped"): "buffered",
+           fileSize / used / (1024 * 1024),
+           (unsigned long)cached, (unsigned long)fileSize);
+  }
+}
+
+
+/* Open filename with the reader selected by mode: 0 for synchronous
+ * reads, 1 for asynchronous reads with pread() threads, and 2 for
+ * asynchronous reads with io_uring if available.
+ */
+static SnsrStream
+openAsync(const char *filename, int mode, unsigned depth)
+{
+  if (!mode) return snsrStreamFromFileName(filename, "r");
+  return streamFromAsyncFile(filename, depth, mode == 1?
+                             ASYNC_FILE_THREADS: ASYNC_FILE_AUTO);
+}
+
+
+/* Read filename from a cold cache passes times with each reader, then
+ * run task on it if task is not NULL. Report the average read throughput
+ * and run time.
+ */
+static void
+benchAsync(const char *filename, const char *task, unsigned depth,
+           int passes)
+{
+  SnsrSession s;
+  SnsrStream b;
+  SnsrRC r;
+  size_t n = 0;
+  double start, read, run;
+  const char *name;
+  int p, mode;
+
+  for (mode = 0; mode < 3; mode++) {
+    b = openAsync(filename, mode, depth);
+    snsrRetain(b);
+    if (snsrStreamOpen(b) != SNSR_RC_OK)
+      fatal(snsrStreamRC(b), "%s", snsrStreamErrorDetail(b));
+    name = mode? asyncFileBackendName(b): "synchronous";
+    snsrRelease(b);
+    if (mode == 2 && !strcmp(name, "pread threads")) {
+      printf("%-24s io_uring is not available.\n", filename);
+      break;
+    }
+
+    read = run = 0;
+    for (p = 0; p < passes; p++) {
+      evictFile(filename);
+      b = openAsync(filename, mode, depth);
+      if (!b) fatal(SNSR_RC_NO_MEMORY, "out of memory");
+      snsrRetain(b);
+      start = wallSeconds();
+      n = drain(b);
+      read += wallSeconds() - start;
+      snsrRelease(b);
+    }
+    read /= passes;
+    printf("%-24s %-13s %8.1f MB/s", filename, name,
+           n / read / (1024 * 1024));
+
+    if (task) {
+      for (p = 0; p < passes; p++) {
+        evictFile(filename);
+        snsrNew(&s);
+        snsrLoad(s, snsrStreamFromFileName(task, "r"));
+        snsrSetStream(s, SNSR_SOURCE_AUDIO_PCM, snsrStreamFromAudioStream(
+                        openAsync(filename, mode, depth), SNSR_ST_AF_DEFAULT));
+        start = wallSeconds();
+        r = snsrRun(s);
+        run += wallSeconds() - start;
+        if (r != SNSR_RC_STREAM_END) fatal(r, "%s", snsrErrorDetail(s));
+        snsrRelease(s);
+      }
+      printf(", run %8.3f ms", 1e3 * run / passes);
+    }
+    printf("\n");
+  }
+}
+
+
+/* Concatenation of the audio in count files. */
+static SnsrStream
+openCorpus(char *files[], int count)
+{
+  SnsrStream b = streamFromSegments();
+  int i;
+
+  for (i = 0; i < count; i++) streamSegmentsAddStream(b, openAudio(files[i]));
+  return b;
+}
+
+
+/* Run task on the concatenation of count files from a cold cache, passes
+ * times, reading the audio on the session thread and then through
+ * streamFromPrefetch(). Report the average wall time and real-time factor,
+ * and how often the session still had to wait for the read-ahead thread.
+ */
+static void
+benchPrefetch(char *files[], int count, const char *task, size_t ahead,
+              int passes)
+{
+  SnsrSession s;
+  SnsrStream b;
+  SnsrRC r;
+  size_t stalls;
+  double start, run, audio;
+  int i, p, prefetch;
+
+  b = openCorpus(files, count);
+  if (!b) fatal(SNSR_RC_NO_MEMORY, "out of memory");
+  snsrRetain(b);
+  audio = (double)drain(b) / (SAMPLE_RATE * sizeof(short));
+  snsrRelease(b);
+
+  for (prefetch = 0; prefetch < 2; prefetch++) {
+    run = 0;
+    stalls = 0;
+    for (p = 0; p < passes; p++) {
+      for (i = 0; i < count; i++) evictFile(files[i]);
+      b = openCorpus(files, count);
+      if (prefetch) b = streamFromPrefetch(b, ahead);
+      if (!b) fatal(SNSR_RC_NO_MEMORY, "out of memory");
+      snsrRetain(b);
+      snsrNew(&s);
+      snsrLoad(s, snsrStreamFromFileName(task, "r"));
+      snsrSetStream(s, SNSR_SOURCE_AUDIO_PCM, b);
+      start = wallSeconds();
+      r = snsrRun(s);
+      run += wallSeconds() - start;
+      if (r != SNSR_RC_STREAM_END) fatal(r, "%s", snsrErrorDetail(s));
+      snsrRelease(s);
+      stalls += prefetchStalls(b);
+      snsrRelease(b);
+    }
+    run /= passes;
+    printf("%d files, %7.1f s audio, %-10s run %8.3f ms (%.1fx real time)",
+           count, audio, prefetch? "prefetch": "direct", 1e3 * run,
+           audio / run);
+    if (prefetch) printf(", %lu stalls", (unsigned long)(stalls / passes));
+    printf("\n");
+  }
+}
+
+
+/* Concatenate segments of data and read the result, passes times.
+ * Report the average build time and read throughput.
+ */
+static double
+benchSegments(const char *data, size_t segments, int passes, int flat)
+{
+  SnsrStream b;
+  size_t i;
+  double start, build = 0, read = 0;
+  int p;
+
+  for (p = 0; p < passes; p++) {
+    start = wallSeconds();
+    if (flat) {
+      b = streamFromSegments();
+      for (i = 0; i < segments; i++)
+        streamSegmentsAddMemory(b, data + i * SEGMENT_BYTES, SEGMENT_BYTES);
+    } else {
+      b = snsrStreamFromString("");
+      for (i = 0; i < segments; i++)
+        b = snsrStreamFromStreams(b, snsrStreamFromMemory(
+              (void *)(data + i * SEGMENT_BYTES), SEGMENT_BYTES,
+              SNSR_ST_MODE_READ));
+    }
+    if (!b) fatal(SNSR_RC_NO_MEMORY, "out of memory");
+    snsrRetain(b);
+    build += wallSeconds() - start;
+
+    start = wallSeconds();
+    i = drain(b);
+    read += wallSeconds() - start;
+    if (i != segments * SEGMENT_BYTES)
+      fatal(SNSR_RC_ERROR, "read %lu bytes, expected %lu",
+            (unsigned long)i, (unsigned long)(segments * SEGMENT_BYTES));
+    snsrRelease(b);
+  }
+  build /= passes;
+  read /= passes;
+  printf("%-14s %6lu segments: build %8.3f ms, read %8.3f ms, %8.1f MB/s\n",
+         flat? "scatter-gather": "chained", (unsigned long)segments,
+         1e3 * build, 1e3 * read,
+         segments * SEGMENT_BYTES / read / (1024 * 1024));
+  return read;
+}
+
+
+int
+main(int argc, char *argv[])
+{
+  const char *task = NULL;
+  int o, passes = DEFAULT_PASSES, seconds = DEFAULT_SECONDS;
+  int depth = DEFAULT_DEPTH;
+  long ahead = DEFAULT_AHEAD;
+  long segments = DEFAULT_SEGMENTS;
+  extern char *optarg;
+  extern int optind;
+
+  while ((o = getopt(argc, argv, "b:d:n:p:s:t:?")) >= 0) {
+    switch (o) {
+    case 'b': ahead = atol(optarg); break;
+    case 'd': depth = atoi(optarg); break;
+    case 'n': segments = atol(optarg); break;
+    case 'p': passes = atoi(optarg); break;
+    case 's': seconds = atoi(optarg); break;
+    case 't': task = optarg; break;
+    default:  usage(argv[0]);
+    }
+  }
+  if (optind >= argc || segments <= 0 || passes <= 0
+      || seconds <= 0 || depth <= 0 || ahead <= 0) usage(argv[0]);
+
+  if (!strcmp(argv[optind], "codec") && optind + 1 == argc) {
+    const StreamCodec mulaw = STREAM_CODEC_MULAW, alaw = STREAM_CODEC_ALAW;
+    const StreamCodec ima = STREAM_CODEC_IMA_ADPCM;
+    benchCodec("pcm", NULL, SAMPLE_RATE,
+               SAMPLE_RATE * sizeof(short), seconds, passes);
+    benchCodec("mu-law", &mulaw, SAMPLE_RATE, SAMPLE_RATE, seconds, passes);
+    benchCodec("A-law", &alaw, SAMPLE_RATE, SAMPLE_RATE, seconds, passes);
+    benchCodec("IMA-ADPCM", &ima, SAMPLE_RATE,
+               SAMPLE_RATE / 2, seconds, passes);
+    benchCodec("mu-law", &mulaw, 8000, 8000, seconds, passes);
+    benchCodec("IMA-ADPCM", &ima, 8000, 4000, seconds, passes);
+  } else if (!strcmp(argv[optind], "async") && optind + 1 < argc) {
+    int i;
+    for (i = optind + 1; i < argc; i++)
+      benchAsync(argv[i], task, depth, passes);
+  } else if (!strcmp(argv[optind], "cache") && optind + 1 < argc) {
+    int i;
+    for (i = optind + 1; i < argc; i++) benchCache(argv[i], passes);
+  } else if (!strcmp(argv[optind], "flac") && optind + 3 == argc) {
+    benchFile(argv[optind + 1], task, passes);
+    benchFile(argv[optind + 2], task, passes);
+    compareAudio(argv[optind + 1], argv[optind + 2]);
+  } else if (!strcmp(argv[optind], "prefetch") && optind + 1 < argc
+             && task) {
+    benchPrefetch(argv + optind + 1, argc - optind - 1, task,
+                  (size_t)ahead, passes);
+  } else if (!strcmp(argv[optind], "sg") && optind + 1 == argc) {
+    char *data = malloc((size_t)segments * SEGMENT_BYTES);
+    double chained, flat;
+    if (!data) fatal(SNSR_RC_NO_MEMORY, "out of memory");
+    memset(data, 0x5a, (size_t)segments * SEGMENT_BYTES);
+    chained = benchSegments(data, segments, passes, 0);
+    flat = benchSegments(data, segments, passes, 1);
+    printf("Scatter-gather reads are %.1fx faster.\n", chained / flat);
+    free(data);
+  } else {
+    usage(argv[0]);
+  }
+  snsrTearDown();
+  return 0;
+}
@@ -0,0 +1,305 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK example of a custom stream that instruments another.
+ *------------------------------------------------------------------------------
+ * Each open, close, read and write call is passed on to the wrapped
+ * stream and timed. The report shows the calls, bytes and time spent per
+ * operation, a per-call latency histogram with power-of-two microsecond
+ * buckets, and the fraction of the time the stream was open that the
+ * caller spent blocked in it. A session that is blocked most of the time
+ * is I/O-bound, one that is rarely blocked is CPU-bound.
+ *------------------------------------------------------------------------------
+ */
+
+#include <snsr.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <time.h>
+#endif
+
+#include "trace-stream.h"
+
+/* Latency buckets: < 1 us, < 2 us, < 4 us, ... and >= 2^(BUCKETS-2) us */
+#define BUCKETS 24
+
+typedef enum {
+  OP_OPEN,
+  OP_CLOSE,
+  OP_READ,
+  OP_WRITE,
+  OP_COUNT
+} TraceOp;
+
+static const char *OpName[OP_COUNT] = {"open", "close", "read", "write"};
+
+typedef struct {
+  size_t calls;
+  size_t bytes;
+  double seconds;              /* total time spent in calls             */
+  double maxSeconds;           /* longest single call                   */
+  size_t histogram[BUCKETS];
+} OpStats;
+
+typedef struct {
+  SnsrStream source;
+  SnsrStream report;           /* printed to at release, may be NULL    */
+  char *label;
+  TraceFormat format;
+  OpStats op[OP_COUNT];
+  double openedAt;             /* time of the first open                */
+  double closedAt;             /* time of the last close                */
+} ProviderData;
+
+
+/* Monotonic clock time in seconds */
+static double
+now(void)
+{
+#ifdef _WIN32
+  LARGE_INTEGER count, frequency;
+  QueryPerformanceCounter(&count);
+  QueryPerformanceFrequency(&frequency);
+  return (double)count.QuadPart / frequency.QuadPart;
+#else
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+#endif
+}
+
+
+static void
+record(ProviderData *d, TraceOp op, double start, size_t bytes)
+{
+  OpStats *s = d->op + op;
+  double used = now() - start;
+  double us = used * 1e6;
+  int bucket = 0;
+
+  while (bucket < BUCKETS - 1 && us >= 1.0) {
+    us /= 2;
+    bucket++;
+  }
+  s->calls++;
+  s->bytes += bytes;
+  s->seconds += used;
+  if (used > s->maxSeconds) s->maxSeconds = used;
+  s->histogram[bucket]++;
+}
+
+
+/* Copy the status of the wrapped stream to b. */
+static void
+passRC(SnsrStream b, ProviderData *d)
+{
+  SnsrRC r = snsrStreamRC(d->source);
+
+  if (r == SNSR_RC_OK) return;
+  if (r != SNSR_RC_EOF)
+    snsrStream_setDetail(b, "%s", snsrStreamErrorDetail(d->source));
+  snsrStream_setRC(b, r);
+}
+
+
+static SnsrRC
+streamOpen(SnsrStream b)
+{
+  ProviderData *d = (ProviderData *)snsrStream_getData(b);
+  double start = now();
+  SnsrRC r;
+
+  if (!d->op[OP_OPEN].calls) d->openedAt = start;
+  r = snsrStreamOpen(d->source);
+  record(d, OP_OPEN, start, 0);
+  if (r != SNSR_RC_OK)
+    snsrStream_setDetail(b, "%s", snsrStreamErrorDetail(d->source));
+  return r;
+}
+
+
+static SnsrRC
+streamClose(SnsrStream b)
+{
+  ProviderData *d = (ProviderData *)snsrStream_getData(b);
+  double start = now();
+  SnsrRC r;
+
+  r = snsrStreamClose(d->source);
+  record(d, OP_CLOSE, start, 0);
+  d->closedAt = now();
+  return r;
+}
+
+
+static void
+streamRelease(SnsrStream b)
+{
+  ProviderData *d = (ProviderData *)snsrStream_getData(b);
+
+  if (d->report) {
+    tracePrint(b, d->report, d->format);
+    snsrRelease(d->report);
+  }
+  snsrRelease(d->source);
+  free(d->label);
+  free(d);
+}
+
+
+static size_t
+streamRead(SnsrStream b, void *buffer, size_t size)
+{
+  ProviderData *d = (ProviderData *)snsrStream_getData(b);
+  double start = now();
+  size_t n;
+
+  n = snsrStreamRead(d->source, buffer, 1, size);
+  record(d, OP_READ, start, n);
+  passRC(b, d);
+  return n;
+}
+
+
+static size_t
+streamWrite(SnsrStream b, const void *buffer, size_t size)
+{
+  ProviderData *d = (ProviderData *)snsrStream_getData(b);
+  double start = now();
+  size_t n;
+
+  n = snsrStreamWrite(d->source, buffer, 1, size);
+  record(d, OP_WRITE, start, n);
+  passRC(b, d);
+  return n;
+}
+
+
+static SnsrStream_Vmt ProviderDef = {
+  "trace",
+  &streamOpen, &streamClose, &streamRelease, &streamRead, &streamWrite
+};
+
+
+SnsrStream
+streamFromTraced(SnsrStream source, const char *label,
+                 SnsrStream report, TraceFormat format)
+{
+  SnsrStream b;
+  ProviderData *d;
+  int readable, writable;
+
+  if (!source) return NULL;
+  snsrRetain(source);
+  d = calloc(1, sizeof(*d));
+  if (d) d->label = strdup(label? label: "");
+  if (!d || !d->label) {
+    free(d);
+    snsrRelease(source);
+    return NULL;
+  }
+  d->source = source;
+  d->format = format;
+  readable = (int)snsrStreamGetMeta(source, SNSR_ST_META_IS_READABLE);
+  writable = (int)snsrStreamGetMeta(source, SNSR_ST_META_IS_WRITABLE);
+  b = snsrStream_alloc(&ProviderDef, d, readable, writable);
+  if (!b) {
+    snsrRelease(source);
+    free(d->label);
+    free(d);
+    return NULL;
+  }
+  if (report) snsrRetain(report);
+  d->report = report;
+  return b;
+}
+
+
+/* Print s as a JSON string, escaping quotes and control characters. */
+static void
+printJSONString(SnsrStream out, const char *s)
+{
+  snsrStreamPrint(out, "\"");
+  for (; *s; s++) {
+    if (*s == '"' || *s == '\\') snsrStreamPrint(out, "\\%c", *s);
+    else if ((unsigned char)*s < 0x20)
+      snsrStreamPrint(out, "\\u%04x", (unsigned char)*s);
+    else snsrStreamPrint(out, "%c", *s);
+  }
+  snsrStreamPrint(out, "\"");
+}
+
+
+void
+tracePrint(SnsrStream b, SnsrStream out, TraceFormat format)
+{
+  ProviderData *d;
+  double elapsed, blocked = 0;
+  int i, k, first, firstBucket;
+
+  if (!b || !out || snsrStream_getVmt(b) != &ProviderDef) return;
+  d = (ProviderData *)snsrStream_getData(b);
+  elapsed = d->op[OP_OPEN].calls?
+    (d->closedAt > d->openedAt? d->closedAt: now()) - d->openedAt: 0;
+  for (i = 0; i < OP_COUNT; i++) blocked += d->op[i].seconds;
+
+  if (format == TRACE_JSON) {
+    snsrStreamPrint(out, "{\"label\": ");
+    printJSONString(out, d->label);
+    snsrStreamPrint(out, ", \"elapsed_s\": %.6f, \"blocked_s\": %.6f, "
+                    "\"ops\": {", elapsed, blocked);
+    for (first = 1, i = 0; i < OP_COUNT; i++) {
+      OpStats *s = d->op + i;
+      if (!s->calls) continue;
+      snsrStreamPrint(out, "%s\"%s\": {\"calls\": %lu, \"bytes\": %lu, "
+                      "\"total_us\": %.1f, \"max_us\": %.1f, "
+                      "\"histogram_us\": [", first? "": ", ", OpName[i],
+                      (unsigned long)s->calls, (unsigned long)s->bytes,
+                      s->seconds * 1e6, s->maxSeconds * 1e6);
+      for (firstBucket = 1, k = 0; k < BUCKETS; k++) {
+        if (!s->histogram[k]) continue;
+        /* [upper bound in us, or 0 for the last bucket, count] */
+        snsrStreamPrint(out, "%s[%lu, %lu]", firstBucket? "": ", ",
+                        k < BUCKETS - 1? 1ul << k: 0ul,
+                        (unsigned long)s->histogram[k]);
+        firstBucket = 0;
+      }
+      snsrStreamPrint(out, "]}");
+      first = 0;
+    }
+    snsrStreamPrint(out, "}}\n");
+    return;
+  }
+
+  snsrStreamPrint(out, "stream \"%s\": open %.3f s, %.1f%% blocked in "
+                  "stream calls\n", d->label, elapsed,
+                  elapsed > 0? 100 * blocked / elapsed: 0.0);
+  snsrStreamPrint(out, "  %-6s %9s %12s %11s %10s %10s\n",
+                  "op", "calls", "bytes", "total ms", "mean us", "max us");
+  for (i = 0; i < OP_COUNT; i++) {
+    OpStats *s = d->op + i;
+    if (!s->calls) continue;
+    snsrStreamPrint(out, "  %-6s %9lu %12lu %11.3f %10.1f %10.1f\n",
+                    OpName[i], (unsigned long)s->calls,
+                    (unsigned long)s->bytes, s->seconds * 1e3,
+                    s->seconds * 1e6 / s->calls, s->maxSeconds * 1e6);
+  }
+  for (i = 0; i < OP_COUNT; i++) {
+    OpStats *s = d->op + i;
+    if (s->calls < 2) continue;
+    snsrStreamPrint(out, "  %s latency:", OpName[i]);
+    for (k = 0; k < BUCKETS; k++) {
+      if (!s->histogram[k]) continue;
+      if (k < BUCKETS - 1) snsrStreamPrint(out, " <%luus:%lu", 1ul << k,
+                                          (unsigned long)s->histogram[k]);
+      else snsrStreamPrint(out, " >=%luus:%lu", 1ul << (k - 1),
+                           (unsigned long)s->histogram[k]);
+    }
+    snsrStreamPrint(out, "\n");
+  }
+}
@@ -0,0 +1,26 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK custom stream header. See trace-stream.c.
+ *------------------------------------------------------------------------------
+ */
+
+typedef enum {
+  TRACE_TEXT,
+  TRACE_JSON,
+} TraceFormat;
+
+/* Wrap source in a stream that counts the calls, bytes and time spent in
+ * each of its open, close, read and write operations. The statistics are
+ * printed to report in format when the stream is released, unless report
+ * is NULL. label identifies the stream in the report.
+ * Takes ownership of source, and retains report.
+ */
+SnsrStream
+streamFromTraced(SnsrStream source, const char *label,
+                 SnsrStream report, TraceFormat format);
+
+/* Print the statistics collected so far by traced stream b to report.
+ */
+void
+tracePrint(SnsrStream b, SnsrStream report, TraceFormat format);
@@ -0,0 +1,74 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK WAV file header reader, shared by codec-stream.c and
+ * demux-stream.c.
+ *------------------------------------------------------------------------------
+ * Walks the RIFF chunks up to the data chunk, keeping the fields of the
+ * fmt chunk and skipping all others. WAVE_FORMAT_EXTENSIBLE headers report
+ * the tag of their sub-format. Streamed WAV files may have a data size of
+ * 0 or 0xffffffff, these are reported as SIZE_MAX.
+ *------------------------------------------------------------------------------
+ */
+
+#include <snsr.h>
+
+#include <stdint.h>
+#include <string.h>
+
+#include "wav-header.h"
+
+#define WAV_EXTENSIBLE    0xfffe
+/* Bytes of the fmt chunk used here, including the extensible sub-format */
+#define WAV_FMT_SIZE          26
+
+
+static unsigned
+le16(const unsigned char *p)
+{
+  return p[0] | p[1] << 8;
+}
+
+
+static uint32_t
+le32(const unsigned char *p)
+{
+  return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+
+const char *
+wavReadHeader(SnsrStream source, WavHeader *h)
+{
+  unsigned char c[WAV_FMT_SIZE];
+  uint32_t size, pad;
+  size_t n;
+
+  memset(h, 0, sizeof(*h));
+  n = snsrStreamRead(source, c, 1, 12);
+  if (n != 12 || memcmp(c, "RIFF", 4) || memcmp(c + 8, "WAVE", 4))
+    return "Source is not a WAV file.";
+  for (;;) {
+    if (snsrStreamRead(source, c, 1, 8) != 8)
+      return "WAV file has no data chunk.";
+    size = le32(c + 4);
+    /* Chunks are padded to an even size */
+    pad = size & 1;
+    if (!memcmp(c, "data", 4)) break;
+    if (!memcmp(c, "fmt ", 4) && size >= 16) {
+      n = size < WAV_FMT_SIZE? size: WAV_FMT_SIZE;
+      if (snsrStreamRead(source, c, 1, n) != n)
+        return "WAV file fmt chunk is truncated.";
+      h->tag = le16(c);
+      if (h->tag == WAV_EXTENSIBLE && n >= WAV_FMT_SIZE) h->tag = le16(c + 24);
+      h->channels = le16(c + 2);
+      h->rate = le32(c + 4);
+      h->blockAlign = le16(c + 12);
+      h->bits = le16(c + 14);
+      size -= (uint32_t)n;
+    }
+    snsrStreamSkip(source, 1, size + pad);
+  }
+  h->dataSize = size && size != 0xffffffff? size: SIZE_MAX;
+  return NULL;
+}
@@ -0,0 +1,29 @@
+/* Sensory Confidential
+ * Copyright (C)2025 Sensory, Inc. https://sensory.com/
+ *
+ * TrulyHandsfree SDK WAV file header reader. See wav-header.c.
+ *------------------------------------------------------------------------------
+ */
+
+/* WAV format tags */
+#define WAV_PCM           0x0001
+#define WAV_ALAW          0x0006
+#define WAV_MULAW         0x0007
+#define WAV_IMA_ADPCM     0x0011
+
+typedef struct {
+  unsigned tag;                /* format tag or extensible sub-format   */
+  unsigned channels;
+  unsigned rate;               /* sample rate in Hz                     */
+  unsigned blockAlign;         /* bytes per frame, or per ADPCM block   */
+  unsigned bits;               /* bits per sample                       */
+  size_t dataSize;             /* data chunk bytes, SIZE_MAX if unknown */
+} WavHeader;
+
+/* Read a RIFF WAVE header from source, up to the start of the audio data.
+ * Fields missing from the header are left at 0.
+ * Returns NULL on success, or a message that explains why source is not
+ * a WAV file.
+ */
+const char *
+wavReadHeader(SnsrStream source, WavHeader *h);